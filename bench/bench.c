@@ -0,0 +1,320 @@
+/*
+ * Parse throughput benchmark for the D grammar.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// This program parses each input several times and reports the
+// throughput (MB/s and ns/byte), the size of the resulting tree, and
+// the peak resident set size.  Inputs are either the sources embedded
+// in the test corpus (each corpus file is treated as one input, with
+// all of its test cases concatenated), or arbitrary D files named on
+// the command line.
+//
+// Every input is measured in a child process, so that the peak RSS
+// reported is attributable to that input alone.  Results are printed
+// as a table, and optionally written as JSON for later comparison
+// with bench/compare.js.
+
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <tree_sitter/api.h>
+
+#include "corpus.h"
+#include "tree-sitter-d.h"
+
+#ifndef BENCH_VERSION
+#define BENCH_VERSION "unknown"
+#endif
+
+typedef struct {
+	char  *name;
+	char  *text;
+	size_t len;
+} input;
+
+// result is written by the child over a pipe, so it must be flat
+typedef struct {
+	uint64_t best_ns;
+	uint64_t total_ns;
+	uint64_t nodes;
+	uint32_t iterations;
+	bool     has_error;
+	bool     failed;
+} result;
+
+static int    iterations = 10;
+static input *inputs;
+static size_t ninputs;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec);
+}
+
+static void
+add_input(const char *name, char *text, size_t len)
+{
+	input *ni;
+	if ((ni = realloc(inputs, sizeof(input) * (ninputs + 1))) == NULL) {
+		fprintf(stderr, "bench: out of memory\n");
+		exit(1);
+	}
+	inputs               = ni;
+	inputs[ninputs].name = strdup(name);
+	inputs[ninputs].text = text;
+	inputs[ninputs].len  = len;
+	ninputs++;
+}
+
+static void
+add_corpus_input(const char *name, char *src, size_t len, void *arg)
+{
+	(void) arg;
+	add_input(name, src, len);
+}
+
+static void
+add_corpus(const char *dir)
+{
+	int rv;
+	if ((rv = corpus_foreach(dir, add_corpus_input, NULL)) != 0) {
+		fprintf(stderr, "bench: %s: %s\n", dir, strerror(rv));
+		exit(1);
+	}
+}
+
+static uint64_t
+count_nodes(TSTree *tree)
+{
+	TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+	uint64_t     count  = 1;
+
+	for (;;) {
+		if (ts_tree_cursor_goto_first_child(&cursor)) {
+			count++;
+			continue;
+		}
+		while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+			if (!ts_tree_cursor_goto_parent(&cursor)) {
+				ts_tree_cursor_delete(&cursor);
+				return (count);
+			}
+		}
+		count++;
+	}
+}
+
+static void
+run_input(const input *in, result *r)
+{
+	TSParser *parser = ts_parser_new();
+	TSTree   *tree;
+
+	memset(r, 0, sizeof(*r));
+	r->best_ns = UINT64_MAX;
+	ts_parser_set_language(parser, tree_sitter_d());
+
+	for (int i = 0; i < iterations; i++) {
+		uint64_t start = now_ns();
+		uint64_t elapsed;
+
+		tree = ts_parser_parse_string(
+		    parser, NULL, in->text, (uint32_t) in->len);
+		elapsed = now_ns() - start;
+		if (tree == NULL) {
+			r->failed = true;
+			break;
+		}
+		r->total_ns += elapsed;
+		if (elapsed < r->best_ns) {
+			r->best_ns = elapsed;
+		}
+		r->iterations++;
+		if (i == 0) {
+			r->nodes     = count_nodes(tree);
+			r->has_error = ts_node_has_error(ts_tree_root_node(tree));
+		}
+		ts_tree_delete(tree);
+	}
+	ts_parser_delete(parser);
+}
+
+// measure runs the input in a child process, returning the results
+// and the child's peak RSS in kilobytes.
+static bool
+measure(const input *in, result *r, long *rss_kb)
+{
+	int           fds[2];
+	pid_t         pid;
+	int           status;
+	struct rusage ru;
+
+	if (pipe(fds) != 0) {
+		return (false);
+	}
+	if ((pid = fork()) < 0) {
+		close(fds[0]);
+		close(fds[1]);
+		return (false);
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		run_input(in, r);
+		_exit(write(fds[1], r, sizeof(*r)) == sizeof(*r) ? 0 : 1);
+	}
+	close(fds[1]);
+	if (read(fds[0], r, sizeof(*r)) != sizeof(*r)) {
+		r->failed = true;
+	}
+	close(fds[0]);
+	if (wait4(pid, &status, 0, &ru) < 0) {
+		return (false);
+	}
+#ifdef __APPLE__
+	*rss_kb = ru.ru_maxrss / 1024; // bytes on macOS
+#else
+	*rss_kb = ru.ru_maxrss;
+#endif
+	return (WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+}
+
+static void
+json_string(FILE *f, const char *s)
+{
+	fputc('"', f);
+	for (; *s; s++) {
+		if ((*s == '"') || (*s == '\\')) {
+			fputc('\\', f);
+		}
+		fputc(*s, f);
+	}
+	fputc('"', f);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+	    "usage: bench [-n iterations] [-c corpus-dir] [-o results.json] "
+	    "[file.d ...]\n");
+	exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *outfile = NULL;
+	FILE       *json    = NULL;
+	int         opt;
+	int         rv = 0;
+
+	while ((opt = getopt(argc, argv, "n:c:o:")) != -1) {
+		switch (opt) {
+		case 'n':
+			if ((iterations = atoi(optarg)) < 1) {
+				usage();
+			}
+			break;
+		case 'c':
+			add_corpus(optarg);
+			break;
+		case 'o':
+			outfile = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	for (int i = optind; i < argc; i++) {
+		size_t len;
+		char  *text;
+		if ((text = corpus_read_file(argv[i], &len)) == NULL) {
+			fprintf(stderr, "bench: %s: %s\n", argv[i],
+			    strerror(errno));
+			return (1);
+		}
+		add_input(argv[i], text, len);
+	}
+	if (ninputs == 0) {
+		usage();
+	}
+
+	if (outfile != NULL) {
+		if ((json = fopen(outfile, "w")) == NULL) {
+			fprintf(stderr, "bench: %s: %s\n", outfile,
+			    strerror(errno));
+			return (1);
+		}
+		fprintf(json,
+		    "{\n  \"version\": \"%s\",\n  \"iterations\": %d,\n"
+		    "  \"inputs\": [",
+		    BENCH_VERSION, iterations);
+	}
+
+	printf("%-40s %10s %9s %9s %10s %10s\n", "input", "bytes", "MB/s",
+	    "ns/byte", "nodes", "rss(KB)");
+
+	for (size_t i = 0; i < ninputs; i++) {
+		const input *in = &inputs[i];
+		result       r;
+		long         rss = 0;
+		double       secs;
+		double       mbps;
+		double       nspb;
+
+		if (!measure(in, &r, &rss) || r.failed) {
+			fprintf(stderr, "bench: %s: parse failed\n", in->name);
+			rv = 1;
+			continue;
+		}
+		secs = (double) r.best_ns / 1e9;
+		mbps = secs > 0 ? ((double) in->len / 1e6) / secs : 0;
+		nspb = in->len > 0 ? (double) r.best_ns / (double) in->len : 0;
+
+		printf("%-40s %10zu %9.2f %9.2f %10llu %10ld%s\n", in->name,
+		    in->len, mbps, nspb, (unsigned long long) r.nodes, rss,
+		    r.has_error ? " (errors)" : "");
+
+		if (json != NULL) {
+			fprintf(json, "%s\n    {\"name\": ", i ? "," : "");
+			json_string(json, in->name);
+			fprintf(json,
+			    ", \"bytes\": %zu, \"best_ns\": %llu, "
+			    "\"mean_ns\": %llu, \"mb_per_s\": %.3f, "
+			    "\"ns_per_byte\": %.3f, \"nodes\": %llu, "
+			    "\"has_error\": %s, \"peak_rss_kb\": %ld}",
+			    in->len, (unsigned long long) r.best_ns,
+			    (unsigned long long) (r.total_ns / r.iterations),
+			    mbps, nspb, (unsigned long long) r.nodes,
+			    r.has_error ? "true" : "false", rss);
+		}
+	}
+
+	if (json != NULL) {
+		fprintf(json, "\n  ]\n}\n");
+		fclose(json);
+	}
+	return (rv);
+}
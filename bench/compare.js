@@ -0,0 +1,53 @@
+/*
+ * Compare two sets of benchmark results produced by bench.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// usage: node bench/compare.js baseline.json current.json [threshold%]
+//
+// Exits non-zero if any input common to both runs lost more than
+// threshold percent (default 5) of its throughput, or if its node
+// count or peak RSS grew by more than that amount.
+
+const fs = require("fs");
+
+const [baseFile, curFile, thresholdArg] = process.argv.slice(2);
+if (!baseFile || !curFile) {
+  console.error("usage: compare.js baseline.json current.json [threshold%]");
+  process.exit(2);
+}
+const threshold = Number(thresholdArg ?? 5) / 100;
+
+const load = (file) =>
+  new Map(JSON.parse(fs.readFileSync(file, "utf8")).inputs.map((r) => [r.name, r]));
+
+const base = load(baseFile);
+const cur = load(curFile);
+
+const pct = (a, b) => (a === 0 ? 0 : (b - a) / a);
+const fmt = (v) => `${v >= 0 ? "+" : ""}${(v * 100).toFixed(1)}%`;
+
+let failed = false;
+console.log(
+  `${"input".padEnd(40)} ${"MB/s".padStart(9)} ${"nodes".padStart(9)} ${"rss".padStart(9)}`,
+);
+for (const [name, b] of base) {
+  const c = cur.get(name);
+  if (!c) {
+    continue;
+  }
+  const speed = pct(b.mb_per_s, c.mb_per_s);
+  const nodes = pct(b.nodes, c.nodes);
+  const rss = pct(b.peak_rss_kb, c.peak_rss_kb);
+  const bad = speed < -threshold || nodes > threshold || rss > threshold;
+  failed ||= bad;
+  console.log(
+    `${name.padEnd(40)} ${fmt(speed).padStart(9)} ${fmt(nodes).padStart(9)} ${fmt(rss).padStart(9)}${bad ? "  REGRESSION" : ""}`,
+  );
+}
+process.exit(failed ? 1 : 0);
@@ -0,0 +1,146 @@
+/*
+ * Helpers for loading benchmark inputs.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "corpus.h"
+
+char *
+corpus_read_file(const char *path, size_t *lenp)
+{
+	FILE  *f;
+	char  *buf;
+	long   sz;
+	size_t n;
+
+	if ((f = fopen(path, "rb")) == NULL) {
+		return (NULL);
+	}
+	if ((fseek(f, 0, SEEK_END) != 0) || ((sz = ftell(f)) < 0) ||
+	    (fseek(f, 0, SEEK_SET) != 0)) {
+		fclose(f);
+		return (NULL);
+	}
+	if ((buf = malloc((size_t) sz + 1)) == NULL) {
+		fclose(f);
+		return (NULL);
+	}
+	n = fread(buf, 1, (size_t) sz, f);
+	fclose(f);
+	buf[n] = 0;
+	*lenp  = n;
+	return (buf);
+}
+
+static bool
+is_rule(const char *line, size_t len, char ch)
+{
+	// corpus separators are runs of at least three '=' or '-'
+	size_t i;
+	if (len < 3) {
+		return (false);
+	}
+	for (i = 0; i < len; i++) {
+		if (line[i] != ch) {
+			return (((line[i] == '\r') || (line[i] == '\n')) &&
+			    (i >= 3));
+		}
+	}
+	return (true);
+}
+
+// Extract the D sources from a tree-sitter corpus file.  The format is
+// a "===" header, a title, another "===" header, the source, a "---"
+// separator, and the expected tree.  We only care about the source.
+char *
+corpus_extract(const char *text, size_t len, size_t *outlen)
+{
+	char       *out;
+	size_t      n     = 0;
+	int         state = 0; // 0: tree, 1: title, 2: source
+	const char *p     = text;
+	const char *end   = text + len;
+
+	if ((out = malloc(len + 1)) == NULL) {
+		return (NULL);
+	}
+	while (p < end) {
+		const char *eol = memchr(p, '\n', (size_t) (end - p));
+		size_t      ll;
+
+		ll = eol ? (size_t) (eol - p) + 1 : (size_t) (end - p);
+
+		if (is_rule(p, ll, '=')) {
+			state = (state == 1) ? 2 : 1;
+		} else if ((state == 2) && is_rule(p, ll, '-')) {
+			state = 0;
+		} else if (state == 2) {
+			memcpy(out + n, p, ll);
+			n += ll;
+		}
+		p += ll;
+	}
+	out[n]  = 0;
+	*outlen = n;
+	return (out);
+}
+
+int
+corpus_foreach(const char *dir, corpus_cb cb, void *arg)
+{
+	struct dirent **ents;
+	char            path[1024];
+	char            name[1024];
+	int             n;
+	int             rv = 0;
+
+	// scandir so that the corpus is always visited in the same order
+	if ((n = scandir(dir, &ents, NULL, alphasort)) < 0) {
+		return (errno);
+	}
+	for (int i = 0; i < n; i++) {
+		const char *fn = ents[i]->d_name;
+		size_t      nl = strlen(fn);
+		char       *raw;
+		char       *src;
+		size_t      rawlen;
+		size_t      srclen;
+
+		if ((rv != 0) || (nl < 5) ||
+		    (strcmp(fn + nl - 4, ".scm") != 0)) {
+			free(ents[i]);
+			continue;
+		}
+		snprintf(path, sizeof(path), "%s/%s", dir, fn);
+		snprintf(name, sizeof(name), "corpus/%s", fn);
+		free(ents[i]);
+		if ((raw = corpus_read_file(path, &rawlen)) == NULL) {
+			rv = errno;
+			continue;
+		}
+		src = corpus_extract(raw, rawlen, &srclen);
+		free(raw);
+		if (src == NULL) {
+			rv = ENOMEM;
+			continue;
+		}
+		cb(name, src, srclen, arg);
+	}
+	free(ents);
+	return (rv);
+}
@@ -0,0 +1,29 @@
+/*
+ * Helpers for loading benchmark inputs.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+#ifndef BENCH_CORPUS_H
+#define BENCH_CORPUS_H
+
+#include <stddef.h>
+
+// corpus_read_file reads an entire file into a NUL terminated buffer,
+// which the caller must free.  It returns NULL (with errno set) on failure.
+extern char *corpus_read_file(const char *path, size_t *lenp);
+
+// corpus_extract returns just the D sources from the text of a
+// tree-sitter corpus file, concatenated.  The caller must free the result.
+extern char *corpus_extract(const char *text, size_t len, size_t *outlen);
+
+// corpus_foreach calls cb for each corpus file in dir, in name order,
+// with the extracted sources (which the callback then owns).  The name
+// passed is "corpus/<file>".  It returns 0 on success, or an errno.
+typedef void (*corpus_cb)(const char *name, char *src, size_t len, void *arg);
+extern int corpus_foreach(const char *dir, corpus_cb cb, void *arg);
+
+#endif // BENCH_CORPUS_H
@@ -0,0 +1,486 @@
+/*
+ * GLR stack split statistics for the D grammar.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// Every entry in the grammar's conflicts list leaves parse table cells
+// with more than one action, and each time the parser reaches such a
+// cell it splits its stack, and carries on with one version per action
+// until all but one of them fail or are merged.  This program finds
+// those cells in the generated parse table, and then parses inputs with
+// a logger attached to count how often each conflict is actually hit,
+// and how many extra stack versions it costs.
+//
+// Conflicts are named by the actions in their cells; for example a cell
+// that can reduce either a storage_class or a type is reported as
+// "storage_class / type", which is the [$.storage_class, $.type] entry
+// in grammar.js.  A "shift" in the name means the parser may also shift
+// the lookahead instead.
+//
+// The parser only logs the state at the start of each step, so cells
+// reached in the middle of a chain of reductions are not attributed.
+// The total number of versions created and merged (from the version
+// counts that are logged) is reported as well, so the coverage of the
+// attribution can be judged.
+//
+// This reads the parse table from the TSLanguage structure directly,
+// and so depends on the layout in src/tree_sitter/parser.h.
+
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tree_sitter/api.h>
+
+#include "../src/tree_sitter/parser.h"
+#include "corpus.h"
+#include "tree-sitter-d.h"
+
+typedef struct {
+	char    *name;  // actions in the cell, e.g. "storage_class / type"
+	uint64_t cells; // parse table cells with this conflict
+	uint64_t hits;  // times the parser reached one of them
+	uint64_t forks; // extra stack versions created
+} conflict;
+
+typedef struct {
+	const TSLanguage *lang;
+	conflict         *conflicts;
+	size_t            nconflicts;
+	int32_t          *by_action; // conflict index for each action entry
+	uint32_t          nactions;
+
+	// runtime state, updated by the logger
+	TSStateId state;      // state at the start of the current step
+	bool      in_step;    // a step is in progress, not yet attributed
+	TSSymbol  lookahead;  // last lookahead seen
+	bool      have_ahead; // lookahead is valid
+	uint32_t  versions;   // version count at the last step
+	uint64_t  steps;
+	uint64_t  splits; // total growth in the number of versions
+	uint64_t  merges; // total shrinkage in the number of versions
+	uint32_t  max_versions;
+} stats;
+
+static uint16_t
+table_lookup(const TSLanguage *l, TSStateId state, TSSymbol symbol)
+{
+	if (state >= l->large_state_count) {
+		uint32_t        index;
+		const uint16_t *data;
+		uint16_t        groups;
+
+		index  = state - l->large_state_count;
+		index  = l->small_parse_table_map[index];
+		data   = &l->small_parse_table[index];
+		groups = *(data++);
+
+		for (unsigned i = 0; i < groups; i++) {
+			uint16_t value = *(data++);
+			uint16_t count = *(data++);
+			for (unsigned j = 0; j < count; j++) {
+				if (*(data++) == symbol) {
+					return (value);
+				}
+			}
+		}
+		return (0);
+	}
+	return (l->parse_table[state * l->symbol_count + symbol]);
+}
+
+// real_actions counts the actions in an entry that split the stack;
+// repetition shifts and recoveries do not.
+static unsigned
+real_actions(const TSLanguage *l, uint16_t index)
+{
+	unsigned n     = 0;
+	unsigned count = l->parse_actions[index].entry.count;
+
+	for (unsigned i = 1; i <= count; i++) {
+		const TSParseAction *a = &l->parse_actions[index + i].action;
+		if (((a->type == TSParseActionTypeShift) &&
+		        a->shift.repetition) ||
+		    (a->type == TSParseActionTypeRecover)) {
+			continue;
+		}
+		n++;
+	}
+	return (n);
+}
+
+static int
+cmp_str(const void *a, const void *b)
+{
+	return (strcmp(*(const char *const *) a, *(const char *const *) b));
+}
+
+static char *
+conflict_name(const TSLanguage *l, uint16_t index)
+{
+	const char *names[256];
+	unsigned    count = l->parse_actions[index].entry.count;
+	unsigned    n     = 0;
+	size_t      len   = 1;
+	char       *name;
+
+	for (unsigned i = 1; i <= count; i++) {
+		const TSParseAction *a = &l->parse_actions[index + i].action;
+		switch (a->type) {
+		case TSParseActionTypeShift:
+			if (!a->shift.repetition) {
+				names[n++] = "shift";
+			}
+			break;
+		case TSParseActionTypeReduce:
+			names[n++] =
+			    ts_language_symbol_name(l, a->reduce.symbol);
+			break;
+		case TSParseActionTypeAccept:
+			names[n++] = "accept";
+			break;
+		}
+	}
+	qsort(names, n, sizeof(names[0]), cmp_str);
+	for (unsigned i = 0; i < n; i++) {
+		len += strlen(names[i]) + 3;
+	}
+	name  = malloc(len);
+	*name = 0;
+	for (unsigned i = 0; i < n; i++) {
+		// the same symbol may be reduced by more than one production
+		if ((i > 0) && (strcmp(names[i], names[i - 1]) == 0)) {
+			continue;
+		}
+		if (*name != 0) {
+			strcat(name, " / ");
+		}
+		strcat(name, names[i]);
+	}
+	return (name);
+}
+
+// scan_table finds every cell in the parse table with a conflict.
+static void
+scan_table(stats *st)
+{
+	const TSLanguage *l = st->lang;
+
+	for (TSStateId s = 0; s < l->state_count; s++) {
+		for (TSSymbol t = 0; t < l->token_count; t++) {
+			uint16_t idx = table_lookup(l, s, t);
+			char    *name;
+			size_t   c;
+
+			if ((idx == 0) || (real_actions(l, idx) < 2)) {
+				continue;
+			}
+			if (idx >= st->nactions) {
+				uint32_t n = (uint32_t) idx + 1;
+				st->by_action = realloc(
+				    st->by_action, sizeof(int32_t) * n);
+				for (uint32_t i = st->nactions; i < n; i++) {
+					st->by_action[i] = -1;
+				}
+				st->nactions = n;
+			}
+			if (st->by_action[idx] >= 0) {
+				st->conflicts[st->by_action[idx]].cells++;
+				continue;
+			}
+			name = conflict_name(l, idx);
+			for (c = 0; c < st->nconflicts; c++) {
+				if (strcmp(st->conflicts[c].name, name) == 0) {
+					break;
+				}
+			}
+			if (c == st->nconflicts) {
+				st->conflicts = realloc(st->conflicts,
+				    sizeof(conflict) * (st->nconflicts + 1));
+				memset(&st->conflicts[c], 0, sizeof(conflict));
+				st->conflicts[c].name = name;
+				st->nconflicts++;
+			} else {
+				free(name);
+			}
+			st->by_action[idx] = (int32_t) c;
+			st->conflicts[c].cells++;
+		}
+	}
+}
+
+// find_token looks up a terminal by the name the parser logs for it.
+// Names are not unique (e.g. a keyword and a named rule of the same
+// name), so we want the one that has an action in the current state.
+static bool
+find_token(stats *st, const char *name, size_t len, TSSymbol *symp)
+{
+	const TSLanguage *l = st->lang;
+
+	for (TSSymbol t = 0; t < l->token_count; t++) {
+		const char *sn = ts_language_symbol_name(l, t);
+		if ((strncmp(sn, name, len) == 0) && (sn[len] == 0) &&
+		    (table_lookup(l, st->state, t) != 0)) {
+			*symp = t;
+			return (true);
+		}
+	}
+	return (false);
+}
+
+// attribute charges the current step to a conflict, if its cell has one.
+static void
+attribute(stats *st)
+{
+	uint16_t idx;
+	int32_t  c;
+
+	st->in_step = false;
+	if (!st->have_ahead) {
+		return;
+	}
+	idx = table_lookup(st->lang, st->state, st->lookahead);
+	if ((idx >= st->nactions) || ((c = st->by_action[idx]) < 0)) {
+		return;
+	}
+	st->conflicts[c].hits++;
+	st->conflicts[c].forks += real_actions(st->lang, idx) - 1;
+}
+
+static void
+logger(void *arg, TSLogType type, const char *msg)
+{
+	stats      *st = arg;
+	unsigned    version;
+	unsigned    count;
+	int         state;
+
+	if (type != TSLogTypeParse) {
+		return;
+	}
+	if (sscanf(msg, "process version:%u, version_count:%u, state:%d",
+	        &version, &count, &state) == 3) {
+		if (st->in_step) {
+			attribute(st);
+		}
+		if (count > st->versions) {
+			st->splits += count - st->versions;
+		} else {
+			st->merges += st->versions - count;
+		}
+		if (count > st->max_versions) {
+			st->max_versions = count;
+		}
+		st->versions = count;
+		st->state    = (TSStateId) state;
+		st->in_step  = true;
+		st->steps++;
+		return;
+	}
+	if (!st->in_step) {
+		return;
+	}
+	if ((strncmp(msg, "lexed_lookahead sym:", 20) == 0) ||
+	    (strncmp(msg, "reused_lookahead sym:", 21) == 0)) {
+		const char *name = strchr(msg, ':') + 1;
+		const char *end  = strstr(name, ", size:");
+		size_t      len  = end ? (size_t) (end - name) : strlen(name);
+		st->have_ahead   = find_token(st, name, len, &st->lookahead);
+		attribute(st);
+		return;
+	}
+	if ((strncmp(msg, "shift", 5) == 0) ||
+	    (strncmp(msg, "reduce", 6) == 0) ||
+	    (strncmp(msg, "accept", 6) == 0)) {
+		// the lookahead came from the token cache, so it is the
+		// same one that we saw last
+		attribute(st);
+	}
+}
+
+static void
+parse_input(stats *st, TSParser *parser, const char *src, size_t len)
+{
+	TSTree *tree;
+
+	st->versions   = 1;
+	st->in_step    = false;
+	st->have_ahead = false;
+	tree = ts_parser_parse_string(parser, NULL, src, (uint32_t) len);
+	if (st->in_step) {
+		attribute(st);
+	}
+	ts_tree_delete(tree);
+}
+
+typedef struct {
+	stats    *st;
+	TSParser *parser;
+	size_t    inputs;
+	size_t    bytes;
+} run;
+
+static void
+parse_corpus_input(const char *name, char *src, size_t len, void *arg)
+{
+	run *r = arg;
+	(void) name;
+	parse_input(r->st, r->parser, src, len);
+	r->inputs++;
+	r->bytes += len;
+	free(src);
+}
+
+static int
+cmp_conflict(const void *a, const void *b)
+{
+	const conflict *x = a;
+	const conflict *y = b;
+	if (x->forks != y->forks) {
+		return (x->forks < y->forks ? 1 : -1);
+	}
+	return (strcmp(x->name, y->name));
+}
+
+static void
+json_string(FILE *f, const char *s)
+{
+	fputc('"', f);
+	for (; *s; s++) {
+		if ((*s == '"') || (*s == '\\')) {
+			fputc('\\', f);
+		}
+		fputc(*s, f);
+	}
+	fputc('"', f);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+	    "usage: glr_stats [-c corpus-dir] [-o results.json] "
+	    "[file.d ...]\n");
+	exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *outfile = NULL;
+	const char *corpus  = NULL;
+	stats       st;
+	run         r;
+	uint64_t    forks = 0;
+	int         opt;
+
+	while ((opt = getopt(argc, argv, "c:o:")) != -1) {
+		switch (opt) {
+		case 'c':
+			corpus = optarg;
+			break;
+		case 'o':
+			outfile = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if ((corpus == NULL) && (optind == argc)) {
+		usage();
+	}
+
+	memset(&st, 0, sizeof(st));
+	memset(&r, 0, sizeof(r));
+	st.lang = tree_sitter_d();
+	scan_table(&st);
+
+	r.st     = &st;
+	r.parser = ts_parser_new();
+	ts_parser_set_language(r.parser, st.lang);
+	ts_parser_set_logger(r.parser, (TSLogger) { &st, logger });
+
+	if (corpus != NULL) {
+		int rv;
+		rv = corpus_foreach(corpus, parse_corpus_input, &r);
+		if (rv != 0) {
+			fprintf(stderr, "glr_stats: %s: %s\n", corpus,
+			    strerror(rv));
+			return (1);
+		}
+	}
+	for (int i = optind; i < argc; i++) {
+		size_t len;
+		char  *src;
+		if ((src = corpus_read_file(argv[i], &len)) == NULL) {
+			fprintf(stderr, "glr_stats: %s: %s\n", argv[i],
+			    strerror(errno));
+			return (1);
+		}
+		parse_corpus_input(argv[i], src, len, &r);
+	}
+	ts_parser_delete(r.parser);
+
+	qsort(st.conflicts, st.nconflicts, sizeof(conflict), cmp_conflict);
+	for (size_t i = 0; i < st.nconflicts; i++) {
+		forks += st.conflicts[i].forks;
+	}
+
+	printf("%zu inputs, %zu bytes, %llu steps\n", r.inputs, r.bytes,
+	    (unsigned long long) st.steps);
+	printf("versions created %llu, merged or dropped %llu, "
+	       "attributed %llu, most at once %u\n\n",
+	    (unsigned long long) st.splits, (unsigned long long) st.merges,
+	    (unsigned long long) forks, st.max_versions);
+	printf("%-50s %7s %9s %9s\n", "conflict", "cells", "hits", "forks");
+	for (size_t i = 0; i < st.nconflicts; i++) {
+		const conflict *c = &st.conflicts[i];
+		printf("%-50s %7llu %9llu %9llu\n", c->name,
+		    (unsigned long long) c->cells,
+		    (unsigned long long) c->hits,
+		    (unsigned long long) c->forks);
+	}
+
+	if (outfile != NULL) {
+		FILE *json;
+		if ((json = fopen(outfile, "w")) == NULL) {
+			fprintf(stderr, "glr_stats: %s: %s\n", outfile,
+			    strerror(errno));
+			return (1);
+		}
+		fprintf(json,
+		    "{\n  \"inputs\": %zu,\n  \"bytes\": %zu,\n"
+		    "  \"steps\": %llu,\n  \"versions_created\": %llu,\n"
+		    "  \"versions_merged\": %llu,\n  \"max_versions\": %u,\n"
+		    "  \"conflicts\": [",
+		    r.inputs, r.bytes, (unsigned long long) st.steps,
+		    (unsigned long long) st.splits,
+		    (unsigned long long) st.merges, st.max_versions);
+		for (size_t i = 0; i < st.nconflicts; i++) {
+			const conflict *c = &st.conflicts[i];
+			fprintf(json, "%s\n    {\"name\": ", i ? "," : "");
+			json_string(json, c->name);
+			fprintf(json,
+			    ", \"cells\": %llu, \"hits\": %llu, "
+			    "\"forks\": %llu}",
+			    (unsigned long long) c->cells,
+			    (unsigned long long) c->hits,
+			    (unsigned long long) c->forks);
+		}
+		fprintf(json, "\n  ]\n}\n");
+		fclose(json);
+	}
+	return (0);
+}
@@ -0,0 +1,170 @@
+#
+# Copyright 2024 Garrett D'Amore
+#
+# Distributed under the MIT License.
+# (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+# SPDX-License-Identifier: MIT
+#
+
+"""Compare tree_sitter_d.parse_files with parsing one file at a time.
+
+usage: python3 bench/parse_files_bench.py [-n iterations] [-j threads]
+           [-c corpus-dir] [-o results.json] [file.d or directory ...]
+
+The baseline is what a batch job does today: a tree_sitter.Parser used
+from a single Python thread, collecting the same summary (error flag,
+module name and top-level declarations) that parse_files returns.  Then
+parse_files is run with one thread, and with each thread count given by
+-j (by default 2, 4 and so on up to the number of CPUs).  The best of
+the iterations is reported for each.
+"""
+
+import argparse
+import json
+import os
+import sys
+import time
+
+import tree_sitter_d
+
+
+def corpus_sources(directory):
+    """The D sources of each test in a tree-sitter corpus directory."""
+    for name in sorted(os.listdir(directory)):
+        if not name.endswith(".scm"):
+            continue
+        with open(os.path.join(directory, name), "rb") as f:
+            lines = f.read().splitlines(keepends=True)
+        src = []
+        state = 0  # 0: tree, 1: title, 2: source
+        for line in lines:
+            rule = line.rstrip(b"\r\n")
+            if len(rule) >= 3 and rule == b"=" * len(rule):
+                state = 2 if state == 1 else 1
+            elif state == 2 and len(rule) >= 3 and rule == b"-" * len(rule):
+                state = 0
+            elif state == 2:
+                src.append(line)
+        yield b"".join(src)
+
+
+def d_files(path):
+    if not os.path.isdir(path):
+        yield path
+        return
+    for root, _, files in os.walk(path):
+        for name in sorted(files):
+            if name.endswith((".d", ".di")):
+                yield os.path.join(root, name)
+
+
+def decl_name(node, src):
+    for c in node.named_children:
+        if c.type == "identifier":
+            return src[c.start_byte : c.end_byte].decode()
+    for c in node.named_children:
+        if c.type in ("declarator", "manifest_declarator"):
+            for i in c.named_children:
+                if i.type == "identifier":
+                    return src[i.start_byte : i.end_byte].decode()
+            break
+    return None
+
+
+def summarize(tree, src):
+    """The same summary that parse_files computes natively."""
+    module = None
+    decls = []
+    nodes = list(tree.root_node.named_children)
+    while nodes:
+        node = nodes.pop(0)
+        if node.type == "comment":
+            continue
+        if node.type == "module_def":
+            nodes[0:0] = node.named_children
+        elif node.type == "module_declaration":
+            for c in node.named_children:
+                if c.type == "module_fqn" and module is None:
+                    module = src[c.start_byte : c.end_byte].decode()
+        else:
+            decls.append((node.type, decl_name(node, src), node.start_byte, node.end_byte))
+    return tree.root_node.has_error, module, decls
+
+
+def baseline(items):
+    from tree_sitter import Language, Parser
+
+    parser = Parser(Language(tree_sitter_d.language()))
+    for item in items:
+        if isinstance(item, bytes):
+            src = item
+        else:
+            with open(item, "rb") as f:
+                src = f.read()
+        summarize(parser.parse(src), src)
+
+
+def measure(fn, iterations):
+    best = None
+    for _ in range(iterations):
+        start = time.perf_counter()
+        fn()
+        elapsed = time.perf_counter() - start
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("-n", type=int, default=5, help="iterations")
+    ap.add_argument("-j", type=int, action="append", help="thread count")
+    ap.add_argument("-c", help="tree-sitter corpus directory")
+    ap.add_argument("-o", help="write results as JSON")
+    ap.add_argument("paths", nargs="*")
+    args = ap.parse_args()
+
+    if not hasattr(tree_sitter_d, "parse_files"):
+        sys.exit("parse_files_bench: tree_sitter_d was built without parse_files")
+
+    items = []
+    if args.c:
+        items.extend(corpus_sources(args.c))
+    for p in args.paths:
+        items.extend(d_files(p))
+    if not items:
+        ap.error("no inputs")
+
+    size = sum(len(i) if isinstance(i, bytes) else os.path.getsize(i) for i in items)
+    cpus = os.cpu_count() or 1
+    threads = args.j or sorted({1, *range(2, cpus + 1, 2), cpus})
+
+    runs = []
+    try:
+        runs.append(("tree_sitter.Parser", measure(lambda: baseline(items), args.n)))
+    except ImportError:
+        print("tree_sitter is not installed, no baseline", file=sys.stderr)
+    for t in threads:
+        runs.append(
+            (
+                f"parse_files threads={t}",
+                measure(lambda: tree_sitter_d.parse_files(items, t), args.n),
+            )
+        )
+
+    print(f"{len(items)} inputs, {size} bytes, best of {args.n}\n")
+    print(f"{'method':<30} {'seconds':>10} {'MB/s':>9} {'speedup':>8}")
+    results = []
+    for name, secs in runs:
+        speedup = runs[0][1] / secs
+        mbps = size / 1e6 / secs
+        print(f"{name:<30} {secs:>10.4f} {mbps:>9.2f} {speedup:>7.2f}x")
+        results.append({"method": name, "seconds": secs, "mb_per_s": mbps, "speedup": speedup})
+
+    if args.o:
+        with open(args.o, "w") as f:
+            json.dump({"inputs": len(items), "bytes": size, "iterations": args.n, "runs": results}, f, indent=2)
+            f.write("\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,295 @@
+/*
+ * Benchmark of walking only the active conditional branches.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// Sources like druntime's core.sys bindings declare the same things once
+// for each platform, in version (...) else version (...) chains, so most
+// of the tree is code that no build for one platform will see.  This
+// program tags such sources twice, once with the whole tree walked, and
+// once with only the active branches walked, and reports the time and
+// the nodes visited and tags found by each.
+//
+// The inputs are the files given, or else a source generated to look
+// like druntime's, with a chain of branches for each of a number of
+// platforms.  The active versions are given with -V (default "linux").
+
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <tree_sitter/api.h>
+
+#include "corpus.h"
+#include "tree-sitter-d-conditions.h"
+#include "tree-sitter-d-tags.h"
+#include "tree-sitter-d.h"
+
+static const char *platforms[] = {
+	"linux",
+	"Darwin",
+	"FreeBSD",
+	"NetBSD",
+	"OpenBSD",
+	"DragonFlyBSD",
+	"Solaris",
+	"CRuntime_Bionic",
+	"CRuntime_Musl",
+	"Windows",
+};
+#define NPLATFORMS (sizeof(platforms) / sizeof(platforms[0]))
+
+typedef struct {
+	char  *buf;
+	size_t len;
+	size_t cap;
+} text;
+
+static void
+put(text *t, const char *fmt, ...)
+{
+	va_list ap;
+	int     n;
+
+	for (;;) {
+		va_start(ap, fmt);
+		n = vsnprintf(t->buf + t->len, t->cap - t->len, fmt, ap);
+		va_end(ap);
+		if ((n >= 0) && ((size_t) n < t->cap - t->len)) {
+			t->len += (size_t) n;
+			return;
+		}
+		t->cap = t->cap ? t->cap * 2 : 65536;
+		if ((t->buf = realloc(t->buf, t->cap)) == NULL) {
+			fprintf(stderr, "prune_bench: out of memory\n");
+			exit(1);
+		}
+	}
+}
+
+// generate makes a druntime style source, with blocks of declarations,
+// each with a branch per platform.
+static char *
+generate(int blocks, size_t *lenp)
+{
+	text t = { 0 };
+
+	put(&t, "module core.sys.posix.generated;\n\n");
+	put(&t, "version (OSX) version = Darwin;\n");
+	put(&t, "else version (iOS) version = Darwin;\n\n");
+	for (int b = 0; b < blocks; b++) {
+		for (size_t p = 0; p < NPLATFORMS; p++) {
+			put(&t, "%sversion (%s)\n{\n", p ? "else " : "",
+			    platforms[p]);
+			put(&t, "    struct stat%d_t\n    {\n", b);
+			for (int f = 0; f < 8; f++) {
+				put(&t, "        ulong st_field%d;\n", f);
+			}
+			put(&t, "    }\n\n    enum\n    {\n");
+			for (int e = 0; e < 8; e++) {
+				put(&t, "        S_FLAG%d_%d = 0x%x,\n", b, e,
+				    (1 << e) + (int) p);
+			}
+			put(&t, "    }\n\n");
+			put(&t,
+			    "    extern (C) int fstat%d(int, stat%d_t*);\n", b,
+			    b);
+			put(&t,
+			    "    int stat%d(int fd, stat%d_t* buf)\n    {\n"
+			    "        debug (posix) trace(\"stat%d\");\n"
+			    "        return fstat%d(fd, buf);\n    }\n",
+			    b, b, b, b);
+			put(&t, "}\n");
+		}
+		put(&t, "else\n{\n    static assert(false, "
+		        "\"unsupported platform\");\n}\n\n");
+	}
+	*lenp = t.len;
+	return (t.buf);
+}
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec);
+}
+
+typedef struct {
+	uint64_t nodes;
+	uint64_t tags;
+	uint64_t ns;
+} result;
+
+static void
+count_tag(const ts_d_tag *tag, void *arg)
+{
+	(void) tag;
+	((result *) arg)->tags++;
+}
+
+static bool
+count_node(TSNode node, void *arg)
+{
+	(void) node;
+	((result *) arg)->nodes++;
+	return (true);
+}
+
+static uint64_t
+count_all(TSNode node)
+{
+	TSTreeCursor c = ts_tree_cursor_new(node);
+	uint64_t     n = 0;
+
+	for (;;) {
+		n++;
+		if (ts_tree_cursor_goto_first_child(&c)) {
+			continue;
+		}
+		while (!ts_tree_cursor_goto_next_sibling(&c)) {
+			if (!ts_tree_cursor_goto_parent(&c)) {
+				ts_tree_cursor_delete(&c);
+				return (n);
+			}
+		}
+	}
+}
+
+static void
+run(const char *name, const char *src, size_t len, int iterations,
+    ts_d_tagger *tagger, const ts_d_config *cfg, TSParser *parser)
+{
+	TSTree  *tree;
+	TSNode   root;
+	result   all    = { 0 };
+	result   active = { 0 };
+	uint64_t start;
+
+	tree = ts_parser_parse_string(parser, NULL, src, (uint32_t) len);
+	root = ts_tree_root_node(tree);
+
+	all.nodes = count_all(root);
+	ts_d_walk(cfg, root, src, count_node, &active);
+	all.ns    = UINT64_MAX;
+	active.ns = UINT64_MAX;
+	for (int i = 0; i < iterations; i++) {
+		uint64_t t;
+		all.tags    = 0;
+		active.tags = 0;
+
+		start = now_ns();
+		ts_d_tagger_run(tagger, root, count_tag, &all);
+		if ((t = now_ns() - start) < all.ns) {
+			all.ns = t;
+		}
+
+		start = now_ns();
+		ts_d_tagger_run_active(
+		    tagger, cfg, root, src, count_tag, &active);
+		if ((t = now_ns() - start) < active.ns) {
+			active.ns = t;
+		}
+	}
+	printf("%s: %zu bytes\n", name, len);
+	printf("  %-8s %10llu nodes %8llu tags %10.3f ms\n", "all",
+	    (unsigned long long) all.nodes, (unsigned long long) all.tags,
+	    (double) all.ns / 1e6);
+	printf("  %-8s %10llu nodes %8llu tags %10.3f ms  (%.2fx)\n",
+	    "active", (unsigned long long) active.nodes,
+	    (unsigned long long) active.tags, (double) active.ns / 1e6,
+	    (double) all.ns / (double) (active.ns ? active.ns : 1));
+	ts_tree_delete(tree);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+	    "usage: prune_bench [-n iterations] [-b blocks] [-V version] "
+	    "[-D debug] [file.d ...]\n");
+	exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+	int          iterations = 10;
+	int          blocks     = 200;
+	bool         versions   = false;
+	ts_d_config *cfg;
+	ts_d_tagger *tagger;
+	TSParser    *parser;
+	int          opt;
+
+	if (((cfg = ts_d_config_new(tree_sitter_d())) == NULL) ||
+	    ((tagger = ts_d_tagger_new(tree_sitter_d())) == NULL)) {
+		fprintf(stderr, "prune_bench: walkers do not match grammar\n");
+		return (1);
+	}
+	while ((opt = getopt(argc, argv, "n:b:V:D:")) != -1) {
+		switch (opt) {
+		case 'n':
+			if ((iterations = atoi(optarg)) < 1) {
+				usage();
+			}
+			break;
+		case 'b':
+			if ((blocks = atoi(optarg)) < 1) {
+				usage();
+			}
+			break;
+		case 'V':
+			ts_d_config_version(cfg, optarg);
+			versions = true;
+			break;
+		case 'D':
+			ts_d_config_debug(cfg, optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (!versions) {
+		ts_d_config_version(cfg, "linux");
+	}
+
+	parser = ts_parser_new();
+	ts_parser_set_language(parser, tree_sitter_d());
+	if (optind == argc) {
+		size_t len;
+		char  *src = generate(blocks, &len);
+		run("generated", src, len, iterations, tagger, cfg, parser);
+		free(src);
+	}
+	for (int i = optind; i < argc; i++) {
+		size_t len;
+		char  *src;
+		if ((src = corpus_read_file(argv[i], &len)) == NULL) {
+			fprintf(stderr, "prune_bench: %s: %s\n", argv[i],
+			    strerror(errno));
+			return (1);
+		}
+		run(argv[i], src, len, iterations, tagger, cfg, parser);
+		free(src);
+	}
+	ts_parser_delete(parser);
+	ts_d_tagger_delete(tagger);
+	ts_d_config_delete(cfg);
+	return (0);
+}
@@ -0,0 +1,270 @@
+/*
+ * Query compilation benchmark for the D grammar.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// This program measures what the compiled query caches in the bindings
+// save.  For each query it reports the time to read the file and
+// compile it, which is what a tool pays every time it starts (or every
+// request, without a cache).  It then runs a short-lived tool, such as
+// a pre-commit hook, over the corpus inputs: each input is parsed and
+// the highlights and tags queries are run over it, first compiling the
+// queries for every input, and then compiling them once and sharing
+// them, as the caches do.  The difference is the time saved.
+
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <tree_sitter/api.h>
+
+#include "corpus.h"
+#include "tree-sitter-d.h"
+
+static const char *query_names[] = {
+	"highlights",
+	"injections",
+	"tags",
+	"indents",
+	"textobjects",
+};
+#define NQUERIES (sizeof(query_names) / sizeof(query_names[0]))
+
+typedef struct {
+	char  *text;
+	size_t len;
+} input;
+
+static input *inputs;
+static size_t ninputs;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec);
+}
+
+static void
+add_corpus_input(const char *name, char *src, size_t len, void *arg)
+{
+	input *ni;
+	(void) name;
+	(void) arg;
+	if ((ni = realloc(inputs, sizeof(input) * (ninputs + 1))) == NULL) {
+		fprintf(stderr, "query_bench: out of memory\n");
+		exit(1);
+	}
+	inputs               = ni;
+	inputs[ninputs].text = src;
+	inputs[ninputs].len  = len;
+	ninputs++;
+}
+
+// load_query reads and compiles a query, as a tool does at startup.
+static TSQuery *
+load_query(const char *dir, const char *name)
+{
+	char         path[1024];
+	char        *src;
+	size_t       len;
+	uint32_t     offset;
+	TSQueryError err;
+	TSQuery     *q;
+
+	snprintf(path, sizeof(path), "%s/%s.scm", dir, name);
+	if ((src = corpus_read_file(path, &len)) == NULL) {
+		fprintf(stderr, "query_bench: %s: %s\n", path,
+		    strerror(errno));
+		exit(1);
+	}
+	q = ts_query_new(tree_sitter_d(), src, (uint32_t) len, &offset, &err);
+	if (q == NULL) {
+		fprintf(stderr, "query_bench: %s: error %d at offset %u\n",
+		    path, (int) err, offset);
+		exit(1);
+	}
+	free(src);
+	return (q);
+}
+
+static uint64_t
+run_query(TSQueryCursor *cursor, const TSQuery *q, TSNode root)
+{
+	TSQueryMatch m;
+	uint64_t     n = 0;
+
+	ts_query_cursor_exec(cursor, q, root);
+	while (ts_query_cursor_next_match(cursor, &m)) {
+		n++;
+	}
+	return (n);
+}
+
+// run_tool processes every input, with the highlights and tags queries
+// either compiled once up front (cached) or again for every input.
+static uint64_t
+run_tool(const char *dir, TSParser *parser, bool cached)
+{
+	TSQueryCursor *cursor  = ts_query_cursor_new();
+	TSQuery       *hl      = NULL;
+	TSQuery       *tags    = NULL;
+	uint64_t       start   = now_ns();
+	uint64_t       matches = 0;
+
+	for (size_t i = 0; i < ninputs; i++) {
+		TSTree *tree;
+		if (hl == NULL) {
+			hl   = load_query(dir, "highlights");
+			tags = load_query(dir, "tags");
+		}
+		tree = ts_parser_parse_string(
+		    parser, NULL, inputs[i].text, (uint32_t) inputs[i].len);
+		matches += run_query(cursor, hl, ts_tree_root_node(tree));
+		matches += run_query(cursor, tags, ts_tree_root_node(tree));
+		ts_tree_delete(tree);
+		if (!cached) {
+			ts_query_delete(hl);
+			ts_query_delete(tags);
+			hl   = NULL;
+			tags = NULL;
+		}
+	}
+	if (hl != NULL) {
+		ts_query_delete(hl);
+		ts_query_delete(tags);
+	}
+	ts_query_cursor_delete(cursor);
+	(void) matches;
+	return (now_ns() - start);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+	    "usage: query_bench [-n iterations] [-q query-dir] "
+	    "[-c corpus-dir] [-o results.json]\n");
+	exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *outfile    = NULL;
+	const char *dir        = "queries";
+	const char *corpus     = "test/corpus";
+	int         iterations = 10;
+	uint64_t    compile_ns[NQUERIES];
+	uint64_t    uncached_ns = UINT64_MAX;
+	uint64_t    cached_ns   = UINT64_MAX;
+	uint64_t    startup_ns  = 0;
+	TSParser   *parser;
+	int         opt;
+	int         rv;
+
+	while ((opt = getopt(argc, argv, "n:q:c:o:")) != -1) {
+		switch (opt) {
+		case 'n':
+			if ((iterations = atoi(optarg)) < 1) {
+				usage();
+			}
+			break;
+		case 'q':
+			dir = optarg;
+			break;
+		case 'c':
+			corpus = optarg;
+			break;
+		case 'o':
+			outfile = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if ((rv = corpus_foreach(corpus, add_corpus_input, NULL)) != 0) {
+		fprintf(stderr, "query_bench: %s: %s\n", corpus, strerror(rv));
+		return (1);
+	}
+
+	// best of the iterations, for each query
+	for (size_t q = 0; q < NQUERIES; q++) {
+		compile_ns[q] = UINT64_MAX;
+		for (int i = 0; i < iterations; i++) {
+			uint64_t start = now_ns();
+			uint64_t elapsed;
+			ts_query_delete(load_query(dir, query_names[q]));
+			elapsed = now_ns() - start;
+			if (elapsed < compile_ns[q]) {
+				compile_ns[q] = elapsed;
+			}
+		}
+		startup_ns += compile_ns[q];
+	}
+
+	parser = ts_parser_new();
+	ts_parser_set_language(parser, tree_sitter_d());
+	for (int i = 0; i < iterations; i++) {
+		uint64_t t;
+		if ((t = run_tool(dir, parser, false)) < uncached_ns) {
+			uncached_ns = t;
+		}
+		if ((t = run_tool(dir, parser, true)) < cached_ns) {
+			cached_ns = t;
+		}
+	}
+	ts_parser_delete(parser);
+
+	printf("%-20s %12s\n", "query", "compile(us)");
+	for (size_t q = 0; q < NQUERIES; q++) {
+		printf("%-20s %12.1f\n", query_names[q],
+		    (double) compile_ns[q] / 1e3);
+	}
+	printf("%-20s %12.1f\n\n", "all", (double) startup_ns / 1e3);
+	printf("tool over %zu inputs, highlights and tags queries:\n",
+	    ninputs);
+	printf("  compiled per input %10.1f ms\n", (double) uncached_ns / 1e6);
+	printf("  compiled once      %10.1f ms\n", (double) cached_ns / 1e6);
+	printf("  saved              %10.1f ms\n",
+	    ((double) uncached_ns - (double) cached_ns) / 1e6);
+
+	if (outfile != NULL) {
+		FILE *json;
+		if ((json = fopen(outfile, "w")) == NULL) {
+			fprintf(stderr, "query_bench: %s: %s\n", outfile,
+			    strerror(errno));
+			return (1);
+		}
+		fprintf(json, "{\n  \"iterations\": %d,\n  \"compile_ns\": {",
+		    iterations);
+		for (size_t q = 0; q < NQUERIES; q++) {
+			fprintf(json, "%s\n    \"%s\": %llu", q ? "," : "",
+			    query_names[q],
+			    (unsigned long long) compile_ns[q]);
+		}
+		fprintf(json,
+		    "\n  },\n  \"startup_ns\": %llu,\n  \"inputs\": %zu,\n"
+		    "  \"tool_uncached_ns\": %llu,\n"
+		    "  \"tool_cached_ns\": %llu\n}\n",
+		    (unsigned long long) startup_ns, ninputs,
+		    (unsigned long long) uncached_ns,
+		    (unsigned long long) cached_ns);
+		fclose(json);
+	}
+	return (0);
+}
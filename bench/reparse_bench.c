@@ -0,0 +1,695 @@
+/*
+ * Incremental reparse benchmark for the D grammar.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// This program replays scripted editor sessions against a document.
+// Every keystroke is applied to the text, described to the old tree
+// with ts_tree_edit, and the document is then reparsed using the old
+// tree, just as an editor would.  For each keystroke we record the
+// reparse latency and the ranges that tree-sitter reports as changed;
+// a keystroke whose changed ranges span most of the document means
+// that the grammar forced (nearly) the whole file to be reparsed.
+//
+// A script is a file of commands, one per line.  Blank lines and lines
+// starting with '#' are ignored.  TEXT arguments may use \n, \t and \\.
+//
+//   corpus PATH    use the sources of a tree-sitter corpus file
+//   file PATH      use the contents of a D file
+//   start          move the cursor to the start of the document
+//   end            move the cursor to the end of the document
+//   find TEXT      move the cursor to just after the first TEXT
+//   setup TEXT     insert TEXT at the cursor, without measuring
+//   repeat N TEXT  insert N copies of TEXT at the cursor, without measuring
+//   type TEXT      type TEXT at the cursor, one measured edit per character
+//   backspace N    delete N characters before the cursor, each measured
+//
+// The whole script is replayed several times, and the latency of each
+// keystroke is the best of those runs.
+
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <tree_sitter/api.h>
+
+#include "corpus.h"
+#include "tree-sitter-d.h"
+
+enum op_kind {
+	OP_DOCUMENT,
+	OP_START,
+	OP_END,
+	OP_FIND,
+	OP_SETUP,
+	OP_TYPE,
+	OP_BACKSPACE,
+};
+
+typedef struct {
+	enum op_kind kind;
+	char        *text; // document or argument text
+	size_t       len;
+	long         count; // for backspace
+	int          line;  // script line, for messages
+} op;
+
+// keystroke records one measured edit
+typedef struct {
+	uint64_t ns;      // best reparse time over all replays
+	uint32_t offset;  // cursor offset of the edit
+	uint32_t doc_len; // document length after the edit
+	uint32_t ranges;  // number of changed ranges
+	uint32_t changed; // bytes covered by the changed ranges
+	int      line;    // script line
+	char     ch[5];   // character typed, empty for backspace
+} keystroke;
+
+typedef struct {
+	char      *name;
+	op        *ops;
+	size_t     nops;
+	keystroke *keys;
+	size_t     nkeys;
+	char      *full;    // document as it was before the first keystroke
+	uint32_t   full_len;
+	uint64_t   full_ns; // best full parse of that document
+} scenario;
+
+// document is the text being edited, and the tree that goes with it
+typedef struct {
+	char     *text;
+	size_t    len;
+	size_t    cap;
+	size_t    cursor;
+	TSParser *parser;
+	TSTree   *tree;
+} document;
+
+static int  replays = 5;
+static bool verbose = false;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec);
+}
+
+static void *
+xrealloc(void *p, size_t sz)
+{
+	if ((p = realloc(p, sz)) == NULL) {
+		fprintf(stderr, "reparse_bench: out of memory\n");
+		exit(1);
+	}
+	return (p);
+}
+
+// unescape handles \n, \t and \\ in script arguments, in place.
+static size_t
+unescape(char *s)
+{
+	char *out = s;
+	for (char *p = s; *p; p++) {
+		if ((p[0] == '\\') && (p[1] != 0)) {
+			p++;
+			switch (*p) {
+			case 'n':
+				*out++ = '\n';
+				break;
+			case 't':
+				*out++ = '\t';
+				break;
+			default:
+				*out++ = *p;
+				break;
+			}
+		} else {
+			*out++ = *p;
+		}
+	}
+	*out = 0;
+	return ((size_t) (out - s));
+}
+
+static char *
+scenario_name(const char *path)
+{
+	const char *base = strrchr(path, '/');
+	char       *name;
+	char       *dot;
+
+	name = strdup(base ? base + 1 : path);
+	if ((dot = strrchr(name, '.')) != NULL) {
+		*dot = 0;
+	}
+	return (name);
+}
+
+static bool
+load_script(const char *path, scenario *sc)
+{
+	char  *script;
+	char  *line;
+	char  *next;
+	size_t len;
+	int    lineno = 0;
+
+	if ((script = corpus_read_file(path, &len)) == NULL) {
+		fprintf(stderr, "reparse_bench: %s: %s\n", path,
+		    strerror(errno));
+		return (false);
+	}
+	memset(sc, 0, sizeof(*sc));
+	sc->name = scenario_name(path);
+
+	for (line = script; line != NULL; line = next) {
+		char *arg;
+		op    o;
+
+		lineno++;
+		if ((next = strchr(line, '\n')) != NULL) {
+			*next++ = 0;
+		}
+		line[strcspn(line, "\r")] = 0;
+		if ((line[0] == 0) || (line[0] == '#')) {
+			continue;
+		}
+		memset(&o, 0, sizeof(o));
+		o.line = lineno;
+		if ((arg = strchr(line, ' ')) != NULL) {
+			*arg++ = 0;
+		} else {
+			arg = line + strlen(line);
+		}
+
+		if ((strcmp(line, "corpus") == 0) ||
+		    (strcmp(line, "file") == 0)) {
+			char *raw;
+			o.kind = OP_DOCUMENT;
+			if ((raw = corpus_read_file(arg, &len)) == NULL) {
+				fprintf(stderr,
+				    "reparse_bench: %s:%d: %s: %s\n", path,
+				    lineno, arg, strerror(errno));
+				free(script);
+				return (false);
+			}
+			if (line[0] == 'c') {
+				o.text = corpus_extract(raw, len, &o.len);
+				free(raw);
+			} else {
+				o.text = raw;
+				o.len  = len;
+			}
+		} else if (strcmp(line, "start") == 0) {
+			o.kind = OP_START;
+		} else if (strcmp(line, "end") == 0) {
+			o.kind = OP_END;
+		} else if ((strcmp(line, "find") == 0) ||
+		    (strcmp(line, "setup") == 0) ||
+		    (strcmp(line, "type") == 0)) {
+			o.kind = line[0] == 'f' ? OP_FIND
+			    : line[0] == 's'    ? OP_SETUP
+			                        : OP_TYPE;
+			o.text = strdup(arg);
+			o.len  = unescape(o.text);
+		} else if (strcmp(line, "repeat") == 0) {
+			long   count = strtol(arg, &arg, 10);
+			char  *text;
+			size_t tl;
+
+			arg += (*arg == ' ') ? 1 : 0;
+			text   = strdup(arg);
+			tl     = unescape(text);
+			count  = count < 1 ? 1 : count;
+			o.kind = OP_SETUP;
+			o.len  = tl * (size_t) count;
+			o.text = xrealloc(NULL, o.len + 1);
+			for (long j = 0; j < count; j++) {
+				memcpy(o.text + tl * (size_t) j, text, tl);
+			}
+			o.text[o.len] = 0;
+			free(text);
+		} else if (strcmp(line, "backspace") == 0) {
+			o.kind = OP_BACKSPACE;
+			if ((o.count = atol(arg)) < 1) {
+				o.count = 1;
+			}
+		} else {
+			fprintf(stderr,
+			    "reparse_bench: %s:%d: unknown command %s\n",
+			    path, lineno, line);
+			free(script);
+			return (false);
+		}
+		if ((sc->nops == 0) && (o.kind != OP_DOCUMENT)) {
+			fprintf(stderr,
+			    "reparse_bench: %s:%d: script must start with a "
+			    "document\n",
+			    path, lineno);
+			free(script);
+			return (false);
+		}
+		sc->ops = xrealloc(sc->ops, sizeof(op) * (sc->nops + 1));
+		sc->ops[sc->nops++] = o;
+	}
+	free(script);
+	return (sc->nops > 0);
+}
+
+// point_at computes the row and column (in bytes) of an offset.
+static TSPoint
+point_at(const document *d, size_t offset)
+{
+	TSPoint pt = { 0, 0 };
+	for (size_t i = 0; i < offset; i++) {
+		if (d->text[i] == '\n') {
+			pt.row++;
+			pt.column = 0;
+		} else {
+			pt.column++;
+		}
+	}
+	return (pt);
+}
+
+static void
+reparse(document *d, keystroke *k, bool first)
+{
+	TSTree   *old = d->tree;
+	TSRange  *ranges;
+	uint32_t  nranges;
+	uint64_t  start;
+	uint64_t  elapsed;
+	uint32_t  changed = 0;
+
+	start   = now_ns();
+	d->tree = ts_parser_parse_string(
+	    d->parser, old, d->text, (uint32_t) d->len);
+	elapsed = now_ns() - start;
+
+	if (k != NULL) {
+		ranges = ts_tree_get_changed_ranges(old, d->tree, &nranges);
+		for (uint32_t i = 0; i < nranges; i++) {
+			changed += ranges[i].end_byte - ranges[i].start_byte;
+		}
+		free(ranges);
+		if (first || (elapsed < k->ns)) {
+			k->ns = elapsed;
+		}
+		k->ranges  = nranges;
+		k->changed = changed;
+		k->doc_len = (uint32_t) d->len;
+	}
+	ts_tree_delete(old);
+}
+
+// utf8_len returns the length of the sequence starting with lead byte c.
+static size_t
+utf8_len(unsigned char c)
+{
+	if (c < 0xc0) {
+		return (1);
+	}
+	if (c < 0xe0) {
+		return (2);
+	}
+	if (c < 0xf0) {
+		return (3);
+	}
+	return (4);
+}
+
+static void
+insert(document *d, const char *s, size_t n)
+{
+	TSInputEdit edit;
+
+	if (d->len + n + 1 > d->cap) {
+		d->cap  = (d->len + n + 1) * 2;
+		d->text = xrealloc(d->text, d->cap);
+	}
+	edit.start_byte    = (uint32_t) d->cursor;
+	edit.old_end_byte  = (uint32_t) d->cursor;
+	edit.new_end_byte  = (uint32_t) (d->cursor + n);
+	edit.start_point   = point_at(d, d->cursor);
+	edit.old_end_point = edit.start_point;
+
+	memmove(d->text + d->cursor + n, d->text + d->cursor,
+	    d->len - d->cursor + 1);
+	memcpy(d->text + d->cursor, s, n);
+	d->len += n;
+	d->cursor += n;
+
+	edit.new_end_point = point_at(d, d->cursor);
+	ts_tree_edit(d->tree, &edit);
+}
+
+static void
+delete_back(document *d)
+{
+	TSInputEdit edit;
+	size_t      start = d->cursor;
+
+	if (start == 0) {
+		return;
+	}
+	// back up over a whole UTF-8 sequence
+	do {
+		start--;
+	} while ((start > 0) && ((d->text[start] & 0xc0) == 0x80));
+
+	edit.start_byte    = (uint32_t) start;
+	edit.old_end_byte  = (uint32_t) d->cursor;
+	edit.new_end_byte  = (uint32_t) start;
+	edit.start_point   = point_at(d, start);
+	edit.old_end_point = point_at(d, d->cursor);
+	edit.new_end_point = edit.start_point;
+
+	memmove(d->text + start, d->text + d->cursor, d->len - d->cursor + 1);
+	d->len -= d->cursor - start;
+	d->cursor = start;
+	ts_tree_edit(d->tree, &edit);
+}
+
+static keystroke *
+next_key(scenario *sc, const document *d, size_t *kp, bool first)
+{
+	if (first && (sc->full == NULL)) {
+		sc->full = xrealloc(NULL, d->len + 1);
+		memcpy(sc->full, d->text, d->len + 1);
+		sc->full_len = (uint32_t) d->len;
+	}
+	if (first) {
+		sc->keys = xrealloc(sc->keys, sizeof(keystroke) * (*kp + 1));
+		memset(&sc->keys[*kp], 0, sizeof(keystroke));
+		sc->nkeys = *kp + 1;
+	}
+	return (&sc->keys[(*kp)++]);
+}
+
+static bool
+replay(scenario *sc, TSParser *parser, bool first)
+{
+	document d;
+	size_t   k = 0;
+
+	memset(&d, 0, sizeof(d));
+	d.parser = parser;
+
+	for (size_t i = 0; i < sc->nops; i++) {
+		const op  *o = &sc->ops[i];
+		keystroke *ks;
+		char      *p;
+
+		switch (o->kind) {
+		case OP_DOCUMENT:
+			ts_tree_delete(d.tree);
+			d.cap  = o->len + 1;
+			d.text = xrealloc(d.text, d.cap);
+			memcpy(d.text, o->text, o->len + 1);
+			d.len    = o->len;
+			d.cursor = 0;
+			d.tree   = ts_parser_parse_string(
+			      parser, NULL, d.text, (uint32_t) d.len);
+			break;
+		case OP_START:
+			d.cursor = 0;
+			break;
+		case OP_END:
+			d.cursor = d.len;
+			break;
+		case OP_FIND:
+			if ((p = strstr(d.text, o->text)) == NULL) {
+				fprintf(stderr,
+				    "reparse_bench: %s:%d: text not found\n",
+				    sc->name, o->line);
+				ts_tree_delete(d.tree);
+				free(d.text);
+				return (false);
+			}
+			d.cursor = (size_t) (p - d.text) + o->len;
+			break;
+		case OP_SETUP:
+			insert(&d, o->text, o->len);
+			reparse(&d, NULL, first);
+			break;
+		case OP_TYPE:
+			for (size_t j = 0; j < o->len;) {
+				size_t n;
+				n = utf8_len((unsigned char) o->text[j]);
+				if (j + n > o->len) {
+					n = o->len - j;
+				}
+				ks         = next_key(sc, &d, &k, first);
+				ks->offset = (uint32_t) d.cursor;
+				ks->line   = o->line;
+				memcpy(ks->ch, o->text + j, n);
+				insert(&d, o->text + j, n);
+				reparse(&d, ks, first);
+				j += n;
+			}
+			break;
+		case OP_BACKSPACE:
+			for (long j = 0; j < o->count; j++) {
+				ks         = next_key(sc, &d, &k, first);
+				ks->line   = o->line;
+				ks->ch[0]  = 0;
+				delete_back(&d);
+				ks->offset = (uint32_t) d.cursor;
+				reparse(&d, ks, first);
+			}
+			break;
+		}
+	}
+	ts_tree_delete(d.tree);
+	free(d.text);
+	return (true);
+}
+
+static void
+full_parse(scenario *sc, TSParser *parser)
+{
+	if (sc->full == NULL) {
+		return;
+	}
+	for (int i = 0; i < replays; i++) {
+		uint64_t start = now_ns();
+		TSTree  *tree  = ts_parser_parse_string(
+		     parser, NULL, sc->full, sc->full_len);
+		uint64_t elapsed = now_ns() - start;
+		if ((i == 0) || (elapsed < sc->full_ns)) {
+			sc->full_ns = elapsed;
+		}
+		ts_tree_delete(tree);
+	}
+}
+
+static int
+cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = *(const uint64_t *) b;
+	return ((x > y) - (x < y));
+}
+
+// whole_file is true if the changes reported for a keystroke cover
+// more than half of the document.
+static bool
+whole_file(const keystroke *k)
+{
+	return ((k->doc_len > 0) && (k->changed * 2 > k->doc_len));
+}
+
+static void
+print_key(const keystroke *k)
+{
+	char ch[8];
+
+	if (k->ch[0] == 0) {
+		snprintf(ch, sizeof(ch), "<bs>");
+	} else if (k->ch[0] == ' ') {
+		snprintf(ch, sizeof(ch), "<sp>");
+	} else if (k->ch[0] == '\n') {
+		snprintf(ch, sizeof(ch), "\\n");
+	} else if (k->ch[0] == '\t') {
+		snprintf(ch, sizeof(ch), "\\t");
+	} else {
+		snprintf(ch, sizeof(ch), "%s", k->ch);
+	}
+	printf("  line %-4d @%-8u %-5s %10.1f %6u %10u%s\n", k->line,
+	    k->offset, ch, (double) k->ns / 1000.0, k->ranges, k->changed,
+	    whole_file(k) ? "  WHOLE FILE" : "");
+}
+
+static void
+report(const scenario *sc, FILE *json, bool first)
+{
+	uint64_t *ns;
+	uint64_t  max_changed = 0;
+	uint64_t  sum_changed = 0;
+	size_t    whole       = 0;
+	size_t    n           = sc->nkeys;
+	uint64_t  p50, p90, p99, max;
+
+	if (n == 0) {
+		return;
+	}
+	ns = xrealloc(NULL, sizeof(uint64_t) * n);
+	for (size_t i = 0; i < n; i++) {
+		const keystroke *k = &sc->keys[i];
+		ns[i]              = k->ns;
+		sum_changed += k->changed;
+		if (k->changed > max_changed) {
+			max_changed = k->changed;
+		}
+		if (whole_file(k)) {
+			whole++;
+		}
+	}
+	qsort(ns, n, sizeof(uint64_t), cmp_u64);
+	p50 = ns[(n - 1) * 50 / 100];
+	p90 = ns[(n - 1) * 90 / 100];
+	p99 = ns[(n - 1) * 99 / 100];
+	max = ns[n - 1];
+	free(ns);
+
+	printf("%-20s %6zu %9.1f %9.1f %9.1f %9.1f %9.1f %10llu %6zu\n",
+	    sc->name, n, (double) p50 / 1000.0, (double) p90 / 1000.0,
+	    (double) p99 / 1000.0, (double) max / 1000.0,
+	    (double) sc->full_ns / 1000.0, (unsigned long long) max_changed,
+	    whole);
+	if (verbose) {
+		printf("  %-9s %-9s %-5s %10s %6s %10s\n", "line", "offset",
+		    "key", "us", "ranges", "changed");
+		for (size_t i = 0; i < n; i++) {
+			print_key(&sc->keys[i]);
+		}
+	}
+
+	if (json != NULL) {
+		fprintf(json,
+		    "%s\n    {\"name\": \"%s\", \"doc_bytes\": %u, "
+		    "\"keystrokes\": %zu, \"p50_ns\": %llu, \"p90_ns\": %llu, "
+		    "\"p99_ns\": %llu, \"max_ns\": %llu, \"full_ns\": %llu, "
+		    "\"mean_changed_bytes\": %llu, "
+		    "\"max_changed_bytes\": %llu, "
+		    "\"whole_file_edits\": %zu}",
+		    first ? "" : ",", sc->name, sc->full_len, n,
+		    (unsigned long long) p50, (unsigned long long) p90,
+		    (unsigned long long) p99, (unsigned long long) max,
+		    (unsigned long long) sc->full_ns,
+		    (unsigned long long) (sum_changed / n),
+		    (unsigned long long) max_changed, whole);
+	}
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+	    "usage: reparse_bench [-n replays] [-v] [-o results.json] "
+	    "script.edits ...\n");
+	exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *outfile = NULL;
+	FILE       *json    = NULL;
+	TSParser   *parser;
+	int         opt;
+	int         rv    = 0;
+	bool        first = true;
+
+	while ((opt = getopt(argc, argv, "n:o:v")) != -1) {
+		switch (opt) {
+		case 'n':
+			if ((replays = atoi(optarg)) < 1) {
+				usage();
+			}
+			break;
+		case 'o':
+			outfile = optarg;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc == 0) {
+		usage();
+	}
+
+	if (outfile != NULL) {
+		if ((json = fopen(outfile, "w")) == NULL) {
+			fprintf(stderr, "reparse_bench: %s: %s\n", outfile,
+			    strerror(errno));
+			return (1);
+		}
+		fprintf(json, "{\n  \"replays\": %d,\n  \"scenarios\": [",
+		    replays);
+	}
+
+	parser = ts_parser_new();
+	ts_parser_set_language(parser, tree_sitter_d());
+
+	printf("%-20s %6s %9s %9s %9s %9s %9s %10s %6s\n", "scenario", "keys",
+	    "p50(us)", "p90(us)", "p99(us)", "max(us)", "full(us)",
+	    "changed", "whole");
+
+	for (int i = 0; i < argc; i++) {
+		scenario sc;
+		bool     ok = true;
+
+		if (!load_script(argv[i], &sc)) {
+			rv = 1;
+			continue;
+		}
+		for (int r = 0; ok && (r < replays); r++) {
+			ok = replay(&sc, parser, r == 0);
+		}
+		if (!ok) {
+			rv = 1;
+			continue;
+		}
+		full_parse(&sc, parser);
+		report(&sc, json, first);
+		first = false;
+
+		for (size_t j = 0; j < sc.nops; j++) {
+			free(sc.ops[j].text);
+		}
+		free(sc.ops);
+		free(sc.keys);
+		free(sc.full);
+		free(sc.name);
+	}
+
+	ts_parser_delete(parser);
+	if (json != NULL) {
+		fprintf(json, "\n  ]\n}\n");
+		fclose(json);
+	}
+	return (rv);
+}
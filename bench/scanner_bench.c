@@ -0,0 +1,521 @@
+/*
+ * Microbenchmark for the external scanner of the D grammar.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// This drives tree_sitter_d_external_scanner_scan directly, using an
+// in-memory TSLexer, so that the scanner can be measured without the
+// generated parser or the tree-sitter runtime.  Each case names the
+// scanner path it exercises, the external tokens that are valid, and
+// the token (and its length) that the scanner must produce.  Every
+// case is checked before it is timed, so this doubles as a quick
+// sanity test of the scanner.
+//
+// The scanner is included directly, so that its token enumeration
+// is available here, and so that the compiler can optimize the
+// scanner the same way it does when it is linked into a parser.
+
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include "../src/scanner.c"
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TICK_UNIT "cycles"
+static inline uint64_t
+ticks(void)
+{
+	return (__rdtsc());
+}
+#else
+#define TICK_UNIT "ns"
+static inline uint64_t
+ticks(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec);
+}
+#endif
+
+// fake_lexer is a TSLexer over a pre-decoded array of code points.
+// The base member must be first, as the scanner only sees the TSLexer.
+typedef struct {
+	TSLexer        base;
+	const int32_t *text;
+	uint32_t       len;
+	uint32_t       pos;
+	uint32_t       mark;
+	uint32_t       column;
+	uint32_t       start_column;
+} fake_lexer;
+
+static void
+fake_advance(TSLexer *l, bool skip)
+{
+	fake_lexer *fl = (fake_lexer *) l;
+	(void) skip;
+	if (fl->pos >= fl->len) {
+		return;
+	}
+	if (fl->text[fl->pos] == '\n') {
+		fl->column = 0;
+	} else {
+		fl->column++;
+	}
+	fl->pos++;
+	l->lookahead = (fl->pos < fl->len) ? fl->text[fl->pos] : 0;
+}
+
+static void
+fake_mark_end(TSLexer *l)
+{
+	fake_lexer *fl = (fake_lexer *) l;
+	fl->mark       = fl->pos;
+}
+
+static uint32_t
+fake_get_column(TSLexer *l)
+{
+	return (((fake_lexer *) l)->column);
+}
+
+static bool
+fake_is_at_included_range_start(const TSLexer *l)
+{
+	(void) l;
+	return (false);
+}
+
+static bool
+fake_eof(const TSLexer *l)
+{
+	const fake_lexer *fl = (const fake_lexer *) l;
+	return (fl->pos >= fl->len);
+}
+
+static void
+fake_log(const TSLexer *l, const char *fmt, ...)
+{
+	(void) l;
+	(void) fmt;
+}
+
+static void
+fake_reset(fake_lexer *fl)
+{
+	fl->pos                             = 0;
+	fl->mark                            = 0;
+	fl->column                          = fl->start_column;
+	fl->base.lookahead                  = fl->len ? fl->text[0] : 0;
+	fl->base.result_symbol              = 0;
+	fl->base.advance                    = fake_advance;
+	fl->base.mark_end                   = fake_mark_end;
+	fl->base.get_column                 = fake_get_column;
+	fl->base.is_at_included_range_start = fake_is_at_included_range_start;
+	fl->base.eof                        = fake_eof;
+	fl->base.log                        = fake_log;
+}
+
+// decode converts UTF-8 to code points, as the tree-sitter lexer would.
+static int32_t *
+decode(const char *s, size_t n, uint32_t *lenp)
+{
+	int32_t *out = malloc(sizeof(int32_t) * (n + 1));
+	uint32_t len = 0;
+	size_t   i   = 0;
+
+	if (out == NULL) {
+		fprintf(stderr, "scanner_bench: out of memory\n");
+		exit(1);
+	}
+	while (i < n) {
+		unsigned char c = (unsigned char) s[i];
+		int32_t       cp;
+		int           extra;
+		if (c < 0x80) {
+			cp    = c;
+			extra = 0;
+		} else if ((c & 0xe0) == 0xc0) {
+			cp    = c & 0x1f;
+			extra = 1;
+		} else if ((c & 0xf0) == 0xe0) {
+			cp    = c & 0x0f;
+			extra = 2;
+		} else {
+			cp    = c & 0x07;
+			extra = 3;
+		}
+		i++;
+		while ((extra-- > 0) && (i < n)) {
+			cp = (cp << 6) | (s[i++] & 0x3f);
+		}
+		out[len++] = cp;
+	}
+	*lenp = len;
+	return (out);
+}
+
+typedef struct {
+	const char *path;   // scanner path exercised
+	const char *name;   // short description of the input
+	const char *source; // input text (UTF-8)
+	int         column; // starting column (directives need 0)
+	const int  *valid;  // valid tokens, terminated by -1
+	bool        ok;     // whether the scan should succeed
+	int         symbol; // expected result symbol
+	int         length; // expected token length in code points (-1: all)
+} bench_case;
+
+static const int v_number[] = { L_INT, L_FLOAT, -1 };
+static const int v_int[]    = { L_INT, -1 };
+static const int v_string[] = { L_STRING, -1 };
+static const int v_direct[] = { DIRECTIVE, -1 };
+static const int v_not[]    = { NOT_IN, NOT_IS, -1 };
+static const int v_comment[] = { COMMENT, DIRECTIVE, -1 };
+static const int v_in_str[]  = { COMMENT, DIRECTIVE, STRING_CONTEXT, -1 };
+#ifndef TREE_SITTER_D_DETAILED_ASM
+static const int v_asm[]     = { ASM_BODY, COMMENT, DIRECTIVE, -1 };
+#endif
+
+// long strings are split into chunks, unless that is disabled
+static const int v_long[] = { L_STRING, L_STRING_CHUNK, -1 };
+#if TREE_SITTER_D_STRING_CHUNK > 0
+#define LONG_STRING L_STRING_CHUNK
+#else
+#define LONG_STRING L_STRING
+#endif
+
+static bench_case cases[] = {
+	{ "match_number", "decimal", "12345678;", 1, v_number, true, L_INT,
+	    8 },
+	{ "match_number", "hex-suffix", "0x1234_ABCDuL;", 1, v_number, true,
+	    L_INT, 13 },
+	{ "match_number", "binary", "0b1010_1010_1010;", 1, v_number, true,
+	    L_INT, 16 },
+	{ "match_number", "float-exp", "3.14159e+10f;", 1, v_number, true,
+	    L_FLOAT, 12 },
+	{ "match_number", "leading-dot", ".5;", 1, v_number, true, L_FLOAT,
+	    2 },
+	{ "match_number", "range", "1..2", 1, v_int, true, L_INT, 1 },
+	{ "match_number", "whitespace", "                \t\t\t\t42;", 1,
+	    v_number, true, L_INT, 22 },
+	{ "match_delimited_string", "parens", "q\"(a (nested) string)\";", 1,
+	    v_string, true, L_STRING, 22 },
+	{ "match_delimited_string", "braces-suffix", "q\"{x}\"w;", 1,
+	    v_string, true, L_STRING, 7 },
+	{ "match_delimited_string", "slash", "q\"/a/b/c/\";", 1, v_string,
+	    true, L_STRING, 10 },
+	{ "match_delimited_string", "bang", "q\"!abc!\";", 1, v_string, true,
+	    L_STRING, 8 },
+	{ "match_heredoc_string", "short", "q\"EOS\nline one\nline two\nEOS\";",
+	    1, v_string, true, L_STRING, 28 },
+	{ "match_directive", "line", "#line 10 \"foo.d\"\nint x;", 0,
+	    v_direct, true, DIRECTIVE, 17 },
+	{ "match_directive", "shebang", "#!/usr/bin/rdmd\n", 0, v_direct,
+	    false, 0, 0 },
+	{ "match_not_in_is", "not-in", "!in x", 1, v_not, true, NOT_IN, 3 },
+	{ "match_not_in_is", "not-is-space", "!  is x", 1, v_not, true,
+	    NOT_IS, 5 },
+	{ "match_not_in_is", "template", "!int", 1, v_not, false, 0, 0 },
+	{ "match_nesting_comment", "simple", "/+ comment +/ x", 1, v_comment,
+	    true, COMMENT, 13 },
+	{ "match_nesting_comment", "nested-7",
+	    "/+1/+2/+3/+4/+5/+6/+7+/+/+/+/+/+/+/ x", 1, v_comment, true,
+	    COMMENT, 35 },
+	{ "match_nesting_comment", "line-comment", "// not ours\n", 1,
+	    v_comment, false, 0, 0 },
+	{ "match_nesting_comment", "in-string", "/+ not a comment +/", 1,
+	    v_in_str, false, 0, 0 },
+	{ "match_nesting_comment", "unterminated", "/+ /+ +/", 1, v_comment,
+	    false, 0, 0 },
+#ifndef TREE_SITTER_D_DETAILED_ASM
+	{ "match_asm_body", "simple", "  mov EAX, 1;\n  nop;\n}", 1, v_asm,
+	    true, ASM_BODY, 20 },
+	{ "match_asm_body", "string-brace",
+	    "ds \"right brace}\"; // the } is ignored\n}", 1, v_asm, true,
+	    ASM_BODY, 18 },
+	{ "match_asm_body", "empty", "  }", 1, v_asm, false, 0, 0 },
+#endif
+#ifdef TREE_SITTER_D_OPAQUE_TOKEN_STRINGS
+	{ "match_token_string", "nested",
+	    "q{ if (x) { y = \"}\"; c = '}'; /* } */ } } z", 1, v_string, true,
+	    L_STRING, 41 },
+	{ "match_token_string", "wysiwyg", "q{ r\"\\\" ` } ` } z", 1,
+	    v_string, true, L_STRING, 15 },
+	{ "match_token_string", "unbalanced", "q{ { }", 1, v_string, false,
+	    0, 0 },
+	{ "match_token_string", "delimited-quote", "q{ q\"(a\"b)\" } z", 1,
+	    v_string, true, L_STRING, 13 },
+	{ "match_token_string", "delimited-backslash", "q{ q\"(\\)\" } z", 1,
+	    v_string, true, L_STRING, 11 },
+	{ "match_token_string", "delimited-slash",
+	    "q{ x = q\"/a\"b/\"; } z", 1, v_string, true, L_STRING, 18 },
+	{ "match_token_string", "heredoc-brace",
+	    "q{ q\"EOS\n\"}\nEOS\" } z", 1, v_string, true, L_STRING, 18 },
+	{ "match_token_string", "not-q", "q{ aq\"}\" } z", 1, v_string, true,
+	    L_STRING, 10 },
+#endif
+	// large generated cases are filled in by make_large_cases
+	{ "match_heredoc_string", "64k", NULL, 1, v_long, true, LONG_STRING,
+	    -1 },
+	{ "match_delimited_string", "64k", NULL, 1, v_long, true, LONG_STRING,
+	    -1 },
+	{ "match_number", "digits-4k", NULL, 1, v_number, true, L_INT, -1 },
+	{ "match_nesting_comment", "64k", NULL, 1, v_comment, true, COMMENT,
+	    -1 },
+};
+
+#define NCASES (sizeof(cases) / sizeof(cases[0]))
+
+static char *
+make_string(const char *prefix, const char *line, size_t count,
+    const char *suffix)
+{
+	size_t pl = strlen(prefix);
+	size_t ll = strlen(line);
+	size_t sl = strlen(suffix);
+	char  *s  = malloc(pl + ll * count + sl + 1);
+	char  *p  = s;
+
+	if (s == NULL) {
+		fprintf(stderr, "scanner_bench: out of memory\n");
+		exit(1);
+	}
+	memcpy(p, prefix, pl);
+	p += pl;
+	for (size_t i = 0; i < count; i++) {
+		memcpy(p, line, ll);
+		p += ll;
+	}
+	memcpy(p, suffix, sl + 1);
+	return (s);
+}
+
+// finish_chunks scans the rest of a string that was split into chunks,
+// saving and restoring the scanner state between chunks as tree-sitter
+// would, and checks that it ends with the final part of the string.
+static bool
+finish_chunks(void *scanner, fake_lexer *fl, const bool *valid)
+{
+	char     state[TREE_SITTER_SERIALIZATION_BUFFER_SIZE];
+	unsigned n;
+
+	while (fl->base.result_symbol == L_STRING_CHUNK) {
+		if (fl->mark == 0) {
+			return (false);
+		}
+		n = tree_sitter_d_external_scanner_serialize(scanner, state);
+		tree_sitter_d_external_scanner_deserialize(scanner, NULL, 0);
+		tree_sitter_d_external_scanner_deserialize(scanner, state, n);
+		fl->text += fl->mark;
+		fl->len -= fl->mark;
+		fake_reset(fl);
+		if (!tree_sitter_d_external_scanner_scan(
+		        scanner, &fl->base, valid)) {
+			return (false);
+		}
+	}
+	return ((fl->base.result_symbol == L_STRING) && (fl->mark == fl->len));
+}
+
+static void
+make_large_cases(void)
+{
+	for (size_t i = 0; i < NCASES; i++) {
+		if (cases[i].source != NULL) {
+			continue;
+		}
+		if (strcmp(cases[i].path, "match_heredoc_string") == 0) {
+			cases[i].source = make_string("q\"EOS\n",
+			    "    writeln(\"some generated line of code\");\n",
+			    1400, "EOS\"");
+		} else if (strcmp(cases[i].path, "match_delimited_string") ==
+		    0) {
+			cases[i].source = make_string(
+			    "q\"{", "{ nested (braces) [and] <angles> }\n", 1800, "}\"");
+		} else if (strcmp(cases[i].path, "match_nesting_comment") ==
+		    0) {
+			cases[i].source = make_string("/+",
+			    " some /+ nested +/ commentary, 1 + 2 / 3 +\n", 1500,
+			    "+/");
+		} else {
+			cases[i].source = make_string("1", "234_5678_", 455, "9");
+		}
+	}
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+	    "usage: scanner_bench [-n iterations] [-o results.json] "
+	    "[path ...]\n");
+	exit(2);
+}
+
+static bool
+selected(const char *path, int argc, char **argv)
+{
+	if (argc == 0) {
+		return (true);
+	}
+	for (int i = 0; i < argc; i++) {
+		if (strcmp(argv[i], path) == 0) {
+			return (true);
+		}
+	}
+	return (false);
+}
+
+int
+main(int argc, char **argv)
+{
+	long        iterations = 100000;
+	const char *outfile    = NULL;
+	FILE       *json       = NULL;
+	void       *scanner;
+	int         opt;
+	int         rv    = 0;
+	bool        first = true;
+
+	while ((opt = getopt(argc, argv, "n:o:")) != -1) {
+		switch (opt) {
+		case 'n':
+			if ((iterations = atol(optarg)) < 1) {
+				usage();
+			}
+			break;
+		case 'o':
+			outfile = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	make_large_cases();
+	scanner = tree_sitter_d_external_scanner_create();
+
+	if (outfile != NULL) {
+		if ((json = fopen(outfile, "w")) == NULL) {
+			fprintf(stderr, "scanner_bench: %s: %s\n", outfile,
+			    strerror(errno));
+			return (1);
+		}
+		fprintf(json, "{\n  \"unit\": \"%s\",\n  \"cases\": [", TICK_UNIT);
+	}
+
+	printf("%-24s %-14s %8s %12s %12s\n", "path", "case", "bytes",
+	    TICK_UNIT "/call", TICK_UNIT "/byte");
+
+	for (size_t i = 0; i < NCASES; i++) {
+		bench_case *bc = &cases[i];
+		fake_lexer  fl;
+		bool        valid[ERROR + 1];
+		bool        ok;
+		uint32_t    consumed;
+		uint64_t    start;
+		uint64_t    elapsed;
+		long        n = iterations;
+
+		if (!selected(bc->path, argc, argv)) {
+			continue;
+		}
+		memset(&fl, 0, sizeof(fl));
+		memset(valid, 0, sizeof(valid));
+		for (const int *v = bc->valid; *v >= 0; v++) {
+			valid[*v] = true;
+		}
+		fl.text = decode(bc->source, strlen(bc->source), &fl.len);
+		fl.start_column = (uint32_t) bc->column;
+
+		// verify the scanner does what we expect first
+		fake_reset(&fl);
+		tree_sitter_d_external_scanner_deserialize(scanner, NULL, 0);
+		ok = tree_sitter_d_external_scanner_scan(
+		    scanner, &fl.base, valid);
+		consumed = fl.mark;
+		if (ok && (bc->symbol == L_STRING_CHUNK) &&
+		    (fl.base.result_symbol == L_STRING_CHUNK)) {
+			fake_lexer rest = fl;
+			if (!finish_chunks(scanner, &rest, valid)) {
+				fprintf(stderr,
+				    "scanner_bench: %s/%s: bad chunks\n",
+				    bc->path, bc->name);
+				rv = 1;
+				free((void *) fl.text);
+				continue;
+			}
+		}
+		if ((ok != bc->ok) ||
+		    (ok &&
+		        ((fl.base.result_symbol != bc->symbol) ||
+		            ((bc->length >= 0) &&
+		                (consumed != (uint32_t) bc->length))))) {
+			fprintf(stderr,
+			    "scanner_bench: %s/%s: got %s sym %d len %u, "
+			    "want %s sym %d len %d\n",
+			    bc->path, bc->name, ok ? "ok" : "fail",
+			    fl.base.result_symbol, consumed,
+			    bc->ok ? "ok" : "fail", bc->symbol, bc->length);
+			rv = 1;
+			free((void *) fl.text);
+			continue;
+		}
+		if (!ok) {
+			consumed = fl.pos; // bytes examined before rejecting
+		}
+		if (consumed == 0) {
+			consumed = 1;
+		}
+
+		// scale the iteration count down for the large inputs
+		if (fl.len > 1024) {
+			n = n / (fl.len / 64) + 1;
+		}
+		start = ticks();
+		for (long j = 0; j < n; j++) {
+			fake_reset(&fl);
+			tree_sitter_d_external_scanner_deserialize(
+			    scanner, NULL, 0);
+			tree_sitter_d_external_scanner_scan(
+			    scanner, &fl.base, valid);
+		}
+		elapsed = ticks() - start;
+
+		printf("%-24s %-14s %8u %12.1f %12.2f\n", bc->path, bc->name,
+		    consumed, (double) elapsed / (double) n,
+		    (double) elapsed / (double) n / (double) consumed);
+		if (json != NULL) {
+			fprintf(json,
+			    "%s\n    {\"path\": \"%s\", \"name\": \"%s\", "
+			    "\"bytes\": %u, \"per_call\": %.3f, "
+			    "\"per_byte\": %.3f}",
+			    first ? "" : ",", bc->path, bc->name, consumed,
+			    (double) elapsed / (double) n,
+			    (double) elapsed / (double) n / (double) consumed);
+			first = false;
+		}
+		free((void *) fl.text);
+	}
+
+	if (json != NULL) {
+		fprintf(json, "\n  ]\n}\n");
+		fclose(json);
+	}
+	tree_sitter_d_external_scanner_destroy(scanner);
+	return (rv);
+}
@@ -0,0 +1,243 @@
+/*
+ * Bounded parsing of D sources.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef TREE_SITTER_D_BOUNDED_H_
+#define TREE_SITTER_D_BOUNDED_H_
+
+// Bounded parsing, for sources that may be hostile or pathological, such
+// as deeply nested expressions, long runs of attributes, or broken code
+// that keeps error recovery busy.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <tree_sitter/api.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Each limit is ignored when zero (or NULL).  The timeout is wall-clock
+// time.  The operation budget counts the parser's shift, reduce and
+// recovery steps, so unlike the timeout it gives the same result on any
+// machine.  On runtimes older than 0.25 it is counted through the
+// parser's log, which slows the parse down, so prefer the timeout
+// where repeatability does not matter.  The cancellation flag
+// may be set by another thread to stop the parse.  The runtime checks
+// the limits once every hundred or so steps, so they are not exact.
+typedef struct {
+	uint32_t      max_bytes;
+	uint64_t      timeout_micros;
+	uint64_t      max_operations;
+	const size_t *cancel;
+} ts_d_parse_limits;
+
+typedef enum {
+	TS_D_PARSE_OK,
+	TS_D_PARSE_TOO_LARGE,
+	TS_D_PARSE_TIMED_OUT,
+	TS_D_PARSE_OVER_BUDGET,
+	TS_D_PARSE_CANCELLED,
+} ts_d_parse_status;
+
+typedef struct {
+	const ts_d_parse_limits *limits;
+	const char              *src;
+	uint32_t                 len;
+	uint64_t                 operations;
+	struct timespec          deadline;
+	ts_d_parse_status        status;
+	size_t                   stop;
+} ts_d_parse_bounds_;
+
+static inline void
+ts_d_parse_deadline_(ts_d_parse_bounds_ *b)
+{
+	uint64_t us = b->limits->timeout_micros;
+	timespec_get(&b->deadline, TIME_UTC);
+	b->deadline.tv_sec += (time_t) (us / 1000000);
+	b->deadline.tv_nsec += (long) (us % 1000000) * 1000;
+	if (b->deadline.tv_nsec >= 1000000000) {
+		b->deadline.tv_sec++;
+		b->deadline.tv_nsec -= 1000000000;
+	}
+}
+
+// ts_d_parse_check_ records why the parse must stop, if it must.
+static inline bool
+ts_d_parse_check_(ts_d_parse_bounds_ *b)
+{
+	const ts_d_parse_limits *l = b->limits;
+	struct timespec          now;
+
+	if ((l->cancel != NULL) && (*l->cancel != 0)) {
+		b->status = TS_D_PARSE_CANCELLED;
+	} else if ((l->max_operations != 0) &&
+	    (b->operations > l->max_operations)) {
+		b->status = TS_D_PARSE_OVER_BUDGET;
+	} else if (l->timeout_micros != 0) {
+		timespec_get(&now, TIME_UTC);
+		if ((now.tv_sec > b->deadline.tv_sec) ||
+		    ((now.tv_sec == b->deadline.tv_sec) &&
+		        (now.tv_nsec >= b->deadline.tv_nsec))) {
+			b->status = TS_D_PARSE_TIMED_OUT;
+		}
+	}
+	return (b->status != TS_D_PARSE_OK);
+}
+
+#if TREE_SITTER_LANGUAGE_VERSION >= 15
+
+// The progress callback is called about once every hundred operations,
+// and while lexing long tokens.
+static inline bool
+ts_d_parse_progress_(TSParseState *state)
+{
+	ts_d_parse_bounds_ *b = (ts_d_parse_bounds_ *) state->payload;
+	b->operations += 100;
+	return (ts_d_parse_check_(b));
+}
+
+static inline const char *
+ts_d_parse_read_(void *payload, uint32_t byte, TSPoint pos, uint32_t *nread)
+{
+	ts_d_parse_bounds_ *b = (ts_d_parse_bounds_ *) payload;
+	(void) pos;
+	if (byte >= b->len) {
+		*nread = 0;
+		return ("");
+	}
+	*nread = b->len - byte;
+	return (b->src + byte);
+}
+
+#else
+
+// Older runtimes have no progress callback, so the operations are
+// counted from the parser's log instead, and the parse is stopped with
+// the cancellation flag, which the runtime checks as it would a timeout.
+static inline void
+ts_d_parse_log_(void *payload, TSLogType type, const char *msg)
+{
+	ts_d_parse_bounds_ *b = (ts_d_parse_bounds_ *) payload;
+	(void) msg;
+	if (type == TSLogTypeParse) {
+		b->operations++;
+		b->stop = ts_d_parse_check_(b);
+	}
+}
+
+#endif
+
+// ts_d_parse_bounded parses len bytes of src as ts_parser_parse_string
+// would, stopping when a limit is reached.  The tree is returned through
+// treep only on success.  A parser that is stopped is reset, so that it
+// can be used for the next source; any timeout, cancellation flag or
+// logger set on the parser is left as it was.
+static inline ts_d_parse_status
+ts_d_parse_bounded(TSParser *parser, const TSTree *old, const char *src,
+    uint32_t len, const ts_d_parse_limits *limits, TSTree **treep)
+{
+	ts_d_parse_bounds_ b;
+	TSTree            *tree;
+
+	*treep = NULL;
+	if ((limits->max_bytes != 0) && (len > limits->max_bytes)) {
+		return (TS_D_PARSE_TOO_LARGE);
+	}
+	memset(&b, 0, sizeof(b));
+	b.limits = limits;
+	b.src    = src;
+	b.len    = len;
+	if (limits->timeout_micros != 0) {
+		ts_d_parse_deadline_(&b);
+	}
+
+#if TREE_SITTER_LANGUAGE_VERSION >= 15
+	{
+		TSInput        input;
+		TSParseOptions options;
+		memset(&input, 0, sizeof(input));
+		memset(&options, 0, sizeof(options));
+		input.payload             = &b;
+		input.read                = ts_d_parse_read_;
+		input.encoding            = TSInputEncodingUTF8;
+		options.payload           = &b;
+		options.progress_callback = ts_d_parse_progress_;
+		tree = ts_parser_parse_with_options(
+		    parser, old, input, options);
+	}
+#else
+	{
+		uint64_t      timeout = ts_parser_timeout_micros(parser);
+		const size_t *flag    = ts_parser_cancellation_flag(parser);
+		TSLogger      logger  = ts_parser_logger(parser);
+
+		if (limits->max_operations != 0) {
+			// the log also watches the flag and deadline
+			TSLogger counter = { &b, ts_d_parse_log_ };
+			ts_parser_set_logger(parser, counter);
+			ts_parser_set_cancellation_flag(parser, &b.stop);
+		} else {
+			ts_parser_set_cancellation_flag(
+			    parser, limits->cancel);
+		}
+		ts_parser_set_timeout_micros(parser, limits->timeout_micros);
+		tree = ts_parser_parse_string(parser, old, src, len);
+		ts_parser_set_timeout_micros(parser, timeout);
+		ts_parser_set_cancellation_flag(parser, flag);
+		ts_parser_set_logger(parser, logger);
+
+		// the runtime does not say why it stopped
+		if ((tree == NULL) && (b.status == TS_D_PARSE_OK)) {
+			bool cancelled =
+			    (limits->cancel != NULL) && (*limits->cancel != 0);
+			b.status = cancelled ? TS_D_PARSE_CANCELLED
+			                     : TS_D_PARSE_TIMED_OUT;
+		}
+	}
+#endif
+
+	if (tree == NULL) {
+		ts_parser_reset(parser);
+		return (b.status != TS_D_PARSE_OK ? b.status
+		                                  : TS_D_PARSE_CANCELLED);
+	}
+	*treep = tree;
+	return (TS_D_PARSE_OK);
+}
+
+// ts_d_parse_status_name returns a short description of the status.
+static inline const char *
+ts_d_parse_status_name(ts_d_parse_status status)
+{
+	switch (status) {
+	case TS_D_PARSE_OK:
+		return ("ok");
+	case TS_D_PARSE_TOO_LARGE:
+		return ("source too large");
+	case TS_D_PARSE_TIMED_OUT:
+		return ("parse timed out");
+	case TS_D_PARSE_OVER_BUDGET:
+		return ("parse over operation budget");
+	case TS_D_PARSE_CANCELLED:
+		return ("parse cancelled");
+	}
+	return ("unknown");
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TREE_SITTER_D_BOUNDED_H_
@@ -0,0 +1,77 @@
+/*
+ * Walking only the active branches of conditional compilation.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef TREE_SITTER_D_CONDITIONS_H_
+#define TREE_SITTER_D_CONDITIONS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <tree_sitter/api.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A configuration says which version and debug conditions are active, as
+// the -version and -debug compiler options do.  The branches of
+// version(...), debug and debug(...) conditions that the configuration
+// rules out are inactive.  The version and debug specifications (such
+// as "version = Darwin;") found in active code while walking are added,
+// so they need not be given.  "version(all)" is always active, and
+// "version(none)" never is.  A "static if" is only decided when its
+// condition is the literal true or false; otherwise, and for numeric
+// versions, both branches are active.
+typedef struct ts_d_config ts_d_config;
+
+// ts_d_config_new returns NULL if out of memory, or if the language,
+// which must be tree_sitter_d(), lacks the symbols needed.
+ts_d_config *ts_d_config_new(const TSLanguage *language);
+
+void ts_d_config_delete(ts_d_config *config);
+
+// ts_d_config_version makes a version identifier active, including
+// "unittest" and "assert".  It returns false if out of memory.
+bool ts_d_config_version(ts_d_config *config, const char *ident);
+
+// ts_d_config_debug makes debug(ident) conditions active.  It returns
+// false if out of memory.
+bool ts_d_config_debug(ts_d_config *config, const char *ident);
+
+// ts_d_config_debug_level makes plain debug conditions active when level
+// is at least 1, and debug(n) active for n up to level.
+void ts_d_config_debug_level(ts_d_config *config, unsigned level);
+
+// The walk callback is called for each active node, in document order,
+// and returns false to skip the node's children.
+typedef bool (*ts_d_walk_cb)(TSNode node, void *arg);
+
+// ts_d_walk visits node and the active nodes below it.  The source is
+// needed to read the conditions.  It returns false if out of memory,
+// in which case the walk is incomplete.
+bool ts_d_walk(const ts_d_config *config, TSNode node, const char *src,
+    ts_d_walk_cb cb, void *arg);
+
+// ts_d_inactive_ranges finds the inactive code below node, as ranges in
+// document order, which the caller must free.  It is meant for
+// filtering the results of queries, with ts_d_in_ranges.  It returns the
+// number of ranges, or -1 if out of memory.
+int64_t ts_d_inactive_ranges(const ts_d_config *config, TSNode node,
+    const char *src, TSRange **rangesp);
+
+// ts_d_in_ranges returns true if the byte offset lies in one of the
+// ranges.
+bool ts_d_in_ranges(const TSRange *ranges, uint32_t n, uint32_t byte);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TREE_SITTER_D_CONDITIONS_H_
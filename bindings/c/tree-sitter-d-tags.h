@@ -0,0 +1,76 @@
+/*
+ * Native tag extraction for D trees.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef TREE_SITTER_D_TAGS_H_
+#define TREE_SITTER_D_TAGS_H_
+
+#include <stdbool.h>
+
+#include <tree_sitter/api.h>
+
+#include "tree-sitter-d-conditions.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The kinds of tag, named as in queries/tags.scm.
+typedef enum {
+	TS_D_TAG_DEFINITION_MODULE,
+	TS_D_TAG_DEFINITION_CLASS,
+	TS_D_TAG_DEFINITION_INTERFACE,
+	TS_D_TAG_DEFINITION_TYPE,
+	TS_D_TAG_DEFINITION_METHOD,
+	TS_D_TAG_DEFINITION_FUNCTION,
+	TS_D_TAG_DEFINITION_CONSTANT,
+	TS_D_TAG_REFERENCE_CALL,
+	TS_D_TAG_REFERENCE_CLASS,
+} ts_d_tag_kind;
+
+typedef struct {
+	ts_d_tag_kind kind;
+	TSNode        name; // the @name capture
+	TSNode        node; // the @definition or @reference capture
+} ts_d_tag;
+
+typedef void (*ts_d_tag_cb)(const ts_d_tag *tag, void *arg);
+
+typedef struct ts_d_tagger ts_d_tagger;
+
+// ts_d_tagger_new looks up the symbols of the language, which must be
+// tree_sitter_d().  It returns NULL if any are missing, which means the
+// tagger does not match the grammar.
+ts_d_tagger *ts_d_tagger_new(const TSLanguage *language);
+
+void ts_d_tagger_delete(ts_d_tagger *tagger);
+
+// ts_d_tagger_run walks the tree under node, and calls cb for each tag
+// that queries/tags.scm would match.  Tags are reported in the order
+// their nodes are visited, which is not necessarily the order in which
+// the query reports them.  The tagger may be used by one thread at a
+// time.
+void ts_d_tagger_run(
+    ts_d_tagger *tagger, TSNode node, ts_d_tag_cb cb, void *arg);
+
+// ts_d_tagger_run_active is like ts_d_tagger_run, but skips the code in
+// inactive branches of conditional compilation (see
+// tree-sitter-d-conditions.h).  It returns false if out of memory.
+bool ts_d_tagger_run_active(ts_d_tagger *tagger, const ts_d_config *config,
+    TSNode node, const char *src, ts_d_tag_cb cb, void *arg);
+
+// ts_d_tag_kind_name returns the name of the capture for a kind, for
+// example "definition.function".
+const char *ts_d_tag_kind_name(ts_d_tag_kind kind);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TREE_SITTER_D_TAGS_H_
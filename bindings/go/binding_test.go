@@ -1,10 +1,17 @@
 package tree_sitter_d_test
 
 import (
+	"bytes"
+	"fmt"
+	"os"
+	"path/filepath"
+	"runtime"
+	"sync/atomic"
 	"testing"
+	"time"
 
+	tree_sitter_d "github.com/gdamore/tree-sitter-d/bindings/go"
 	tree_sitter "github.com/tree-sitter/go-tree-sitter"
-	tree_sitter_d "github.com/tree-sitter/tree-sitter-d/bindings/go"
 )
 
 func TestCanLoadGrammar(t *testing.T) {
@@ -13,3 +20,152 @@ func TestCanLoadGrammar(t *testing.T) {
 		t.Errorf("Error loading D grammar")
 	}
 }
+
+func TestScannerLinked(t *testing.T) {
+	// numbers and strings are lexed by the external scanner
+	pool := tree_sitter_d.NewParserPool(1)
+	defer pool.Close()
+	tree := pool.Parse([]byte("auto x = 0x1F + 1.5e3; string s = q\"(a(b)c)\";\n"))
+	defer tree.Close()
+	if root := tree.RootNode(); root.HasError() {
+		t.Errorf("unexpected errors: %s", root.ToSexp())
+	}
+}
+
+func TestParserPoolDoesNotAllocate(t *testing.T) {
+	pool := tree_sitter_d.NewParserPool(1)
+	defer pool.Close()
+	pool.Put(pool.Get())
+	allocs := testing.AllocsPerRun(100, func() {
+		pool.Put(pool.Get())
+	})
+	if allocs != 0 {
+		t.Errorf("Get and Put allocated %v times", allocs)
+	}
+}
+
+func TestParseLimited(t *testing.T) {
+	files, err := filepath.Glob("../../test/stress/*.d")
+	if err != nil || len(files) == 0 {
+		t.Fatalf("no stress files: %v", err)
+	}
+	pool := tree_sitter_d.NewParserPool(1)
+	defer pool.Close()
+	for _, f := range files {
+		src, err := os.ReadFile(f)
+		if err != nil {
+			t.Fatal(err)
+		}
+		limits := tree_sitter_d.Limits{MaxBytes: len(src) - 1}
+		if _, err := pool.ParseLimited(src, limits); err != tree_sitter_d.ErrTooLarge {
+			t.Errorf("%s: got %v, wanted ErrTooLarge", f, err)
+		}
+		// the ceiling enforced by make test-stress
+		tree, err := pool.ParseLimited(src, tree_sitter_d.Limits{Timeout: 2 * time.Second})
+		if err != nil {
+			t.Errorf("%s: %v", f, err)
+			continue
+		}
+		tree.Close()
+	}
+
+	src, err := os.ReadFile("../../test/stress/ambiguous.d")
+	if err != nil {
+		t.Fatal(err)
+	}
+	if _, err := pool.ParseLimited(src, tree_sitter_d.Limits{Timeout: time.Microsecond}); err != tree_sitter_d.ErrTimedOut {
+		t.Errorf("got %v, wanted ErrTimedOut", err)
+	}
+	// the parser must have been reset before it was returned
+	tree := pool.Parse(src)
+	if tree == nil {
+		t.Fatal("parse failed after a timeout")
+	}
+	tree.Close()
+}
+
+func TestQueriesCompileOnce(t *testing.T) {
+	for name, get := range map[string]func() (*tree_sitter.Query, error){
+		"highlights":  tree_sitter_d.Highlights,
+		"injections":  tree_sitter_d.Injections,
+		"tags":        tree_sitter_d.Tags,
+		"indents":     tree_sitter_d.Indents,
+		"textobjects": tree_sitter_d.TextObjects,
+	} {
+		q1, err := get()
+		if err != nil {
+			t.Errorf("%s: %v", name, err)
+			continue
+		}
+		if q2, _ := get(); q1 != q2 {
+			t.Errorf("%s: compiled twice", name)
+		}
+	}
+}
+
+// corpusSources returns the D source of each test in the corpus.
+func corpusSources(tb testing.TB) [][]byte {
+	files, err := filepath.Glob("../../test/corpus/*.scm")
+	if err != nil || len(files) == 0 {
+		tb.Fatalf("no corpus files: %v", err)
+	}
+	var sources [][]byte
+	for _, f := range files {
+		text, err := os.ReadFile(f)
+		if err != nil {
+			tb.Fatal(err)
+		}
+		var src []byte
+		state := 0 // 0: tree, 1: title, 2: source
+		for _, line := range bytes.SplitAfter(text, []byte("\n")) {
+			rule := bytes.TrimRight(line, "\r\n")
+			switch {
+			case len(rule) >= 3 && len(bytes.Trim(rule, "=")) == 0:
+				if state == 1 {
+					state = 2
+				} else {
+					if len(src) > 0 {
+						sources = append(sources, src)
+					}
+					src, state = nil, 1
+				}
+			case state == 2 && len(rule) >= 3 && len(bytes.Trim(rule, "-")) == 0:
+				state = 0
+			case state == 2:
+				src = append(src, line...)
+			}
+		}
+		if len(src) > 0 {
+			sources = append(sources, src)
+		}
+	}
+	return sources
+}
+
+// BenchmarkParserPool parses the corpus from many goroutines sharing a
+// pool, at each GOMAXPROCS from 1 to the number of CPUs, and reports
+// the files parsed per second.
+func BenchmarkParserPool(b *testing.B) {
+	sources := corpusSources(b)
+	total := 0
+	for _, src := range sources {
+		total += len(src)
+	}
+	for procs := 1; procs <= runtime.NumCPU(); procs++ {
+		b.Run(fmt.Sprintf("procs=%d", procs), func(b *testing.B) {
+			defer runtime.GOMAXPROCS(runtime.GOMAXPROCS(procs))
+			pool := tree_sitter_d.NewParserPool(procs)
+			defer pool.Close()
+			var next atomic.Int64
+			b.SetBytes(int64(total / len(sources)))
+			b.ResetTimer()
+			b.RunParallel(func(pb *testing.PB) {
+				for pb.Next() {
+					i := next.Add(1)
+					pool.Parse(sources[int(i)%len(sources)]).Close()
+				}
+			})
+			b.ReportMetric(float64(b.N)/b.Elapsed().Seconds(), "files/s")
+		})
+	}
+}
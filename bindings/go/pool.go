@@ -0,0 +1,126 @@
+package tree_sitter_d
+
+import (
+	"errors"
+	"runtime"
+	"time"
+
+	tree_sitter "github.com/tree-sitter/go-tree-sitter"
+)
+
+// ParserPool keeps parsers for this grammar, so that they can be reused
+// by many goroutines.  A parser can only be used by one goroutine at a
+// time, and creating one is costly, so batch jobs should take them from
+// a pool rather than creating one per file.
+//
+// Idle parsers are kept in a buffered channel rather than a sync.Pool,
+// because a parser holds memory that is only freed by Close, and so must
+// not be dropped by the garbage collector.  Once the pool is warm, Get
+// and Put do not allocate.
+type ParserPool struct {
+	language *tree_sitter.Language
+	idle     chan *tree_sitter.Parser
+}
+
+// NewParserPool returns a pool that keeps up to size idle parsers.  If
+// size is not positive, runtime.GOMAXPROCS(0) is used.  More parsers
+// than that may be in use at once; the extras are closed when they are
+// returned to a full pool.
+func NewParserPool(size int) *ParserPool {
+	if size <= 0 {
+		size = runtime.GOMAXPROCS(0)
+	}
+	return &ParserPool{
+		language: tree_sitter.NewLanguage(Language()),
+		idle:     make(chan *tree_sitter.Parser, size),
+	}
+}
+
+// Get takes an idle parser from the pool, or creates a new one.
+func (p *ParserPool) Get() *tree_sitter.Parser {
+	select {
+	case parser := <-p.idle:
+		return parser
+	default:
+	}
+	parser := tree_sitter.NewParser()
+	if err := parser.SetLanguage(p.language); err != nil {
+		// only possible if the runtime cannot load this grammar
+		panic(err)
+	}
+	return parser
+}
+
+// Put returns a parser taken by Get to the pool.
+func (p *ParserPool) Put(parser *tree_sitter.Parser) {
+	select {
+	case p.idle <- parser:
+	default:
+		parser.Close()
+	}
+}
+
+// Parse parses src with a parser from the pool.  The tree must be closed
+// by the caller.  It returns nil if the parse was cancelled.
+func (p *ParserPool) Parse(src []byte) *tree_sitter.Tree {
+	parser := p.Get()
+	tree := parser.Parse(src, nil)
+	if tree == nil {
+		parser.Reset()
+	}
+	p.Put(parser)
+	return tree
+}
+
+// Limits bound the work done by ParseLimited, so that a pathological
+// source (deeply nested, or broken in ways that keep error recovery
+// busy) cannot hold up a caller for long.  Zero values mean no limit.
+type Limits struct {
+	MaxBytes int           // larger sources are not parsed
+	Timeout  time.Duration // wall-clock time allowed for the parse
+}
+
+// Errors returned by ParseLimited.
+var (
+	ErrTooLarge = errors.New("tree_sitter_d: source too large")
+	ErrTimedOut = errors.New("tree_sitter_d: parse timed out")
+)
+
+// ParseLimited is like Parse, but gives up once a limit is reached.  The
+// runtime checks the time every hundred or so parser operations, so the
+// timeout may be overrun slightly.
+func (p *ParserPool) ParseLimited(src []byte, limits Limits) (*tree_sitter.Tree, error) {
+	if limits.MaxBytes > 0 && len(src) > limits.MaxBytes {
+		return nil, ErrTooLarge
+	}
+	var micros uint64
+	if limits.Timeout > 0 {
+		micros = uint64(max(limits.Timeout/time.Microsecond, 1))
+	}
+	parser := p.Get()
+	parser.SetTimeoutMicros(micros)
+	tree := parser.Parse(src, nil)
+	parser.SetTimeoutMicros(0)
+	if tree == nil {
+		// otherwise the next parse would resume this one
+		parser.Reset()
+	}
+	p.Put(parser)
+	if tree == nil {
+		return nil, ErrTimedOut
+	}
+	return tree, nil
+}
+
+// Close closes the idle parsers, freeing the memory they hold.  Parsers
+// that are in use are not affected, and the pool may still be used.
+func (p *ParserPool) Close() {
+	for {
+		select {
+		case parser := <-p.idle:
+			parser.Close()
+		default:
+			return
+		}
+	}
+}
@@ -0,0 +1,55 @@
+package tree_sitter_d
+
+import (
+	"sync"
+
+	"github.com/gdamore/tree-sitter-d/queries"
+	tree_sitter "github.com/tree-sitter/go-tree-sitter"
+)
+
+// The sources of the queries for this grammar.
+var (
+	HighlightsQuery  = queries.Highlights
+	InjectionsQuery  = queries.Injections
+	TagsQuery        = queries.Tags
+	IndentsQuery     = queries.Indents
+	TextObjectsQuery = queries.TextObjects
+)
+
+// compiledQuery compiles a query the first time it is needed, and then
+// shares it with the whole process.  Queries may be used by many
+// goroutines at once, each with its own QueryCursor.
+type compiledQuery struct {
+	once  sync.Once
+	query *tree_sitter.Query
+	err   error
+}
+
+func (c *compiledQuery) get(source string) (*tree_sitter.Query, error) {
+	c.once.Do(func() {
+		query, err := tree_sitter.NewQuery(tree_sitter.NewLanguage(Language()), source)
+		if err != nil {
+			c.err = err
+			return
+		}
+		c.query = query
+	})
+	return c.query, c.err
+}
+
+var highlights, injections, tags, indents, textObjects compiledQuery
+
+// Highlights returns the compiled HighlightsQuery.
+func Highlights() (*tree_sitter.Query, error) { return highlights.get(HighlightsQuery) }
+
+// Injections returns the compiled InjectionsQuery.
+func Injections() (*tree_sitter.Query, error) { return injections.get(InjectionsQuery) }
+
+// Tags returns the compiled TagsQuery.
+func Tags() (*tree_sitter.Query, error) { return tags.get(TagsQuery) }
+
+// Indents returns the compiled IndentsQuery.
+func Indents() (*tree_sitter.Query, error) { return indents.get(IndentsQuery) }
+
+// TextObjects returns the compiled TextObjectsQuery.
+func TextObjects() (*tree_sitter.Query, error) { return textObjects.get(TextObjectsQuery) }
@@ -7,3 +7,11 @@ test("can load grammar", () => {
   const parser = new (require("tree-sitter"))();
   assert.doesNotThrow(() => parser.setLanguage(require(".")));
 });
+
+test("queries are compiled once", () => {
+  const d = require(".");
+  for (const name of Object.keys(d.querySources)) {
+    assert.ok(d.querySources[name].length > 0);
+    assert.strictEqual(d.queries[name], d.queries[name]);
+  }
+});
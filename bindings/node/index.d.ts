@@ -18,10 +18,16 @@ type NodeInfo =
       children: ChildNode[];
     });
 
+type QueryName = "highlights" | "injections" | "tags" | "indents" | "textobjects";
+
 type Language = {
   name: string;
   language: unknown;
   nodeTypeInfo: NodeInfo[];
+  /** the source of each query, read when first used */
+  querySources: { readonly [name in QueryName]: string };
+  /** each query, compiled with the tree-sitter package when first used */
+  queries: { readonly [name in QueryName]: unknown };
 };
 
 declare const language: Language;
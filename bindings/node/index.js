@@ -1,7 +1,44 @@
-const root = require("path").join(__dirname, "..", "..");
+const fs = require("fs");
+const path = require("path");
+
+const root = path.join(__dirname, "..", "..");
 
 module.exports = require("node-gyp-build")(root);
 
 try {
   module.exports.nodeTypeInfo = require("../../src/node-types.json");
 } catch (_) {}
+
+const QUERIES = {
+  highlights: "highlights.scm",
+  injections: "injections.scm",
+  tags: "tags.scm",
+  indents: "indents.scm",
+  textobjects: "textobjects.scm",
+};
+
+// Query sources, and the queries compiled from them, are loaded the first
+// time they are used, and then kept for the life of the process.
+const querySources = {};
+const queries = {};
+for (const [name, file] of Object.entries(QUERIES)) {
+  let source;
+  let query;
+  Object.defineProperty(querySources, name, {
+    enumerable: true,
+    get: () =>
+      (source ??= fs.readFileSync(path.join(root, "queries", file), "utf8")),
+  });
+  Object.defineProperty(queries, name, {
+    enumerable: true,
+    get: () => {
+      if (query === undefined) {
+        const { Query } = require("tree-sitter");
+        query = new Query(module.exports, querySources[name]);
+      }
+      return query;
+    },
+  });
+}
+module.exports.querySources = querySources;
+module.exports.queries = queries;
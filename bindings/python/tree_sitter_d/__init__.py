@@ -1,5 +1,67 @@
 "D grammar for tree-sitter"
 
+from functools import lru_cache
+from os import cpu_count
+from os.path import dirname, join
+
 from ._binding import language
 
-__all__ = ["language"]
+_QUERIES = {
+    "HIGHLIGHTS_QUERY": "highlights.scm",
+    "INJECTIONS_QUERY": "injections.scm",
+    "TAGS_QUERY": "tags.scm",
+    "INDENTS_QUERY": "indents.scm",
+    "TEXTOBJECTS_QUERY": "textobjects.scm",
+}
+
+
+def __getattr__(name):
+    # the query sources are read the first time they are used
+    if name in _QUERIES:
+        with open(join(dirname(__file__), "queries", _QUERIES[name]), encoding="utf-8") as f:
+            globals()[name] = f.read()
+        return globals()[name]
+    raise AttributeError(f"module {__name__!r} has no attribute {name!r}")
+
+
+@lru_cache(maxsize=None)
+def query(name):
+    """Get a compiled query, by the name of its file without the .scm
+    (e.g. "highlights").  Each query is compiled the first time it is
+    asked for, and then shared by the whole process.  Requires the
+    tree_sitter package."""
+    from tree_sitter import Language, Query
+
+    key = name.upper() + "_QUERY"
+    if key not in _QUERIES:
+        raise ValueError(f"unknown query {name!r}")
+    source = __getattr__(key)
+    return Query(Language(language()), source)
+
+
+__all__ = ["language", "query", *_QUERIES]
+
+try:
+    from ._binding import parse_files as _parse_files
+except ImportError:
+    # built without the tree-sitter runtime
+    pass
+else:
+
+    def parse_files(items, threads=None, max_bytes=0, timeout_micros=0, max_operations=0):
+        """Parse files (str or os.PathLike) or sources (bytes) on a pool
+        of native threads, without holding the GIL.
+
+        Returns a dict for each item, with the number of bytes, whether
+        the tree has errors, the module name (or None), and a list of
+        (type, name, start_byte, end_byte) for its top-level declarations.
+        Items that could not be read have only a read_error message.
+
+        The work done for each item may be bounded by its size, by the
+        wall-clock time, or by the number of parser operations (zero
+        for no limit).  Items that exceed a limit are not parsed, and
+        have only a parse_error message."""
+        threads = threads or cpu_count() or 1
+        return _parse_files(items, threads, max_bytes, timeout_micros, max_operations)
+
+    __all__.append("parse_files")
@@ -1 +1,30 @@
+from os import PathLike
+from typing import Any, Final, List, Literal, Optional, Sequence, Tuple, TypedDict, Union
+
+class FileSummary(TypedDict, total=False):
+    bytes: int
+    has_error: bool
+    module: Optional[str]
+    declarations: List[Tuple[str, Optional[str], int, int]]
+    read_error: str
+    parse_error: str
+
+HIGHLIGHTS_QUERY: Final[str]
+INJECTIONS_QUERY: Final[str]
+TAGS_QUERY: Final[str]
+INDENTS_QUERY: Final[str]
+TEXTOBJECTS_QUERY: Final[str]
+
 def language() -> int: ...
+def query(
+    name: Literal["highlights", "injections", "tags", "indents", "textobjects"]
+) -> Any: ...
+
+# only present when built with the tree-sitter runtime
+def parse_files(
+    items: Sequence[Union[str, bytes, PathLike[str]]],
+    threads: Optional[int] = None,
+    max_bytes: int = 0,
+    timeout_micros: int = 0,
+    max_operations: int = 0,
+) -> List[FileSummary]: ...
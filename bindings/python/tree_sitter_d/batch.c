@@ -0,0 +1,451 @@
+/*
+ * Multi-threaded batch parsing for the Python binding.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// parse_files(items, threads, max_bytes, timeout_micros, max_operations)
+// parses a list of files (given by path) or sources (given as bytes) on a
+// fixed number of C threads, without holding the GIL, and returns a
+// summary of each: its size, whether it has syntax errors, its module
+// name, and its top-level declarations.  The limits (zero for none) are
+// those of ts_d_parse_bounded, and apply to each item.
+//
+// The items are claimed one at a time by the threads, each of which
+// reuses a single TSParser for all of the items it parses.  Python
+// objects are only touched before the threads start and after they
+// have all finished, so only the pythread API is used while the GIL is
+// released.
+
+#include <Python.h>
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tree_sitter/api.h>
+
+#include "tree-sitter-d-bounded.h"
+#include "tree-sitter-d.h"
+
+// not part of the limited API
+#ifndef PYTHREAD_INVALID_THREAD_ID
+#define PYTHREAD_INVALID_THREAD_ID ((unsigned long)-1)
+#endif
+
+typedef struct {
+    const char *type; // static, owned by the language
+    char       *name; // NULL if it could not be determined
+    uint32_t    start;
+    uint32_t    end;
+} decl;
+
+typedef struct {
+    // input, set up while holding the GIL
+    PyObject   *path;     // bytes from PyUnicode_FSConverter, or NULL
+    const char *pathname; // the contents of path
+    const char *source;   // or the contents of a bytes object
+    Py_ssize_t  length;
+
+    // output, filled in by a worker thread
+    int               err;    // errno if the file could not be read
+    ts_d_parse_status status; // if it could not be parsed
+    uint32_t bytes;
+    bool     has_error;
+    char    *module;
+    decl    *decls;
+    size_t   ndecls;
+    size_t   cap;
+} item;
+
+typedef struct {
+    item              *items;
+    size_t             nitems;
+    ts_d_parse_limits  limits;
+    size_t             next;    // next item to claim
+    int                running; // workers not yet finished
+    PyThread_type_lock lock;    // protects next and running
+    PyThread_type_lock done;    // released by the last worker
+} batch;
+
+static char *read_file(const char *path, size_t *lenp, int *errp) {
+    FILE  *f;
+    char  *buf = NULL;
+    size_t len = 0;
+    size_t cap = 0;
+    size_t n;
+
+    if ((f = fopen(path, "rb")) == NULL) {
+        *errp = errno;
+        return NULL;
+    }
+    do {
+        if (len == cap) {
+            char *nb;
+            cap = cap ? cap * 2 : 65536;
+            if ((nb = realloc(buf, cap)) == NULL) {
+                free(buf);
+                fclose(f);
+                *errp = ENOMEM;
+                return NULL;
+            }
+            buf = nb;
+        }
+        n = fread(buf + len, 1, cap - len, f);
+        len += n;
+    } while (n > 0);
+    if (ferror(f)) {
+        *errp = EIO;
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    *lenp = len;
+    return buf;
+}
+
+static char *node_text(TSNode node, const char *src) {
+    uint32_t start = ts_node_start_byte(node);
+    uint32_t len = ts_node_end_byte(node) - start;
+    char    *s;
+
+    if ((s = malloc(len + 1)) != NULL) {
+        memcpy(s, src + start, len);
+        s[len] = 0;
+    }
+    return s;
+}
+
+static bool is_type(TSNode node, const char *type) {
+    return strcmp(ts_node_type(node), type) == 0;
+}
+
+// child_of_type finds the first named child of the given type.  A cursor
+// is used, as indexing the children of a node is linear in the index.
+static bool child_of_type(TSNode node, const char *type, TSNode *child) {
+    TSTreeCursor cursor = ts_tree_cursor_new(node);
+    bool         found = false;
+
+    if (ts_tree_cursor_goto_first_child(&cursor)) {
+        do {
+            TSNode c = ts_tree_cursor_current_node(&cursor);
+            if (ts_node_is_named(c) && is_type(c, type)) {
+                *child = c;
+                found = true;
+                break;
+            }
+        } while (ts_tree_cursor_goto_next_sibling(&cursor));
+    }
+    ts_tree_cursor_delete(&cursor);
+    return found;
+}
+
+// decl_name finds the name of a declaration: its name field, or for
+// variables and manifest constants, the name of its first declarator, or
+// failing those (as for auto declarations), its first identifier.
+static char *decl_name(TSNode node, const char *src) {
+    TSNode c = ts_node_child_by_field_name(node, "name", 4);
+
+    if (ts_node_is_null(c)) {
+        TSNode d = ts_node_child_by_field_name(node, "declarator", 10);
+        if (!ts_node_is_null(d)) {
+            c = ts_node_child_by_field_name(d, "name", 4);
+        }
+    }
+    if (ts_node_is_null(c) && !child_of_type(node, "identifier", &c)) {
+        return NULL;
+    }
+    return node_text(c, src);
+}
+
+static void add_decl(item *it, TSNode node, const char *src) {
+    decl *d;
+
+    if (it->ndecls == it->cap) {
+        size_t n = it->cap ? it->cap * 2 : 8;
+        if ((d = realloc(it->decls, n * sizeof(decl))) == NULL) {
+            return;
+        }
+        it->decls = d;
+        it->cap = n;
+    }
+    d = &it->decls[it->ndecls++];
+    d->type = ts_node_type(node);
+    d->name = decl_name(node, src);
+    d->start = ts_node_start_byte(node);
+    d->end = ts_node_end_byte(node);
+}
+
+static void summarize(item *it, TSNode node, const char *src) {
+    TSTreeCursor cursor = ts_tree_cursor_new(node);
+
+    if (ts_tree_cursor_goto_first_child(&cursor)) {
+        do {
+            TSNode c = ts_tree_cursor_current_node(&cursor);
+            TSNode fqn;
+            if (!ts_node_is_named(c) || is_type(c, "comment")) {
+                continue;
+            }
+            if (is_type(c, "module_def")) {
+                summarize(it, c, src);
+            } else if (is_type(c, "module_declaration")) {
+                fqn = ts_node_child_by_field_name(c, "name", 4);
+                if (it->module == NULL && !ts_node_is_null(fqn)) {
+                    it->module = node_text(fqn, src);
+                }
+            } else {
+                add_decl(it, c, src);
+            }
+        } while (ts_tree_cursor_goto_next_sibling(&cursor));
+    }
+    ts_tree_cursor_delete(&cursor);
+}
+
+static void parse_item(TSParser *parser, const ts_d_parse_limits *limits, item *it) {
+    const char *src = it->source;
+    size_t      len = (size_t)it->length;
+    char       *buf = NULL;
+    TSTree     *tree;
+
+    if (it->pathname != NULL) {
+        if ((buf = read_file(it->pathname, &len, &it->err)) == NULL) {
+            return;
+        }
+        src = buf;
+    }
+    if (len > UINT32_MAX) {
+        it->err = EFBIG;
+        free(buf);
+        return;
+    }
+    it->bytes = (uint32_t)len;
+    if ((it->status = ts_d_parse_bounded(parser, NULL, src, it->bytes, limits, &tree)) != TS_D_PARSE_OK) {
+        free(buf);
+        return;
+    }
+    it->has_error = ts_node_has_error(ts_tree_root_node(tree));
+    summarize(it, ts_tree_root_node(tree), src);
+    ts_tree_delete(tree);
+    free(buf);
+}
+
+static void worker(void *arg) {
+    batch    *b = arg;
+    TSParser *parser = ts_parser_new();
+    bool      last;
+
+    ts_parser_set_language(parser, tree_sitter_d());
+    for (;;) {
+        size_t i;
+        PyThread_acquire_lock(b->lock, WAIT_LOCK);
+        i = b->next++;
+        PyThread_release_lock(b->lock);
+        if (i >= b->nitems) {
+            break;
+        }
+        parse_item(parser, &b->limits, &b->items[i]);
+    }
+    ts_parser_delete(parser);
+
+    PyThread_acquire_lock(b->lock, WAIT_LOCK);
+    last = --b->running == 0;
+    PyThread_release_lock(b->lock);
+    // the batch may be freed as soon as done is released
+    if (last) {
+        PyThread_release_lock(b->done);
+    }
+}
+
+static PyObject *decode(const char *s) {
+    if (s == NULL) {
+        Py_RETURN_NONE;
+    }
+    return PyUnicode_DecodeUTF8(s, (Py_ssize_t)strlen(s), "replace");
+}
+
+static PyObject *item_result(const item *it) {
+    PyObject *res;
+    PyObject *decls = NULL;
+    PyObject *v;
+
+    if ((res = PyDict_New()) == NULL) {
+        return NULL;
+    }
+    if (it->err != 0) {
+        if ((v = PyUnicode_FromString(strerror(it->err))) == NULL ||
+            PyDict_SetItemString(res, "read_error", v) < 0) {
+            goto fail;
+        }
+        Py_DECREF(v);
+        return res;
+    }
+    if (it->status != TS_D_PARSE_OK) {
+        if ((v = PyUnicode_FromString(ts_d_parse_status_name(it->status))) == NULL ||
+            PyDict_SetItemString(res, "parse_error", v) < 0) {
+            goto fail;
+        }
+        Py_DECREF(v);
+        return res;
+    }
+    if ((v = PyLong_FromUnsignedLong(it->bytes)) == NULL || PyDict_SetItemString(res, "bytes", v) < 0) {
+        goto fail;
+    }
+    Py_DECREF(v);
+    if (PyDict_SetItemString(res, "has_error", it->has_error ? Py_True : Py_False) < 0) {
+        v = NULL;
+        goto fail;
+    }
+    if ((v = decode(it->module)) == NULL || PyDict_SetItemString(res, "module", v) < 0) {
+        goto fail;
+    }
+    Py_DECREF(v);
+
+    if ((decls = PyList_New((Py_ssize_t)it->ndecls)) == NULL) {
+        v = NULL;
+        goto fail;
+    }
+    for (size_t i = 0; i < it->ndecls; i++) {
+        const decl *d = &it->decls[i];
+        // node types are interned, as there are few of them
+        PyObject *type = PyUnicode_InternFromString(d->type);
+        PyObject *name = decode(d->name);
+        v = NULL;
+        if (type != NULL && name != NULL) {
+            v = Py_BuildValue("(OOkk)", type, name, (unsigned long)d->start, (unsigned long)d->end);
+        }
+        Py_XDECREF(type);
+        Py_XDECREF(name);
+        if (v == NULL) {
+            goto fail;
+        }
+        PyList_SetItem(decls, (Py_ssize_t)i, v);
+    }
+    v = decls;
+    decls = NULL;
+    if (PyDict_SetItemString(res, "declarations", v) < 0) {
+        goto fail;
+    }
+    Py_DECREF(v);
+    return res;
+
+fail:
+    Py_XDECREF(v);
+    Py_XDECREF(decls);
+    Py_DECREF(res);
+    return NULL;
+}
+
+static void free_items(item *items, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        Py_XDECREF(items[i].path);
+        free(items[i].module);
+        for (size_t j = 0; j < items[i].ndecls; j++) {
+            free(items[i].decls[j].name);
+        }
+        free(items[i].decls);
+    }
+    PyMem_Free(items);
+}
+
+PyObject *_binding_parse_files(PyObject *Py_UNUSED(self), PyObject *args) {
+    PyObject          *seq;
+    PyObject          *list;
+    PyObject          *results = NULL;
+    int                nthreads;
+    unsigned int       max_bytes = 0;
+    unsigned long long timeout = 0;
+    unsigned long long operations = 0;
+    int                failed = 0;
+    batch              b;
+
+    if (!PyArg_ParseTuple(args, "Oi|IKK:parse_files", &seq, &nthreads, &max_bytes, &timeout, &operations)) {
+        return NULL;
+    }
+    if (nthreads < 1) {
+        PyErr_SetString(PyExc_ValueError, "threads must be at least 1");
+        return NULL;
+    }
+    // the list keeps the bytes objects alive while they are parsed
+    if ((list = PySequence_List(seq)) == NULL) {
+        return NULL;
+    }
+
+    memset(&b, 0, sizeof(b));
+    b.limits.max_bytes = max_bytes;
+    b.limits.timeout_micros = timeout;
+    b.limits.max_operations = operations;
+    b.nitems = (size_t)PyList_Size(list);
+    if ((b.items = PyMem_Calloc(b.nitems ? b.nitems : 1, sizeof(item))) == NULL) {
+        Py_DECREF(list);
+        return PyErr_NoMemory();
+    }
+    for (size_t i = 0; i < b.nitems; i++) {
+        PyObject *obj = PyList_GetItem(list, (Py_ssize_t)i);
+        item     *it = &b.items[i];
+        if (PyBytes_Check(obj)) {
+            char *s;
+            if (PyBytes_AsStringAndSize(obj, &s, &it->length) < 0) {
+                goto out;
+            }
+            it->source = s;
+        } else if (PyUnicode_FSConverter(obj, &it->path)) {
+            it->pathname = PyBytes_AsString(it->path);
+        } else {
+            goto out;
+        }
+    }
+
+    if ((size_t)nthreads > b.nitems) {
+        nthreads = b.nitems ? (int)b.nitems : 1;
+    }
+    if ((b.lock = PyThread_allocate_lock()) == NULL || (b.done = PyThread_allocate_lock()) == NULL) {
+        PyErr_NoMemory();
+        goto out;
+    }
+    PyThread_acquire_lock(b.done, WAIT_LOCK);
+    b.running = nthreads;
+    for (int i = 0; i < nthreads; i++) {
+        if (PyThread_start_new_thread(worker, &b) == PYTHREAD_INVALID_THREAD_ID) {
+            failed++;
+        }
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    // any workers that could not be started are run here instead
+    for (int i = 0; i < failed; i++) {
+        worker(&b);
+    }
+    PyThread_acquire_lock(b.done, WAIT_LOCK);
+    Py_END_ALLOW_THREADS
+
+    if ((results = PyList_New((Py_ssize_t)b.nitems)) == NULL) {
+        goto out;
+    }
+    for (size_t i = 0; i < b.nitems; i++) {
+        PyObject *res;
+        if ((res = item_result(&b.items[i])) == NULL) {
+            Py_CLEAR(results);
+            goto out;
+        }
+        PyList_SetItem(results, (Py_ssize_t)i, res);
+    }
+
+out:
+    if (b.lock != NULL) {
+        PyThread_free_lock(b.lock);
+    }
+    if (b.done != NULL) {
+        PyThread_release_lock(b.done);
+        PyThread_free_lock(b.done);
+    }
+    free_items(b.items, b.nitems);
+    Py_DECREF(list);
+    return results;
+}
@@ -4,6 +4,10 @@ typedef struct TSLanguage TSLanguage;
 
 TSLanguage *tree_sitter_d(void);
 
+#ifdef TREE_SITTER_D_BATCH
+PyObject *_binding_parse_files(PyObject *self, PyObject *args);
+#endif
+
 static PyObject* _binding_language(PyObject *Py_UNUSED(self), PyObject *Py_UNUSED(args)) {
     return PyCapsule_New(tree_sitter_d(), "tree_sitter.Language", NULL);
 }
@@ -11,6 +15,10 @@ static PyObject* _binding_language(PyObject *Py_UNUSED(self), PyObject *Py_UNUSE
 static PyMethodDef methods[] = {
     {"language", _binding_language, METH_NOARGS,
      "Get the tree-sitter language for this grammar."},
+#ifdef TREE_SITTER_D_BATCH
+    {"parse_files", _binding_parse_files, METH_VARARGS,
+     "Parse files or sources on a number of threads, without the GIL."},
+#endif
     {NULL, NULL, 0, NULL}
 };
 
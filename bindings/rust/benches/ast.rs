@@ -0,0 +1,154 @@
+//! Compares a walk with the typed visitor of the `ast` feature against
+//! the same walk matching on `Node::kind` strings, over the sources of
+//! the test corpus.  Both count the same things: function declarations,
+//! calls, `if` statements with an `else`, and operators.
+//!
+//! Run with `cargo bench --features ast`.
+
+use criterion::{criterion_group, criterion_main, Criterion, Throughput};
+use std::fs;
+use tree_sitter::{Node, Parser, Tree};
+use tree_sitter_d::ast::{
+    walk, AddExpression, CallExpression, FunctionDeclaration, IfStatement, MulExpression, Visit,
+    Visitor,
+};
+
+/// The D source of each test in the corpus.
+fn corpus_sources() -> Vec<String> {
+    let mut files: Vec<_> = fs::read_dir("test/corpus")
+        .expect("no corpus directory")
+        .filter_map(|e| Some(e.ok()?.path()))
+        .filter(|p| p.extension().is_some_and(|x| x == "scm"))
+        .collect();
+    files.sort();
+    let mut sources = Vec::new();
+    for file in files {
+        let text = fs::read_to_string(&file).unwrap();
+        let mut src = String::new();
+        let mut state = 0; // 0: tree, 1: title, 2: source
+        for line in text.split_inclusive('\n') {
+            let rule = line.trim_end_matches(['\r', '\n']);
+            if rule.len() >= 3 && rule.trim_matches('=').is_empty() {
+                if state == 1 {
+                    state = 2;
+                } else {
+                    if !src.is_empty() {
+                        sources.push(std::mem::take(&mut src));
+                    }
+                    state = 1;
+                }
+            } else if state == 2 && rule.len() >= 3 && rule.trim_matches('-').is_empty() {
+                state = 0;
+            } else if state == 2 {
+                src.push_str(line);
+            }
+        }
+        if !src.is_empty() {
+            sources.push(src);
+        }
+    }
+    sources
+}
+
+#[derive(Debug, Default, PartialEq)]
+struct Counts {
+    functions: usize,
+    calls: usize,
+    elses: usize,
+    operators: usize,
+}
+
+fn count_by_kind(root: Node, counts: &mut Counts) {
+    let mut cursor = root.walk();
+    loop {
+        let node = cursor.node();
+        match node.kind() {
+            "function_declaration" => counts.functions += 1,
+            "call_expression" => counts.calls += 1,
+            "if_statement" => {
+                if node.child_by_field_name("alternative").is_some() {
+                    counts.elses += 1;
+                }
+            }
+            "add_expression" | "mul_expression" => {
+                if node.child_by_field_name("operator").is_some() {
+                    counts.operators += 1;
+                }
+            }
+            _ => {}
+        }
+        if cursor.goto_first_child() {
+            continue;
+        }
+        while !cursor.goto_next_sibling() {
+            if !cursor.goto_parent() {
+                return;
+            }
+        }
+    }
+}
+
+impl<'tree> Visitor<'tree> for Counts {
+    fn visit_function_declaration(&mut self, _: FunctionDeclaration<'tree>) -> Visit {
+        self.functions += 1;
+        Visit::Children
+    }
+
+    fn visit_call_expression(&mut self, _: CallExpression<'tree>) -> Visit {
+        self.calls += 1;
+        Visit::Children
+    }
+
+    fn visit_if_statement(&mut self, node: IfStatement<'tree>) -> Visit {
+        self.elses += node.alternative().is_some() as usize;
+        Visit::Children
+    }
+
+    fn visit_add_expression(&mut self, node: AddExpression<'tree>) -> Visit {
+        self.operators += node.operator().is_some() as usize;
+        Visit::Children
+    }
+
+    fn visit_mul_expression(&mut self, node: MulExpression<'tree>) -> Visit {
+        self.operators += node.operator().is_some() as usize;
+        Visit::Children
+    }
+}
+
+fn bench_ast(c: &mut Criterion) {
+    let sources = corpus_sources();
+    let mut parser = Parser::new();
+    parser
+        .set_language(&tree_sitter_d::LANGUAGE.into())
+        .unwrap();
+    let trees: Vec<Tree> = sources
+        .iter()
+        .map(|s| parser.parse(s, None).unwrap())
+        .collect();
+    let nodes: usize = trees.iter().map(|t| t.root_node().descendant_count()).sum();
+
+    let by_kind = || {
+        let mut counts = Counts::default();
+        for tree in &trees {
+            count_by_kind(tree.root_node(), &mut counts);
+        }
+        counts
+    };
+    let typed = || {
+        let mut counts = Counts::default();
+        for tree in &trees {
+            walk(tree.root_node(), &mut counts);
+        }
+        counts
+    };
+    assert_eq!(by_kind(), typed());
+
+    let mut group = c.benchmark_group("walk");
+    group.throughput(Throughput::Elements(nodes as u64));
+    group.bench_function("kind strings", |b| b.iter(by_kind));
+    group.bench_function("typed visitor", |b| b.iter(typed));
+    group.finish();
+}
+
+criterion_group!(benches, bench_ast);
+criterion_main!(benches);
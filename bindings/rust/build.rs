@@ -1,3 +1,6 @@
+#[cfg(feature = "ast")]
+mod gen_ast;
+
 fn main() {
     let src_dir = std::path::Path::new("src");
 
@@ -18,11 +21,26 @@ fn main() {
 
     let scanner_path = src_dir.join("scanner.c");
     c_config.file(&scanner_path);
+    if std::env::var("CARGO_FEATURE_OPAQUE_TOKEN_STRINGS").is_ok() {
+        c_config.define("TREE_SITTER_D_OPAQUE_TOKEN_STRINGS", None);
+    }
+    if std::env::var("CARGO_FEATURE_DETAILED_ASM").is_ok() {
+        c_config.define("TREE_SITTER_D_DETAILED_ASM", None);
+    }
     println!("cargo:rerun-if-changed={}", scanner_path.to_str().unwrap());
 
     c_config.compile("parser");
     println!("cargo:rerun-if-changed={}", parser_path.to_str().unwrap());
 
+    #[cfg(feature = "ast")]
+    {
+        let node_types = src_dir.join("node-types.json");
+        let out = std::path::Path::new(&std::env::var("OUT_DIR").unwrap()).join("ast.rs");
+        gen_ast::write(&node_types, &out);
+        println!("cargo:rerun-if-changed={}", node_types.to_str().unwrap());
+        println!("cargo:rerun-if-changed=bindings/rust/gen_ast.rs");
+    }
+
     // If your language uses an external scanner written in C++,
     // then include this block of code:
 
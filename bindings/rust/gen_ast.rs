@@ -0,0 +1,367 @@
+//! Generates the typed syntax tree of the `ast` feature from
+//! `src/node-types.json`.
+//!
+//! Each named node kind gets a wrapper struct over `tree_sitter::Node`,
+//! with a method for each of its fields, and a variant in `Kind`, in
+//! `AnyNode`, and a method in `Visitor`.  Kind and field IDs are assigned
+//! by `tree-sitter generate`, so they are looked up by name when the
+//! language is first used, rather than written in here; after that, a
+//! kind test is an index into a table, and a field is found by its ID.
+
+use serde_json::Value;
+use std::collections::HashSet;
+use std::fmt::Write;
+use std::path::Path;
+
+struct Kind {
+    name: String,
+    ident: String,
+    method: String,
+    fields: Vec<Field>,
+}
+
+struct Field {
+    name: String,
+    method: String,
+    multiple: bool,
+    ty: FieldType,
+}
+
+enum FieldType {
+    /// A single named kind, given as the struct for it.
+    Typed(String),
+    /// Any of several named kinds.
+    Any,
+    /// Includes anonymous nodes, which have no struct.
+    Node,
+}
+
+const KEYWORDS: &[&str] = &[
+    "abstract", "as", "async", "await", "become", "box", "break", "const", "continue", "crate",
+    "do", "dyn", "else", "enum", "extern", "false", "final", "fn", "for", "if", "impl", "in",
+    "let", "loop", "macro", "match", "mod", "move", "mut", "override", "priv", "pub", "ref",
+    "return", "static", "struct", "super", "trait", "true", "try", "type", "typeof", "unsafe",
+    "unsized", "use", "virtual", "where", "while", "yield",
+];
+
+// The generated items, which no node kind may be named for.
+const RESERVED: &[&str] = &[
+    "AnyNode",
+    "AstNode",
+    "Field",
+    "Kind",
+    "Node",
+    "Other",
+    "Tables",
+    "TreeCursor",
+    "Visit",
+    "Visitor",
+];
+
+/// Makes a type name of a node kind: `add_expression` is `AddExpression`.
+/// Leading and trailing underscores are kept, so that `parameters_` does
+/// not clash with `parameters`.
+fn camel(name: &str) -> String {
+    let core = name.trim_matches('_');
+    let lead = &name[..name.len() - name.trim_start_matches('_').len()];
+    let trail = &name[name.trim_end_matches('_').len()..];
+    let mut s = String::from(lead);
+    for word in core.split('_').filter(|w| !w.is_empty()) {
+        let mut chars = word.chars();
+        s.extend(chars.next().map(|c| c.to_ascii_uppercase()));
+        s.push_str(chars.as_str());
+    }
+    s.push_str(trail);
+    s
+}
+
+fn method(name: &str) -> String {
+    if KEYWORDS.contains(&name) {
+        format!("r#{name}")
+    } else {
+        name.to_string()
+    }
+}
+
+fn fail(msg: &str) -> ! {
+    panic!("node-types.json: {msg}");
+}
+
+fn field_type(types: &[Value], structs: &HashSet<&str>) -> FieldType {
+    let named: Vec<&str> = types
+        .iter()
+        .filter(|t| t["named"] == true)
+        .filter_map(|t| t["type"].as_str())
+        .collect();
+    if named.len() != types.len() || named.iter().any(|t| !structs.contains(t)) {
+        FieldType::Node
+    } else if named.len() == 1 {
+        FieldType::Typed(camel(named[0]))
+    } else {
+        FieldType::Any
+    }
+}
+
+fn kinds(node_types: &str) -> Vec<Kind> {
+    let json: Value = serde_json::from_str(node_types).unwrap_or_else(|e| fail(&e.to_string()));
+    let types = json
+        .as_array()
+        .unwrap_or_else(|| fail("not an array of node types"));
+    let named: Vec<&Value> = types.iter().filter(|t| t["named"] == true).collect();
+    let structs: HashSet<&str> = named.iter().filter_map(|t| t["type"].as_str()).collect();
+
+    let mut seen = HashSet::new();
+    let mut kinds = Vec::new();
+    for t in named {
+        let name = t["type"]
+            .as_str()
+            .unwrap_or_else(|| fail("node type without a name"));
+        let ident = camel(name);
+        if RESERVED.contains(&ident.as_str()) || !seen.insert(ident.clone()) {
+            fail(&format!("\"{name}\" would be {ident}, which is taken"));
+        }
+        let mut fields = Vec::new();
+        if let Some(map) = t["fields"].as_object() {
+            for (fname, f) in map {
+                if fname == "node" {
+                    fail(&format!("field \"{fname}\" of \"{name}\" is reserved"));
+                }
+                let types = f["types"].as_array().map_or(&[][..], Vec::as_slice);
+                fields.push(Field {
+                    name: fname.clone(),
+                    method: method(fname),
+                    multiple: f["multiple"] == true,
+                    ty: field_type(types, &structs),
+                });
+            }
+        }
+        fields.sort_by(|a, b| a.name.cmp(&b.name));
+        kinds.push(Kind {
+            name: name.to_string(),
+            ident,
+            method: format!("visit_{name}"),
+            fields,
+        });
+    }
+    kinds.sort_by(|a, b| a.name.cmp(&b.name));
+    kinds
+}
+
+/// How an accessor makes its items of the nodes found: the method of the
+/// iterator or option to call, and the function to give it.
+fn item(ty: &FieldType, multiple: bool) -> Option<(&'static str, String)> {
+    match ty {
+        FieldType::Typed(ident) => Some((
+            if multiple { "filter_map" } else { "and_then" },
+            format!("{ident}::cast"),
+        )),
+        FieldType::Any => Some(("map", "AnyNode::new".to_string())),
+        FieldType::Node => None,
+    }
+}
+
+fn item_type(ty: &FieldType) -> String {
+    match ty {
+        FieldType::Typed(ident) => format!("{ident}<'tree>"),
+        FieldType::Any => "AnyNode<'tree>".to_string(),
+        FieldType::Node => "Node<'tree>".to_string(),
+    }
+}
+
+fn generate(kinds: &[Kind]) -> String {
+    let mut fields: Vec<&str> = kinds
+        .iter()
+        .flat_map(|k| k.fields.iter().map(|f| f.name.as_str()))
+        .collect();
+    fields.sort_unstable();
+    fields.dedup();
+
+    // each is a list of lines, one for each kind (or field)
+    let each = |f: &dyn Fn(&Kind) -> String| kinds.iter().map(f).collect::<String>();
+    let kind_variants = each(&|k| format!("    /// `{}`\n    {},\n", k.name, k.ident));
+    let from_name = each(&|k| format!("            {:?} => Kind::{},\n", k.name, k.ident));
+    let names = each(&|k| format!("            Kind::{} => {:?},\n", k.ident, k.name));
+    let any_variants = each(&|k| format!("    {0}({0}<'tree>),\n", k.ident));
+    let any_new = each(&|k| {
+        format!(
+            "            Kind::{0} => AnyNode::{0}({0}(node)),\n",
+            k.ident
+        )
+    });
+    let any_node = each(&|k| format!("            AnyNode::{}(n) => n.0,\n", k.ident));
+    let visit = each(&|k| {
+        format!(
+            "    fn {}(&mut self, node: {}<'tree>) -> Visit {{\n        \
+             Visit::Children\n    }}\n\n",
+            k.method, k.ident
+        )
+    });
+    let dispatch = each(&|k| {
+        format!(
+            "        Kind::{} => visitor.{}({}(node)),\n",
+            k.ident, k.method, k.ident
+        )
+    });
+    let field_variants: String = fields
+        .iter()
+        .map(|f| format!("    {},\n", camel(f)))
+        .collect();
+    let field_names: String = fields.iter().map(|f| format!("    {f:?},\n")).collect();
+
+    let mut out = format!(
+        r#"// Generated by bindings/rust/gen_ast.rs from src/node-types.json.
+// DO NOT EDIT.
+
+/// The named node kinds of the grammar.
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Hash)]
+pub enum Kind {{
+{kind_variants}    /// Anonymous nodes, and errors.
+    Other,
+}}
+
+impl Kind {{
+    /// The kind of a named node with the given type name.
+    pub fn from_name(name: &str) -> Kind {{
+        match name {{
+{from_name}            _ => Kind::Other,
+        }}
+    }}
+
+    /// The type name of the kind, as `Node::kind` gives it.
+    pub fn name(self) -> &'static str {{
+        match self {{
+{names}            Kind::Other => "",
+        }}
+    }}
+}}
+
+#[derive(Clone, Copy)]
+enum Field {{
+{field_variants}}}
+
+const FIELD_NAMES: [&str; {}] = [
+{field_names}];
+
+"#,
+        fields.len()
+    );
+
+    for k in kinds {
+        write!(
+            out,
+            r#"/// A `{name}` node.
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Hash)]
+pub struct {ident}<'tree>(Node<'tree>);
+
+impl<'tree> AstNode<'tree> for {ident}<'tree> {{
+    const KIND: Kind = Kind::{ident};
+
+    fn cast(node: Node<'tree>) -> Option<Self> {{
+        (Kind::of(node) == Self::KIND).then_some(Self(node))
+    }}
+
+    fn node(&self) -> Node<'tree> {{
+        self.0
+    }}
+}}
+
+"#,
+            name = k.name,
+            ident = k.ident
+        )
+        .unwrap();
+        if k.fields.is_empty() {
+            continue;
+        }
+        let accessors: Vec<String> = k.fields.iter().map(accessor).collect();
+        write!(
+            out,
+            "impl<'tree> {}<'tree> {{\n{}}}\n\n",
+            k.ident,
+            accessors.join("\n")
+        )
+        .unwrap();
+    }
+
+    write!(
+        out,
+        r#"/// A node of any kind, as the struct for its kind.
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Hash)]
+pub enum AnyNode<'tree> {{
+{any_variants}    Other(Node<'tree>),
+}}
+
+impl<'tree> AnyNode<'tree> {{
+    pub fn new(node: Node<'tree>) -> Self {{
+        match Kind::of(node) {{
+{any_new}            Kind::Other => AnyNode::Other(node),
+        }}
+    }}
+
+    pub fn node(&self) -> Node<'tree> {{
+        match self {{
+{any_node}            AnyNode::Other(n) => *n,
+        }}
+    }}
+}}
+
+/// Called by [`walk`] for each node, in order.  Each method returns
+/// whether to visit the children of the node.
+#[allow(unused_variables)]
+pub trait Visitor<'tree> {{
+{visit}    /// Anonymous nodes, and errors.
+    fn visit_other(&mut self, node: Node<'tree>) -> Visit {{
+        Visit::Children
+    }}
+}}
+
+fn dispatch<'tree>(visitor: &mut impl Visitor<'tree>, node: Node<'tree>) -> Visit {{
+    match Kind::of(node) {{
+{dispatch}        Kind::Other => visitor.visit_other(node),
+    }}
+}}
+"#
+    )
+    .unwrap();
+    out
+}
+
+/// The method for a field.
+fn accessor(f: &Field) -> String {
+    let ty = item_type(&f.ty);
+    let id = camel(&f.name);
+    let map = item(&f.ty, f.multiple).map_or(String::new(), |(m, func)| format!(".{m}({func})"));
+    if f.multiple {
+        format!(
+            r#"    /// The nodes of the `{name}` field.
+    pub fn {method}<'c>(
+        &self,
+        cursor: &'c mut TreeCursor<'tree>,
+    ) -> impl Iterator<Item = {ty}> + 'c {{
+        children(self.0, Field::{id}, cursor){map}
+    }}
+"#,
+            name = f.name,
+            method = f.method
+        )
+    } else {
+        format!(
+            r#"    /// The node of the `{name}` field.
+    pub fn {method}(&self) -> Option<{ty}> {{
+        child(self.0, Field::{id}){map}
+    }}
+"#,
+            name = f.name,
+            method = f.method
+        )
+    }
+}
+
+/// Writes the typed tree for `node_types` (the path of node-types.json)
+/// to `out`.
+pub fn write(node_types: &Path, out: &Path) {
+    let src = std::fs::read_to_string(node_types)
+        .unwrap_or_else(|e| fail(&format!("{}: {e}", node_types.display())));
+    std::fs::write(out, generate(&kinds(&src)))
+        .unwrap_or_else(|e| panic!("{}: {e}", out.display()));
+}
@@ -34,12 +34,335 @@ pub const LANGUAGE: LanguageFn = unsafe { LanguageFn::from_raw(tree_sitter_d) };
 /// [`node-types.json`]: https://tree-sitter.github.io/tree-sitter/using-parsers#static-node-types
 pub const NODE_TYPES: &str = include_str!("../../src/node-types.json");
 
-// NOTE: uncomment these to include any queries that this grammar contains:
+/// The syntax highlighting query for this grammar.
+pub const HIGHLIGHTS_QUERY: &str = include_str!("../../queries/highlights.scm");
 
-// pub const HIGHLIGHTS_QUERY: &str = include_str!("../../queries/highlights.scm");
-// pub const INJECTIONS_QUERY: &str = include_str!("../../queries/injections.scm");
-// pub const LOCALS_QUERY: &str = include_str!("../../queries/locals.scm");
-// pub const TAGS_QUERY: &str = include_str!("../../queries/tags.scm");
+/// The language injection query for this grammar.
+pub const INJECTIONS_QUERY: &str = include_str!("../../queries/injections.scm");
+
+/// The symbol tagging query for this grammar.
+pub const TAGS_QUERY: &str = include_str!("../../queries/tags.scm");
+
+/// The indentation query for this grammar.
+pub const INDENTS_QUERY: &str = include_str!("../../queries/indents.scm");
+
+/// The text objects query for this grammar.
+pub const TEXTOBJECTS_QUERY: &str = include_str!("../../queries/textobjects.scm");
+
+/// Compiled queries, shared by the whole process.
+///
+/// Compiling a query is far more costly than parsing a small file, so
+/// tools that run once per file, or that handle many requests, should
+/// use these rather than compiling the query each time.  Each query is
+/// compiled the first time it is used.  Requires the `queries` feature.
+#[cfg(feature = "queries")]
+pub mod queries {
+    use std::sync::OnceLock;
+    use tree_sitter::Query;
+
+    fn compiled(cell: &'static OnceLock<Query>, source: &str) -> &'static Query {
+        cell.get_or_init(|| {
+            Query::new(&super::LANGUAGE.into(), source).expect("Error compiling D query")
+        })
+    }
+
+    /// The compiled [`HIGHLIGHTS_QUERY`](super::HIGHLIGHTS_QUERY).
+    pub fn highlights() -> &'static Query {
+        static QUERY: OnceLock<Query> = OnceLock::new();
+        compiled(&QUERY, super::HIGHLIGHTS_QUERY)
+    }
+
+    /// The compiled [`INJECTIONS_QUERY`](super::INJECTIONS_QUERY).
+    pub fn injections() -> &'static Query {
+        static QUERY: OnceLock<Query> = OnceLock::new();
+        compiled(&QUERY, super::INJECTIONS_QUERY)
+    }
+
+    /// The compiled [`TAGS_QUERY`](super::TAGS_QUERY).
+    pub fn tags() -> &'static Query {
+        static QUERY: OnceLock<Query> = OnceLock::new();
+        compiled(&QUERY, super::TAGS_QUERY)
+    }
+
+    /// The compiled [`INDENTS_QUERY`](super::INDENTS_QUERY).
+    pub fn indents() -> &'static Query {
+        static QUERY: OnceLock<Query> = OnceLock::new();
+        compiled(&QUERY, super::INDENTS_QUERY)
+    }
+
+    /// The compiled [`TEXTOBJECTS_QUERY`](super::TEXTOBJECTS_QUERY).
+    pub fn textobjects() -> &'static Query {
+        static QUERY: OnceLock<Query> = OnceLock::new();
+        compiled(&QUERY, super::TEXTOBJECTS_QUERY)
+    }
+}
+
+/// Parsing with a limit on the work done, for sources that may be
+/// pathological: deeply nested, or broken in ways that keep error
+/// recovery busy.  Requires the `bounded` feature.
+#[cfg(feature = "bounded")]
+pub mod bounded {
+    use std::fmt;
+    use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
+    use std::sync::Arc;
+    use std::time::{Duration, Instant};
+    use tree_sitter::{LogType, Parser, Tree};
+
+    /// The limits on a parse; each is ignored when not set.  The parser
+    /// checks them about once every hundred operations, so they are not
+    /// exact.
+    #[derive(Clone, Debug, Default)]
+    pub struct Limits {
+        /// Larger sources are not parsed.
+        pub max_bytes: Option<usize>,
+        /// Wall-clock time allowed for the parse.
+        pub timeout: Option<Duration>,
+        /// Parser operations (shifts, reductions and recovery steps)
+        /// allowed, which unlike the timeout gives the same result on
+        /// any machine.  The operations are counted through the parser's
+        /// logger, which replaces any logger already set, and slows the
+        /// parse down.
+        pub max_operations: Option<u64>,
+        /// The parse stops once this is set to a non-zero value, which
+        /// may be done from another thread.
+        pub cancel: Option<Arc<AtomicUsize>>,
+    }
+
+    /// Why a parse was stopped.
+    #[derive(Clone, Copy, Debug, PartialEq, Eq)]
+    pub enum Error {
+        TooLarge,
+        TimedOut,
+        OverBudget,
+        Cancelled,
+    }
+
+    impl fmt::Display for Error {
+        fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+            f.write_str(match self {
+                Error::TooLarge => "source too large",
+                Error::TimedOut => "parse timed out",
+                Error::OverBudget => "parse over operation budget",
+                Error::Cancelled => "parse cancelled",
+            })
+        }
+    }
+
+    impl std::error::Error for Error {}
+
+    fn cancelled(limits: &Limits) -> bool {
+        limits
+            .cancel
+            .as_ref()
+            .is_some_and(|c| c.load(Ordering::Relaxed) != 0)
+    }
+
+    /// Parses `source` with `parser`, which must be set to this language,
+    /// stopping when a limit is reached.  A parser that is stopped is
+    /// reset, so that it can be used for the next source.  The parser's
+    /// timeout and cancellation flag are left as they were.
+    pub fn parse(
+        parser: &mut Parser,
+        source: &[u8],
+        old_tree: Option<&Tree>,
+        limits: &Limits,
+    ) -> Result<Tree, Error> {
+        if limits.max_bytes.is_some_and(|max| source.len() > max) {
+            return Err(Error::TooLarge);
+        }
+        let timeout = parser.timeout_micros();
+        let flag = unsafe { parser.cancellation_flag() }.map(|f| f as *const AtomicUsize);
+
+        // With a budget, the logger counts the operations, and stops the
+        // parse (through a flag of its own) for any of the limits.
+        let stop = Arc::new(AtomicUsize::new(0));
+        let over = Arc::new(AtomicU64::new(0));
+        if let Some(max) = limits.max_operations {
+            let (set_stop, set_over) = (stop.clone(), over.clone());
+            let cancel = limits.cancel.clone();
+            let mut count = 0u64;
+            parser.set_logger(Some(Box::new(move |kind, _: &str| {
+                if kind == LogType::Parse {
+                    count += 1;
+                    if count > max {
+                        set_over.store(1, Ordering::Relaxed);
+                        set_stop.store(1, Ordering::Relaxed);
+                    } else if cancel
+                        .as_ref()
+                        .is_some_and(|c| c.load(Ordering::Relaxed) != 0)
+                    {
+                        set_stop.store(1, Ordering::Relaxed);
+                    }
+                }
+            })));
+            unsafe { parser.set_cancellation_flag(Some(&stop)) };
+        } else {
+            unsafe { parser.set_cancellation_flag(limits.cancel.as_deref()) };
+        }
+        let micros = limits
+            .timeout
+            .map_or(0, |t| t.as_micros().clamp(1, u64::MAX as u128) as u64);
+        parser.set_timeout_micros(micros);
+
+        let start = Instant::now();
+        let tree = parser.parse(source, old_tree);
+
+        parser.set_timeout_micros(timeout);
+        unsafe { parser.set_cancellation_flag(flag.map(|f| &*f)) };
+        if limits.max_operations.is_some() {
+            parser.set_logger(None);
+        }
+        match tree {
+            Some(tree) => Ok(tree),
+            None => {
+                parser.reset();
+                if over.load(Ordering::Relaxed) != 0 {
+                    Err(Error::OverBudget)
+                } else if cancelled(limits) {
+                    Err(Error::Cancelled)
+                } else if limits.timeout.is_some_and(|t| start.elapsed() >= t) {
+                    Err(Error::TimedOut)
+                } else {
+                    Err(Error::Cancelled)
+                }
+            }
+        }
+    }
+}
+
+/// A typed syntax tree: a struct for each named node kind, wrapping its
+/// `Node`, with a method for each of its fields, and a visitor with a
+/// method for each kind.  These are generated from `node-types.json`
+/// when the crate is built, so they always match the grammar.
+///
+/// Kinds are tested by `kind_id`, and fields found by their IDs, rather
+/// than by comparing names.  The IDs are looked up by name the first time
+/// any of this is used, as `tree-sitter generate` may number them anew
+/// after any change to the grammar.  Requires the `ast` feature.
+///
+/// ```
+/// use tree_sitter_d::ast::{walk, IfStatement, Visit, Visitor};
+///
+/// struct Ifs(usize);
+/// impl<'tree> Visitor<'tree> for Ifs {
+///     fn visit_if_statement(&mut self, node: IfStatement<'tree>) -> Visit {
+///         self.0 += node.alternative().is_some() as usize;
+///         Visit::Children
+///     }
+/// }
+///
+/// let mut parser = tree_sitter::Parser::new();
+/// parser.set_language(&tree_sitter_d::LANGUAGE.into()).unwrap();
+/// let tree = parser
+///     .parse("void f() { if (a) b(); else c(); }", None)
+///     .unwrap();
+/// let mut ifs = Ifs(0);
+/// walk(tree.root_node(), &mut ifs);
+/// assert_eq!(ifs.0, 1);
+/// ```
+#[cfg(feature = "ast")]
+pub mod ast {
+    use std::sync::OnceLock;
+    use tree_sitter::{FieldId, Language, Node, TreeCursor};
+
+    /// A node of one kind, as its struct.
+    pub trait AstNode<'tree>: Copy {
+        /// The kind of the node.
+        const KIND: Kind;
+
+        /// The node as this struct, if it is of this kind.
+        fn cast(node: Node<'tree>) -> Option<Self>;
+
+        /// The node itself.
+        fn node(&self) -> Node<'tree>;
+    }
+
+    /// What [`walk`] does after a visitor method returns.
+    #[derive(Clone, Copy, Debug, PartialEq, Eq)]
+    pub enum Visit {
+        /// Visit the children of the node, and then its next sibling.
+        Children,
+        /// Skip the children of the node.
+        Skip,
+        /// End the walk.
+        Stop,
+    }
+
+    struct Tables {
+        /// The kind of each symbol, by ID.
+        kinds: Box<[Kind]>,
+        /// The ID of each field, by `Field`.
+        fields: [Option<FieldId>; FIELD_NAMES.len()],
+    }
+
+    fn tables() -> &'static Tables {
+        static TABLES: OnceLock<Tables> = OnceLock::new();
+        TABLES.get_or_init(|| {
+            let language: Language = super::LANGUAGE.into();
+            let kinds = (0..language.node_kind_count() as u16)
+                .map(|id| match language.node_kind_for_id(id) {
+                    Some(name)
+                        if language.node_kind_is_named(id) && language.node_kind_is_visible(id) =>
+                    {
+                        Kind::from_name(name)
+                    }
+                    _ => Kind::Other,
+                })
+                .collect();
+            let fields = FIELD_NAMES.map(|name| language.field_id_for_name(name));
+            Tables { kinds, fields }
+        })
+    }
+
+    impl Kind {
+        /// The kind of a node.  Anonymous nodes, and errors, are
+        /// [`Kind::Other`].
+        #[inline]
+        pub fn of(node: Node<'_>) -> Kind {
+            let kinds = &tables().kinds;
+            kinds
+                .get(node.kind_id() as usize)
+                .copied()
+                .unwrap_or(Kind::Other)
+        }
+    }
+
+    fn child(node: Node<'_>, field: Field) -> Option<Node<'_>> {
+        let id = tables().fields[field as usize]?;
+        node.child_by_field_id(id.get())
+    }
+
+    fn children<'tree, 'c>(
+        node: Node<'tree>,
+        field: Field,
+        cursor: &'c mut TreeCursor<'tree>,
+    ) -> impl Iterator<Item = Node<'tree>> + 'c {
+        tables().fields[field as usize]
+            .map(move |id| node.children_by_field_id(id, cursor))
+            .into_iter()
+            .flatten()
+    }
+
+    /// Visits `node` and its descendants in order, calling the method of
+    /// `visitor` for the kind of each.
+    pub fn walk<'tree>(node: Node<'tree>, visitor: &mut impl Visitor<'tree>) {
+        let mut cursor = node.walk();
+        loop {
+            match dispatch(visitor, cursor.node()) {
+                Visit::Stop => return,
+                Visit::Children if cursor.goto_first_child() => continue,
+                _ => {}
+            }
+            while !cursor.goto_next_sibling() {
+                if !cursor.goto_parent() {
+                    return;
+                }
+            }
+        }
+    }
+
+    include!(concat!(env!("OUT_DIR"), "/ast.rs"));
+}
 
 #[cfg(test)]
 mod tests {
@@ -50,4 +373,182 @@ mod tests {
             .set_language(&super::LANGUAGE.into())
             .expect("Error loading D parser");
     }
+
+    #[cfg(feature = "queries")]
+    #[test]
+    fn test_queries_compile_once() {
+        use super::queries;
+        for query in [
+            queries::highlights,
+            queries::injections,
+            queries::tags,
+            queries::indents,
+            queries::textobjects,
+        ] {
+            assert!(std::ptr::eq(query(), query()));
+        }
+    }
+
+    #[cfg(feature = "ast")]
+    #[test]
+    fn test_ast_kinds_match_names() {
+        use super::ast::{AnyNode, Kind};
+
+        let source = "module m;\nimport std.stdio : writeln;\n\
+                      struct S { int x; }\n\
+                      void f(int a) { if (a + 1 > 2) writeln(a * 2); else return; }\n";
+        let mut parser = tree_sitter::Parser::new();
+        parser.set_language(&super::LANGUAGE.into()).unwrap();
+        let tree = parser.parse(source, None).unwrap();
+        let mut cursor = tree.walk();
+        let mut named = 0;
+        loop {
+            let node = cursor.node();
+            let kind = Kind::of(node);
+            if node.is_named() && !node.is_error() {
+                assert_eq!(kind.name(), node.kind());
+                assert_eq!(Kind::from_name(node.kind()), kind);
+                named += 1;
+            } else {
+                assert_eq!(kind, Kind::Other);
+            }
+            assert_eq!(AnyNode::new(node).node(), node);
+            if cursor.goto_first_child() {
+                continue;
+            }
+            while !cursor.goto_next_sibling() {
+                if !cursor.goto_parent() {
+                    assert!(named > 10);
+                    return;
+                }
+            }
+        }
+    }
+
+    #[cfg(feature = "ast")]
+    #[test]
+    fn test_ast_fields() {
+        use super::ast::{
+            walk, AddExpression, AstNode, CallExpression, FunctionDeclaration, IfStatement,
+            MulExpression, Visit, Visitor,
+        };
+
+        #[derive(Default)]
+        struct Fields {
+            names: Vec<String>,
+            callees: Vec<String>,
+            operators: Vec<String>,
+            elses: usize,
+        }
+
+        struct Walk<'s> {
+            source: &'s [u8],
+            fields: Fields,
+        }
+
+        impl<'tree> Visitor<'tree> for Walk<'_> {
+            fn visit_function_declaration(&mut self, node: FunctionDeclaration<'tree>) -> Visit {
+                let name = node.name().unwrap().node();
+                self.fields
+                    .names
+                    .push(name.utf8_text(self.source).unwrap().into());
+                assert!(node.parameters().is_some());
+                assert!(node.body().is_some());
+                Visit::Children
+            }
+
+            fn visit_if_statement(&mut self, node: IfStatement<'tree>) -> Visit {
+                assert!(node.condition().is_some());
+                assert!(node.consequence().is_some());
+                self.fields.elses += node.alternative().is_some() as usize;
+                Visit::Children
+            }
+
+            fn visit_call_expression(&mut self, node: CallExpression<'tree>) -> Visit {
+                let mut cursor = node.node().walk();
+                for callee in node.function(&mut cursor) {
+                    self.fields
+                        .callees
+                        .push(callee.utf8_text(self.source).unwrap().into());
+                }
+                assert!(node.arguments().is_some());
+                Visit::Children
+            }
+
+            fn visit_add_expression(&mut self, node: AddExpression<'tree>) -> Visit {
+                let op = node.operator().unwrap();
+                self.fields.operators.push(op.kind().into());
+                Visit::Children
+            }
+
+            fn visit_mul_expression(&mut self, node: MulExpression<'tree>) -> Visit {
+                let op = node.operator().unwrap();
+                self.fields.operators.push(op.kind().into());
+                Visit::Children
+            }
+        }
+
+        let source = "void f(int a) { if (a + 1 > 2) writeln(a * 2); else g(); }\n\
+                      int g() { return 0; }\n";
+        let mut parser = tree_sitter::Parser::new();
+        parser.set_language(&super::LANGUAGE.into()).unwrap();
+        let tree = parser.parse(source, None).unwrap();
+        let mut visitor = Walk {
+            source: source.as_bytes(),
+            fields: Fields::default(),
+        };
+        walk(tree.root_node(), &mut visitor);
+        assert_eq!(visitor.fields.names, ["f", "g"]);
+        assert_eq!(visitor.fields.callees, ["writeln", "g"]);
+        assert_eq!(visitor.fields.operators, ["+", "*"]);
+        assert_eq!(visitor.fields.elses, 1);
+    }
+
+    #[cfg(feature = "bounded")]
+    #[test]
+    fn test_bounded_parse_stops() {
+        use super::bounded::{parse, Error, Limits};
+        use std::sync::atomic::AtomicUsize;
+        use std::sync::Arc;
+
+        // ambiguous statements keep the parse stack split
+        let source = format!("void f()\n{{\n{}}}\n", "    a * b;\n".repeat(5000));
+        let source = source.as_bytes();
+        let mut parser = tree_sitter::Parser::new();
+        parser.set_language(&super::LANGUAGE.into()).unwrap();
+        let nodes = parser
+            .parse(source, None)
+            .unwrap()
+            .root_node()
+            .descendant_count();
+
+        let budget = Limits {
+            max_operations: Some(1000),
+            ..Default::default()
+        };
+        assert_eq!(
+            parse(&mut parser, source, None, &budget).err(),
+            Some(Error::OverBudget)
+        );
+        let cancel = Limits {
+            cancel: Some(Arc::new(AtomicUsize::new(1))),
+            ..Default::default()
+        };
+        assert_eq!(
+            parse(&mut parser, source, None, &cancel).err(),
+            Some(Error::Cancelled)
+        );
+        let small = Limits {
+            max_bytes: Some(source.len() - 1),
+            ..Default::default()
+        };
+        assert_eq!(
+            parse(&mut parser, source, None, &small).err(),
+            Some(Error::TooLarge)
+        );
+
+        // a stopped parse must not be resumed by the next one
+        let tree = parse(&mut parser, source, None, &Limits::default()).unwrap();
+        assert_eq!(tree.root_node().descendant_count(), nodes);
+    }
 }
@@ -0,0 +1,391 @@
+/*
+ * Parse cache for D sources.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// dcache keeps the syntax trees of D sources in a cache directory (see
+// treecache.h), keyed by their content.  Given paths, it parses and saves
+// the trees of the files that are not already cached.  With -p it prints
+// the outline of each file from the cache, parsing only on a miss; with
+// -c it parses each file and checks that the cached tree is the same.
+
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <ftw.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <tree_sitter/api.h>
+
+#include "tree-sitter-d.h"
+#include "treecache.h"
+
+static char **paths;
+static size_t npaths;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec);
+}
+
+static char *
+read_file(const char *path, size_t *lenp)
+{
+	FILE  *f;
+	char  *buf;
+	long   sz;
+	size_t n;
+
+	if ((f = fopen(path, "rb")) == NULL) {
+		return (NULL);
+	}
+	if ((fseek(f, 0, SEEK_END) != 0) || ((sz = ftell(f)) < 0) ||
+	    (fseek(f, 0, SEEK_SET) != 0)) {
+		fclose(f);
+		return (NULL);
+	}
+	if ((buf = malloc((size_t) sz + 1)) == NULL) {
+		fclose(f);
+		return (NULL);
+	}
+	n = fread(buf, 1, (size_t) sz, f);
+	fclose(f);
+	buf[n] = 0;
+	*lenp  = n;
+	return (buf);
+}
+
+static bool
+is_source(const char *path)
+{
+	size_t n = strlen(path);
+	return (((n > 2) && (strcmp(path + n - 2, ".d") == 0)) ||
+	    ((n > 3) && (strcmp(path + n - 3, ".di") == 0)));
+}
+
+static int
+push_path(const char *path)
+{
+	char **np;
+
+	if ((np = realloc(paths, (npaths + 1) * sizeof(char *))) == NULL) {
+		return (ENOMEM);
+	}
+	paths = np;
+	if ((paths[npaths] = strdup(path)) == NULL) {
+		return (ENOMEM);
+	}
+	npaths++;
+	return (0);
+}
+
+static int
+walk_path(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+	(void) st;
+	(void) ftw;
+	if ((type != FTW_F) || !is_source(path)) {
+		return (0);
+	}
+	return (push_path(path));
+}
+
+static int
+cmp_path(const void *a, const void *b)
+{
+	return (strcmp(*(char *const *) a, *(char *const *) b));
+}
+
+// collect gathers the sources named, and those under the directories
+// named, in path order.
+static int
+collect(char **args, int nargs)
+{
+	for (int i = 0; i < nargs; i++) {
+		struct stat st;
+		int         rv;
+		// a file named explicitly is used whatever its suffix
+		if (stat(args[i], &st) != 0) {
+			rv = errno;
+		} else if (S_ISDIR(st.st_mode)) {
+			rv = nftw(args[i], walk_path, 16, FTW_PHYS);
+			rv = (rv < 0) ? errno : rv;
+		} else {
+			rv = push_path(args[i]);
+		}
+		if (rv != 0) {
+			fprintf(stderr, "dcache: %s: %s\n", args[i],
+			    strerror(rv));
+			return (1);
+		}
+	}
+	qsort(paths, npaths, sizeof(char *), cmp_path);
+	return (0);
+}
+
+// lookup opens the cached tree for a source, parsing it and saving the
+// tree first if it is not cached (or not usable).  It returns NULL, after
+// reporting why, if there is still no tree.
+static treecache *
+lookup(TSParser *parser, const char *dir, const char *path, const char *src,
+    size_t len, bool *parsed)
+{
+	treecache *tc;
+	TSTree    *tree;
+	int        rv;
+
+	*parsed = false;
+	if (treecache_open(dir, src, len, &tc) == 0) {
+		return (tc);
+	}
+	if ((tree = ts_parser_parse_string(
+	         parser, NULL, src, (uint32_t) len)) == NULL) {
+		fprintf(stderr, "dcache: %s: parse failed\n", path);
+		return (NULL);
+	}
+	*parsed = true;
+	rv      = treecache_write(dir, tree, src, len);
+	ts_tree_delete(tree);
+	if ((rv != 0) || ((rv = treecache_open(dir, src, len, &tc)) != 0)) {
+		fprintf(stderr, "dcache: %s: %s\n", path, strerror(rv));
+		return (NULL);
+	}
+	return (tc);
+}
+
+// outline prints the named nodes of a cached tree, one to a line,
+// indented by depth, with their field names and positions.
+static void
+outline(const treecache *tc)
+{
+	const TSLanguage *lang = tree_sitter_d();
+	uint32_t          n    = treecache_header_of(tc)->nnodes;
+
+	for (uint32_t i = 0; i < n; i++) {
+		const treecache_node *node = treecache_node_at(tc, i);
+		const char           *field;
+		TSPoint               pt;
+		if ((node->flags & TREECACHE_NAMED) == 0) {
+			continue;
+		}
+		field = node->field ? ts_language_field_name_for_id(lang,
+		                          node->field)
+		                    : NULL;
+		pt    = treecache_point(tc, node->start);
+		printf("%*s%s%s%s [%u, %u] - %u bytes\n", 2 * node->depth,
+		    "", field ? field : "", field ? ": " : "",
+		    ts_language_symbol_name(lang, node->symbol), pt.row,
+		    pt.column, node->end - node->start);
+	}
+}
+
+// check_next checks that each node's subtree ends where the next node
+// at the same depth or above starts, or at the end of the tree.
+static int
+check_next(const treecache *tc, const char *path)
+{
+	uint32_t  n        = treecache_header_of(tc)->nnodes;
+	uint32_t *ends     = malloc(((size_t) n + 1) * sizeof(uint32_t));
+	uint32_t  top      = 0;
+	int       failures = 0;
+
+	if (ends == NULL) {
+		fprintf(stderr, "dcache: out of memory\n");
+		return (1);
+	}
+	for (uint32_t i = 0; i <= n; i++) {
+		uint32_t depth = i < n ? treecache_node_at(tc, i)->depth : 0;
+		while ((top > 0) &&
+		    ((i == n) ||
+		        (treecache_node_at(tc, ends[top - 1])->depth >=
+		            depth))) {
+			uint32_t j    = ends[--top];
+			uint32_t next = treecache_node_at(tc, j)->next;
+			if (next != i) {
+				printf("FAIL %s: node %u ends at %u, not %u\n",
+				    path, j, next, i);
+				failures++;
+			}
+		}
+		ends[top++] = i;
+	}
+	free(ends);
+	return (failures);
+}
+
+// check compares a cached tree with the tree parsed from the same
+// source, node by node.  It returns the number of differences.
+static int
+check(const treecache *tc, const TSTree *tree, const char *path)
+{
+	TSTreeCursor c        = ts_tree_cursor_new(ts_tree_root_node(tree));
+	uint32_t     n        = treecache_header_of(tc)->nnodes;
+	uint32_t     i        = 0;
+	int          failures = 0;
+
+	for (;;) {
+		TSNode                node  = ts_tree_cursor_current_node(&c);
+		const treecache_node *cn    = treecache_node_at(tc, i++);
+		uint32_t              depth = ts_tree_cursor_current_depth(&c);
+		TSPoint               pt;
+
+		if (depth > UINT16_MAX) {
+			depth = UINT16_MAX; // saturated in the cache
+		}
+		if ((cn == NULL) || (cn->symbol != ts_node_symbol(node)) ||
+		    (cn->field != ts_tree_cursor_current_field_id(&c)) ||
+		    (cn->start != ts_node_start_byte(node)) ||
+		    (cn->end != ts_node_end_byte(node)) ||
+		    (((cn->flags & TREECACHE_NAMED) != 0) !=
+		        ts_node_is_named(node)) ||
+		    (cn->depth != depth)) {
+			printf("FAIL %s: node %u (%s) differs\n", path, i - 1,
+			    ts_node_type(node));
+			failures++;
+			break;
+		}
+		pt = treecache_point(tc, cn->start);
+		if ((pt.row != ts_node_start_point(node).row) ||
+		    (pt.column != ts_node_start_point(node).column)) {
+			printf("FAIL %s: node %u is not at [%u, %u]\n", path,
+			    i - 1, pt.row, pt.column);
+			failures++;
+		}
+		if (ts_tree_cursor_goto_first_child(&c)) {
+			continue;
+		}
+		while (!ts_tree_cursor_goto_next_sibling(&c)) {
+			if (!ts_tree_cursor_goto_parent(&c)) {
+				goto done;
+			}
+		}
+	}
+done:
+	ts_tree_cursor_delete(&c);
+	if ((failures == 0) && (i != n)) {
+		printf("FAIL %s: %u nodes cached, %u parsed\n", path, n, i);
+		failures++;
+	}
+	if (failures == 0) {
+		failures += check_next(tc, path);
+	}
+	return (failures);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+	    "usage: dcache [-d dir] path ...\n"
+	    "       dcache [-d dir] -p path ...\n"
+	    "       dcache [-d dir] -c path ...\n");
+	exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *dir      = ".dcache";
+	bool        print    = false;
+	bool        verify   = false;
+	size_t      parsed   = 0;
+	size_t      cached   = 0;
+	int         failures = 0;
+	uint64_t    start;
+	TSParser   *parser;
+	int         opt;
+
+	while ((opt = getopt(argc, argv, "d:pc")) != -1) {
+		switch (opt) {
+		case 'd':
+			dir = optarg;
+			break;
+		case 'p':
+			print = true;
+			break;
+		case 'c':
+			verify = true;
+			break;
+		default:
+			usage();
+		}
+	}
+	if ((optind == argc) || (print && verify)) {
+		usage();
+	}
+	if (collect(argv + optind, argc - optind) != 0) {
+		return (1);
+	}
+	if ((mkdir(dir, 0777) != 0) && (errno != EEXIST)) {
+		fprintf(stderr, "dcache: %s: %s\n", dir, strerror(errno));
+		return (1);
+	}
+	parser = ts_parser_new();
+	ts_parser_set_language(parser, tree_sitter_d());
+
+	start = now_ns();
+	for (size_t i = 0; i < npaths; i++) {
+		treecache *tc;
+		char      *src;
+		size_t     len;
+		bool       miss;
+		if ((i > 0) && (strcmp(paths[i], paths[i - 1]) == 0)) {
+			continue;
+		}
+		if ((src = read_file(paths[i], &len)) == NULL) {
+			fprintf(stderr, "dcache: %s: %s\n", paths[i],
+			    strerror(errno));
+			failures++;
+			continue;
+		}
+		if ((tc = lookup(parser, dir, paths[i], src, len, &miss)) ==
+		    NULL) {
+			free(src);
+			failures++;
+			continue;
+		}
+		if (miss) {
+			parsed++;
+		} else {
+			cached++;
+		}
+		if (print) {
+			printf("%s\n", paths[i]);
+			outline(tc);
+		}
+		if (verify) {
+			TSTree *tree = ts_parser_parse_string(
+			    parser, NULL, src, (uint32_t) len);
+			failures += check(tc, tree, paths[i]);
+			ts_tree_delete(tree);
+		}
+		treecache_close(tc);
+		free(src);
+	}
+	fprintf(stderr, "%zu files: %zu parsed, %zu cached, %.1f ms\n",
+	    parsed + cached, parsed, cached,
+	    (double) (now_ns() - start) / 1e6);
+	ts_parser_delete(parser);
+	if (failures != 0) {
+		printf("%d failures\n", failures);
+		return (1);
+	}
+	return (0);
+}
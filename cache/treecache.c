@@ -0,0 +1,381 @@
+/*
+ * Content-keyed cache of D syntax trees.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <tree_sitter/api.h>
+
+#include "tree-sitter-d.h"
+#include "treecache.h"
+
+#ifndef TREECACHE_GRAMMAR
+#define TREECACHE_GRAMMAR "unknown"
+#endif
+
+struct treecache {
+	const uint8_t          *base;
+	size_t                  size;
+	const treecache_header *hdr;
+	const treecache_node   *nodes;
+	const uint32_t         *lines;
+};
+
+uint64_t
+treecache_hash(const char *src, size_t len)
+{
+	uint64_t h = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < len; i++) {
+		h ^= (uint8_t) src[i];
+		h *= 0x100000001b3ull;
+	}
+	return (h);
+}
+
+// entry_path formats the name of the entry for a hash.
+static void
+entry_path(char *buf, size_t sz, const char *dir, uint64_t hash)
+{
+	snprintf(buf, sz, "%s/%016llx%s", dir, (unsigned long long) hash,
+	    TREECACHE_SUFFIX);
+}
+
+// section checks that an array of n elements at off lies within the file.
+static bool
+section(const treecache *tc, uint32_t off, uint32_t n, size_t sz)
+{
+	return ((off % 4 == 0) && (off <= tc->size) &&
+	    ((uint64_t) n * sz <= tc->size - off));
+}
+
+int
+treecache_open(const char *dir, const char *src, size_t len, treecache **tcp)
+{
+	const TSLanguage       *lang = tree_sitter_d();
+	treecache              *tc;
+	const treecache_header *h;
+	struct stat             st;
+	uint64_t                hash = treecache_hash(src, len);
+	char                    path[4096];
+	void                   *base;
+	int                     fd;
+
+	entry_path(path, sizeof(path), dir, hash);
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		return (errno);
+	}
+	if (fstat(fd, &st) != 0) {
+		int rv = errno;
+		close(fd);
+		return (rv);
+	}
+	if ((size_t) st.st_size < sizeof(treecache_header)) {
+		close(fd);
+		return (EINVAL);
+	}
+	base = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		return (errno);
+	}
+	if ((tc = calloc(1, sizeof(*tc))) == NULL) {
+		munmap(base, (size_t) st.st_size);
+		return (ENOMEM);
+	}
+	tc->base = base;
+	tc->size = (size_t) st.st_size;
+	tc->hdr  = h = base;
+
+	// As with the symbol index, only the header and the section bounds
+	// are checked here; the accessors check the indices in the nodes.
+	// The hash names the file, but the size is checked as well, as a
+	// cheap guard against a collision.
+	if ((memcmp(h->magic, TREECACHE_MAGIC, sizeof(h->magic)) != 0) ||
+	    (h->format != TREECACHE_FORMAT) ||
+	    (h->endian != TREECACHE_ENDIAN) ||
+	    (strncmp(h->grammar, TREECACHE_GRAMMAR, sizeof(h->grammar)) !=
+	        0) ||
+	    (h->nsymbols != ts_language_symbol_count(lang)) ||
+	    (h->nfields != ts_language_field_count(lang)) ||
+	    (h->hash != hash) || (h->size != len) || (h->nnodes == 0) ||
+	    (h->nlines == 0) ||
+	    !section(tc, h->nodes, h->nnodes, sizeof(treecache_node)) ||
+	    !section(tc, h->lines, h->nlines, sizeof(uint32_t))) {
+		treecache_close(tc);
+		return (EINVAL);
+	}
+	tc->nodes = (const void *) (tc->base + h->nodes);
+	tc->lines = (const void *) (tc->base + h->lines);
+	*tcp      = tc;
+	return (0);
+}
+
+void
+treecache_close(treecache *tc)
+{
+	if (tc != NULL) {
+		munmap((void *) tc->base, tc->size);
+		free(tc);
+	}
+}
+
+const treecache_header *
+treecache_header_of(const treecache *tc)
+{
+	return (tc->hdr);
+}
+
+const treecache_node *
+treecache_node_at(const treecache *tc, uint32_t i)
+{
+	return (i < tc->hdr->nnodes ? &tc->nodes[i] : NULL);
+}
+
+uint32_t
+treecache_first_child(const treecache *tc, uint32_t node)
+{
+	const treecache_node *n = treecache_node_at(tc, node);
+
+	if ((n == NULL) || (n->next <= node + 1) ||
+	    (n->next > tc->hdr->nnodes)) {
+		return (TREECACHE_NONE);
+	}
+	return (node + 1);
+}
+
+uint32_t
+treecache_next_sibling(const treecache *tc, uint32_t parent, uint32_t child)
+{
+	const treecache_node *p = treecache_node_at(tc, parent);
+	const treecache_node *c = treecache_node_at(tc, child);
+
+	// the next index must move forward, so that a damaged entry cannot
+	// make a walk loop
+	if ((p == NULL) || (c == NULL) || (child <= parent) ||
+	    (c->next <= child) || (c->next >= p->next) ||
+	    (c->next >= tc->hdr->nnodes)) {
+		return (TREECACHE_NONE);
+	}
+	return (c->next);
+}
+
+TSPoint
+treecache_point(const treecache *tc, uint32_t byte)
+{
+	uint32_t lo = 0;
+	uint32_t hi = tc->hdr->nlines;
+	TSPoint  pt;
+
+	// the last line that starts at or before byte
+	while (hi - lo > 1) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (tc->lines[mid] <= byte) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	pt.row    = lo;
+	pt.column = byte >= tc->lines[lo] ? byte - tc->lines[lo] : 0;
+	return (pt);
+}
+
+// Writing.  The nodes are gathered with a cursor, keeping the indices of
+// the ancestors of the current node, so that each one's next index can
+// be filled in once its last descendant is seen.
+
+typedef struct {
+	treecache_node *nodes;
+	uint32_t        nnodes;
+	uint32_t        nodes_cap;
+	uint32_t       *up;
+	uint32_t        depth;
+	uint32_t        up_cap;
+} gather;
+
+static bool
+grow(void **arr, uint32_t *cap, uint32_t need, size_t sz)
+{
+	uint32_t ncap = *cap ? *cap : 256;
+	void    *n;
+
+	if (need <= *cap) {
+		return (true);
+	}
+	while (ncap < need) {
+		ncap *= 2;
+	}
+	if ((n = realloc(*arr, (size_t) ncap * sz)) == NULL) {
+		return (false);
+	}
+	*arr = n;
+	*cap = ncap;
+	return (true);
+}
+
+static bool
+add_node(gather *g, TSTreeCursor *c)
+{
+	TSNode          node = ts_tree_cursor_current_node(c);
+	treecache_node *n;
+
+	if (!grow((void **) &g->nodes, &g->nodes_cap, g->nnodes + 1,
+	        sizeof(treecache_node))) {
+		return (false);
+	}
+	n         = &g->nodes[g->nnodes++];
+	n->symbol = ts_node_symbol(node);
+	n->field  = ts_tree_cursor_current_field_id(c);
+	n->start  = ts_node_start_byte(node);
+	n->end    = ts_node_end_byte(node);
+	n->next   = g->nnodes;
+	n->depth  = g->depth > UINT16_MAX ? UINT16_MAX : (uint16_t) g->depth;
+	n->flags  = (ts_node_is_named(node) ? TREECACHE_NAMED : 0) |
+	    (ts_node_is_extra(node) ? TREECACHE_EXTRA : 0) |
+	    (ts_node_is_missing(node) ? TREECACHE_MISSING : 0) |
+	    (ts_node_has_error(node) ? TREECACHE_HAS_ERROR : 0);
+	return (true);
+}
+
+static bool
+gather_tree(gather *g, const TSTree *tree)
+{
+	TSTreeCursor c  = ts_tree_cursor_new(ts_tree_root_node(tree));
+	bool         ok = true;
+
+	for (;;) {
+		if (!add_node(g, &c)) {
+			ok = false;
+			break;
+		}
+		if (ts_tree_cursor_goto_first_child(&c)) {
+			if (!grow((void **) &g->up, &g->up_cap, g->depth + 1,
+			        sizeof(uint32_t))) {
+				ok = false;
+				break;
+			}
+			g->up[g->depth++] = g->nnodes - 1;
+			continue;
+		}
+		while (!ts_tree_cursor_goto_next_sibling(&c)) {
+			if (!ts_tree_cursor_goto_parent(&c)) {
+				ts_tree_cursor_delete(&c);
+				return (true);
+			}
+			g->nodes[g->up[--g->depth]].next = g->nnodes;
+		}
+	}
+	ts_tree_cursor_delete(&c);
+	return (ok);
+}
+
+static bool
+write_all(FILE *f, const void *data, size_t len)
+{
+	return ((len == 0) || (fwrite(data, 1, len, f) == len));
+}
+
+int
+treecache_write(
+    const char *dir, const TSTree *tree, const char *src, size_t len)
+{
+	const TSLanguage *lang = ts_tree_language(tree);
+	treecache_header  hdr;
+	gather            g;
+	uint32_t         *lines  = NULL;
+	uint32_t          nlines = 1;
+	char              path[4096];
+	char              tmp[4096 + 32];
+	FILE             *f;
+	int               rv = ENOMEM;
+
+	if (len > UINT32_MAX) {
+		return (EFBIG); // tree-sitter cannot address more
+	}
+	memset(&g, 0, sizeof(g));
+	if (!gather_tree(&g, tree)) {
+		goto out;
+	}
+	for (size_t i = 0; i < len; i++) {
+		nlines += (src[i] == '\n');
+	}
+	if ((uint64_t) g.nnodes * sizeof(treecache_node) +
+	        (uint64_t) nlines * sizeof(uint32_t) + sizeof(hdr) >
+	    UINT32_MAX) {
+		rv = EFBIG;
+		goto out;
+	}
+	if ((lines = malloc((size_t) nlines * sizeof(uint32_t))) == NULL) {
+		goto out;
+	}
+	lines[0] = 0;
+	nlines   = 1;
+	for (size_t i = 0; i < len; i++) {
+		if (src[i] == '\n') {
+			lines[nlines++] = (uint32_t) i + 1;
+		}
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, TREECACHE_MAGIC, sizeof(hdr.magic));
+	strncpy(hdr.grammar, TREECACHE_GRAMMAR, sizeof(hdr.grammar) - 1);
+	hdr.format   = TREECACHE_FORMAT;
+	hdr.endian   = TREECACHE_ENDIAN;
+	hdr.hash     = treecache_hash(src, len);
+	hdr.size     = (uint32_t) len;
+	hdr.nsymbols = ts_language_symbol_count(lang);
+	hdr.nfields  = ts_language_field_count(lang);
+	hdr.nnodes   = g.nnodes;
+	hdr.nlines   = nlines;
+	hdr.nodes    = sizeof(hdr);
+	hdr.lines    = hdr.nodes + g.nnodes * sizeof(treecache_node);
+
+	entry_path(path, sizeof(path), dir, hdr.hash);
+	snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long) getpid());
+	if ((f = fopen(tmp, "wb")) == NULL) {
+		rv = errno;
+		goto out;
+	}
+	if (!write_all(f, &hdr, sizeof(hdr)) ||
+	    !write_all(f, g.nodes, g.nnodes * sizeof(treecache_node)) ||
+	    !write_all(f, lines, nlines * sizeof(uint32_t))) {
+		rv = errno ? errno : EIO;
+		fclose(f);
+		unlink(tmp);
+		goto out;
+	}
+	if (fclose(f) != 0) {
+		rv = errno;
+		unlink(tmp);
+		goto out;
+	}
+	if (rename(tmp, path) != 0) {
+		rv = errno;
+		unlink(tmp);
+		goto out;
+	}
+	rv = 0;
+
+out:
+	free(g.nodes);
+	free(g.up);
+	free(lines);
+	return (rv);
+}
@@ -0,0 +1,112 @@
+/*
+ * Content-keyed cache of D syntax trees.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef TREECACHE_H
+#define TREECACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <tree_sitter/api.h>
+
+// Each tree is kept in a file of its own in the cache directory, named
+// for a hash of the source it was parsed from, and laid out so that it
+// can be mapped and walked in place, without the parser or a TSTree.
+// All integers are in host byte order; an entry written on a host of the
+// other byte order is rejected, and simply written again.
+//
+//   header
+//   nodes     treecache_node[nnodes], in document order
+//   lines     uint32_t[nlines], the byte offset of each line
+//
+// The nodes are those a TSTreeCursor visits, named and anonymous, with
+// the symbols and field IDs of the parser that wrote them; so that they
+// can be compared with the constants of tree-sitter-d-symbols.h, an
+// entry is only used with a parser of the same grammar VERSION, and the
+// same number of symbols and fields.  Each node gives the index of the
+// node after its last descendant, so that a walk can skip a subtree.
+
+#define TREECACHE_MAGIC "DTCACHE"
+#define TREECACHE_FORMAT 1
+#define TREECACHE_ENDIAN 0x01020304u
+#define TREECACHE_SUFFIX ".dtree"
+
+// no such node
+#define TREECACHE_NONE UINT32_MAX
+
+// node flags
+#define TREECACHE_NAMED 0x1
+#define TREECACHE_EXTRA 0x2
+#define TREECACHE_MISSING 0x4
+#define TREECACHE_HAS_ERROR 0x8
+
+typedef struct {
+	char     magic[8];
+	uint32_t format;
+	uint32_t endian;
+	char     grammar[16]; // grammar VERSION the tree was parsed with
+	uint64_t hash;        // FNV-1a of the source
+	uint32_t size;        // source length in bytes
+	uint32_t nsymbols;    // ts_language_symbol_count of the parser
+	uint32_t nfields;     // ts_language_field_count of the parser
+	uint32_t nnodes;
+	uint32_t nlines;
+	uint32_t nodes; // offset of the nodes section
+	uint32_t lines; // offset of the lines section
+	uint32_t reserved;
+} treecache_header;
+
+typedef struct {
+	uint16_t symbol; // ts_node_symbol
+	uint16_t field;  // field ID in the parent, or 0
+	uint32_t start;  // byte span
+	uint32_t end;
+	uint32_t next;  // index of the node after the last descendant
+	uint16_t flags; // TREECACHE_NAMED and so on
+	uint16_t depth; // 0 for the root, saturating
+} treecache_node;
+
+typedef struct treecache treecache;
+
+// treecache_hash returns the FNV-1a hash of a source, which keys it.
+extern uint64_t treecache_hash(const char *src, size_t len);
+
+// treecache_open maps the tree cached in dir for a source.  It returns 0,
+// ENOENT if there is none, or EINVAL if there is one that this parser
+// would not have produced (from another grammar, or a stale or damaged
+// entry); or another errno.
+extern int treecache_open(
+    const char *dir, const char *src, size_t len, treecache **tcp);
+extern void treecache_close(treecache *tc);
+
+extern const treecache_header *treecache_header_of(const treecache *tc);
+
+// treecache_node_at returns NULL for an index out of range.  Node 0 is
+// the root.
+extern const treecache_node *treecache_node_at(const treecache *, uint32_t);
+
+// treecache_first_child returns the index of the first child of a node,
+// and treecache_next_sibling that of the sibling after a child of parent;
+// either returns TREECACHE_NONE when there is none.
+extern uint32_t treecache_first_child(const treecache *tc, uint32_t node);
+extern uint32_t treecache_next_sibling(
+    const treecache *tc, uint32_t parent, uint32_t child);
+
+// treecache_point gives the zero based row, and the column in bytes, of
+// a byte offset, as TSPoint would.
+extern TSPoint treecache_point(const treecache *tc, uint32_t byte);
+
+// treecache_write saves the tree parsed from a source in dir, writing a
+// temporary file and renaming it into place, so that readers with the old
+// entry mapped are unaffected.  It returns 0 or an errno.
+extern int treecache_write(
+    const char *dir, const TSTree *tree, const char *src, size_t len);
+
+#endif // TREECACHE_H
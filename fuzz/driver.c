@@ -0,0 +1,316 @@
+/*
+ * Replay driver for the fuzz targets, for builds without libFuzzer.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// Linked with a fuzz target in place of libFuzzer, this runs the target
+// once on each input given (or on each file in a directory given), so
+// that the regression inputs can be checked with any compiler, and with
+// whatever sanitizers it has.  Each input has a time limit, after which
+// the program aborts, naming the input.
+//
+// Inputs that take much longer for their size than the rest are
+// reported as slow: those taking at least -m milliseconds, and more than
+// -s times the median time per byte (with 256 bytes added to each input,
+// so that tiny inputs do not skew it).  With -r they are copied to a
+// directory, to be checked in as regression inputs; with -f they fail
+// the run.
+
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+typedef struct {
+	char    *path;
+	uint8_t *data;
+	size_t   size;
+	uint64_t ns;
+	double   ratio;
+} input;
+
+static input *inputs;
+static size_t ninputs;
+
+// the input being run, for the timeout handler
+static const char *volatile running;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec);
+}
+
+static void
+on_alarm(int sig)
+{
+	const char *msg = "fuzz driver: timeout on ";
+	(void) sig;
+	// only async-signal-safe calls here
+	(void) !write(STDERR_FILENO, msg, strlen(msg));
+	(void) !write(STDERR_FILENO, running, strlen(running));
+	(void) !write(STDERR_FILENO, "\n", 1);
+	abort();
+}
+
+static int
+add_input(const char *path)
+{
+	FILE   *f;
+	input  *ni;
+	uint8_t buf[65536];
+	size_t  n;
+	input  *in;
+
+	if ((ni = realloc(inputs, (ninputs + 1) * sizeof(input))) == NULL) {
+		return (ENOMEM);
+	}
+	inputs = ni;
+	in     = &inputs[ninputs];
+	memset(in, 0, sizeof(*in));
+	if ((in->path = strdup(path)) == NULL) {
+		return (ENOMEM);
+	}
+	if ((f = fopen(path, "rb")) == NULL) {
+		free(in->path);
+		return (errno);
+	}
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+		uint8_t *nd;
+		if ((nd = realloc(in->data, in->size + n)) == NULL) {
+			fclose(f);
+			return (ENOMEM);
+		}
+		in->data = nd;
+		memcpy(in->data + in->size, buf, n);
+		in->size += n;
+	}
+	fclose(f);
+	ninputs++;
+	return (0);
+}
+
+static int
+cmp_name(const void *a, const void *b)
+{
+	return (strcmp(*(char *const *) a, *(char *const *) b));
+}
+
+// add_dir adds the files in a directory, in name order, skipping hidden
+// files and subdirectories.
+static int
+add_dir(const char *dir)
+{
+	DIR           *d;
+	struct dirent *ent;
+	char         **names = NULL;
+	size_t         n     = 0;
+	int            rv    = 0;
+
+	if ((d = opendir(dir)) == NULL) {
+		return (errno);
+	}
+	while ((ent = readdir(d)) != NULL) {
+		char      **nn;
+		char       *path;
+		struct stat st;
+		if (ent->d_name[0] == '.') {
+			continue;
+		}
+		if ((path = malloc(strlen(dir) + strlen(ent->d_name) + 2)) ==
+		    NULL) {
+			rv = ENOMEM;
+			break;
+		}
+		sprintf(path, "%s/%s", dir, ent->d_name);
+		if ((stat(path, &st) != 0) || !S_ISREG(st.st_mode)) {
+			free(path);
+			continue;
+		}
+		if ((nn = realloc(names, (n + 1) * sizeof(char *))) == NULL) {
+			free(path);
+			rv = ENOMEM;
+			break;
+		}
+		names      = nn;
+		names[n++] = path;
+	}
+	closedir(d);
+	qsort(names, n, sizeof(char *), cmp_name);
+	for (size_t i = 0; i < n; i++) {
+		if (rv == 0) {
+			rv = add_input(names[i]);
+		}
+		free(names[i]);
+	}
+	free(names);
+	return (rv);
+}
+
+static int
+cmp_ratio(const void *a, const void *b)
+{
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+	return ((x > y) - (x < y));
+}
+
+// save_input copies an input to dir, named for a hash of its contents,
+// so that the same input is only saved once.
+static void
+save_input(const char *dir, const input *in)
+{
+	uint64_t h = 0xcbf29ce484222325ull;
+	char     path[4096];
+	FILE    *f;
+
+	for (size_t i = 0; i < in->size; i++) {
+		h = (h ^ in->data[i]) * 0x100000001b3ull;
+	}
+	snprintf(path, sizeof(path), "%s/slow-%016llx", dir,
+	    (unsigned long long) h);
+	if (((f = fopen(path, "wb")) == NULL) ||
+	    (fwrite(in->data, 1, in->size, f) != in->size)) {
+		fprintf(stderr, "fuzz driver: %s: %s\n", path,
+		    strerror(errno));
+	} else {
+		printf("saved %s as %s\n", in->path, path);
+	}
+	if (f != NULL) {
+		fclose(f);
+	}
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr,
+	    "usage: %s [-t seconds] [-m ms] [-s factor] [-r dir] [-f] "
+	    "input ...\n",
+	    prog);
+	exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct sigaction sa;
+	unsigned         timeout = 10;
+	double           min_ms  = 10;
+	double           factor  = 10;
+	const char      *save    = NULL;
+	bool             fail    = false;
+	double          *ratios;
+	double           median;
+	size_t           slow = 0;
+	int              opt;
+
+	while ((opt = getopt(argc, argv, "t:m:s:r:f")) != -1) {
+		switch (opt) {
+		case 't':
+			timeout = (unsigned) atoi(optarg);
+			break;
+		case 'm':
+			min_ms = atof(optarg);
+			break;
+		case 's':
+			factor = atof(optarg);
+			break;
+		case 'r':
+			save = optarg;
+			break;
+		case 'f':
+			fail = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind == argc) {
+		usage(argv[0]);
+	}
+	for (int i = optind; i < argc; i++) {
+		struct stat st;
+		int         rv;
+		if (stat(argv[i], &st) != 0) {
+			rv = errno;
+		} else if (S_ISDIR(st.st_mode)) {
+			rv = add_dir(argv[i]);
+		} else {
+			rv = add_input(argv[i]);
+		}
+		if (rv != 0) {
+			fprintf(stderr, "fuzz driver: %s: %s\n", argv[i],
+			    strerror(rv));
+			return (1);
+		}
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_alarm;
+	sigaction(SIGALRM, &sa, NULL);
+	for (size_t i = 0; i < ninputs; i++) {
+		input   *in = &inputs[i];
+		uint64_t start;
+		running = in->path;
+		alarm(timeout);
+		start = now_ns();
+		LLVMFuzzerTestOneInput(in->data, in->size);
+		in->ns = now_ns() - start;
+		alarm(0);
+		in->ratio = (double) in->ns / (double) (in->size + 256);
+	}
+
+	if ((ratios = calloc(ninputs + 1, sizeof(double))) == NULL) {
+		fprintf(stderr, "fuzz driver: out of memory\n");
+		return (1);
+	}
+	for (size_t i = 0; i < ninputs; i++) {
+		ratios[i] = inputs[i].ratio;
+	}
+	qsort(ratios, ninputs, sizeof(double), cmp_ratio);
+	median = ninputs ? ratios[ninputs / 2] : 0;
+	free(ratios);
+
+	for (size_t i = 0; i < ninputs; i++) {
+		const input *in = &inputs[i];
+		if ((in->ns < (uint64_t) (min_ms * 1e6)) ||
+		    (in->ratio <= factor * median)) {
+			continue;
+		}
+		printf("slow: %s: %zu bytes, %.1f ms, %.1fx the median\n",
+		    in->path, in->size, (double) in->ns / 1e6,
+		    in->ratio / median);
+		if (save != NULL) {
+			save_input(save, in);
+		}
+		slow++;
+	}
+	printf("%zu inputs, %zu slow\n", ninputs, slow);
+
+	for (size_t i = 0; i < ninputs; i++) {
+		free(inputs[i].path);
+		free(inputs[i].data);
+	}
+	free(inputs);
+	return ((fail && (slow > 0)) ? 1 : 0);
+}
@@ -0,0 +1,184 @@
+/*
+ * Fuzz target for parsing whole D sources.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// Each input is parsed as a D source, and the tree checked: every node
+// must lie within its parent, after its previous sibling.  The middle
+// third of the source is then deleted, and the edited source reparsed
+// incrementally against the edited tree, so that the scanner is also
+// resumed from the states saved in a real tree.
+//
+// A parse that takes disproportionately many operations for the size of
+// its input is treated as a crash, so that the fuzzer keeps it: for the
+// grammar, super-linear worst cases matter as much as crashes.  The
+// budget is D_FUZZ_OPS_PER_BYTE (default 2000) parser operations per
+// byte, plus a little for tiny inputs; zero turns it off.
+
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tree_sitter/api.h>
+
+#include "tree-sitter-d-bounded.h"
+#include "tree-sitter-d.h"
+
+static TSParser *parser;
+static uint64_t  ops_per_byte = 2000;
+
+typedef struct {
+	uint32_t start;
+	uint32_t end;
+} span;
+
+// check_tree walks the tree with a cursor, keeping the spans of the
+// ancestors of the current node, as asking each node for its parent
+// would make the walk quadratic in the depth.
+static void
+check_tree(TSTree *tree, uint32_t len)
+{
+	TSNode       root  = ts_tree_root_node(tree);
+	TSTreeCursor c     = ts_tree_cursor_new(root);
+	span        *up    = NULL; // the ancestors of the current node
+	size_t       depth = 0;
+	size_t       cap   = 0;
+	uint32_t     prev  = 0; // end of the previous sibling
+
+	if (ts_node_end_byte(root) > len) {
+		fprintf(stderr, "tree ends after the source\n");
+		abort();
+	}
+	for (;;) {
+		TSNode   node  = ts_tree_cursor_current_node(&c);
+		uint32_t start = ts_node_start_byte(node);
+		uint32_t end   = ts_node_end_byte(node);
+
+		if ((start > end) || (start < prev) ||
+		    ((depth > 0) &&
+		        ((start < up[depth - 1].start) ||
+		            (end > up[depth - 1].end)))) {
+			fprintf(stderr, "%s at %u-%u is out of place\n",
+			    ts_node_type(node), start, end);
+			abort();
+		}
+		if (ts_tree_cursor_goto_first_child(&c)) {
+			if (depth == cap) {
+				cap = cap * 2 + 64;
+				up  = realloc(up, cap * sizeof(span));
+				if (up == NULL) {
+					abort();
+				}
+			}
+			up[depth].start = start;
+			up[depth].end   = end;
+			depth++;
+			prev = start;
+			continue;
+		}
+		prev = end;
+		while (!ts_tree_cursor_goto_next_sibling(&c)) {
+			if (!ts_tree_cursor_goto_parent(&c)) {
+				ts_tree_cursor_delete(&c);
+				free(up);
+				return;
+			}
+			prev = up[--depth].end;
+		}
+	}
+}
+
+static TSPoint
+point_at(const char *src, uint32_t byte)
+{
+	TSPoint p = { 0, 0 };
+	for (uint32_t i = 0; i < byte; i++) {
+		if (src[i] == '\n') {
+			p.row++;
+			p.column = 0;
+		} else {
+			p.column++;
+		}
+	}
+	return (p);
+}
+
+static TSTree *
+parse(const TSTree *old, const char *src, uint32_t len)
+{
+	ts_d_parse_limits limits;
+	ts_d_parse_status status;
+	TSTree           *tree;
+
+	memset(&limits, 0, sizeof(limits));
+	limits.max_operations = ops_per_byte * ((uint64_t) len + 64);
+	status = ts_d_parse_bounded(parser, old, src, len, &limits, &tree);
+	if (status != TS_D_PARSE_OK) {
+		fprintf(stderr, "%u bytes: %s (%llu operations)\n", len,
+		    ts_d_parse_status_name(status),
+		    (unsigned long long) limits.max_operations);
+		abort();
+	}
+	return (tree);
+}
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	const char *src = (const char *) data;
+	uint32_t    len = (uint32_t) size;
+	TSInputEdit edit;
+	TSTree     *tree;
+	TSTree     *again;
+	char       *edited;
+
+	if (size > UINT32_MAX) {
+		return (0);
+	}
+	if (parser == NULL) {
+		const char *env = getenv("D_FUZZ_OPS_PER_BYTE");
+		if (env != NULL) {
+			ops_per_byte = strtoull(env, NULL, 10);
+		}
+		parser = ts_parser_new();
+		ts_parser_set_language(parser, tree_sitter_d());
+	}
+
+	tree = parse(NULL, src, len);
+	check_tree(tree, len);
+
+	// delete the middle third
+	memset(&edit, 0, sizeof(edit));
+	edit.start_byte    = len / 3;
+	edit.old_end_byte  = len - (len / 3);
+	edit.new_end_byte  = edit.start_byte;
+	edit.start_point   = point_at(src, edit.start_byte);
+	edit.old_end_point = point_at(src, edit.old_end_byte);
+	edit.new_end_point = edit.start_point;
+	if ((edited = malloc(size + 1)) == NULL) {
+		abort();
+	}
+	memcpy(edited, src, edit.start_byte);
+	memcpy(edited + edit.start_byte, src + edit.old_end_byte,
+	    len - edit.old_end_byte);
+	len -= edit.old_end_byte - edit.start_byte;
+
+	ts_tree_edit(tree, &edit);
+	again = parse(tree, edited, len);
+	check_tree(again, len);
+
+	ts_tree_delete(again);
+	ts_tree_delete(tree);
+	free(edited);
+	return (0);
+}
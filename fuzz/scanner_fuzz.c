@@ -0,0 +1,235 @@
+/*
+ * Fuzz target for the external scanner of the D grammar.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// This drives tree_sitter_d_external_scanner_scan over the input the way
+// the runtime does, but without the generated parser, so that it is
+// fast enough to fuzz for hours.  The first two bytes of each input say
+// which external tokens are valid (a bit for each), and the rest is the
+// source.  The scanner is called at the start of the source, and again
+// after each token it returns, or one character further on when it
+// returns none.  Before each call its state is restored from what it
+// saved after the last token, as the runtime does.
+//
+// Besides the sanitizers, this checks that the scanner only returns
+// valid tokens, that it never ends a token before it started, that its
+// state fits in the runtime's buffer and survives being restored, and
+// that it does not keep advancing once at the end of input, which is how
+// a loop that forgets to check for the end would otherwise show up (as a
+// hang, if the fuzzer has a timeout at all).
+//
+// The scanner is included directly, so that its token enumeration and
+// state are available here.
+
+#include "../src/scanner.c"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// advances past the end of input that are taken to be a runaway loop
+#define MAX_EOF_ADVANCES 4096
+
+// fuzz_lexer is a TSLexer over an array of code points.  The base member
+// must be first, as the scanner only sees the TSLexer.
+typedef struct {
+	TSLexer         base;
+	const int32_t  *text;
+	const uint32_t *columns;
+	uint32_t        len;
+	uint32_t        pos;
+	uint32_t        mark;
+	bool            marked;
+	unsigned        eof_advances;
+} fuzz_lexer;
+
+static void
+fuzz_advance(TSLexer *l, bool skip)
+{
+	fuzz_lexer *fl = (fuzz_lexer *) l;
+	(void) skip;
+	if (fl->pos >= fl->len) {
+		if (++fl->eof_advances > MAX_EOF_ADVANCES) {
+			fprintf(stderr, "scanner keeps advancing at EOF\n");
+			abort();
+		}
+		return;
+	}
+	fl->pos++;
+	l->lookahead = (fl->pos < fl->len) ? fl->text[fl->pos] : 0;
+}
+
+static void
+fuzz_mark_end(TSLexer *l)
+{
+	fuzz_lexer *fl = (fuzz_lexer *) l;
+	fl->mark       = fl->pos;
+	fl->marked     = true;
+}
+
+static uint32_t
+fuzz_get_column(TSLexer *l)
+{
+	fuzz_lexer *fl = (fuzz_lexer *) l;
+	return (fl->columns[fl->pos]);
+}
+
+static bool
+fuzz_is_at_included_range_start(const TSLexer *l)
+{
+	(void) l;
+	return (false);
+}
+
+static bool
+fuzz_eof(const TSLexer *l)
+{
+	const fuzz_lexer *fl = (const fuzz_lexer *) l;
+	return (fl->pos >= fl->len);
+}
+
+static void
+fuzz_log(const TSLexer *l, const char *fmt, ...)
+{
+	(void) l;
+	(void) fmt;
+}
+
+// decode converts UTF-8 to code points, as the runtime would, with
+// malformed sequences taken a byte at a time.  The column of each code
+// point is recorded too, with one more for the end of input.
+static int32_t *
+decode(const uint8_t *s, size_t n, uint32_t *lenp, uint32_t **columnsp)
+{
+	int32_t  *out = malloc(sizeof(int32_t) * (n + 1));
+	uint32_t *col = malloc(sizeof(uint32_t) * (n + 1));
+	uint32_t  len = 0;
+	uint32_t  c   = 0;
+	size_t    i   = 0;
+
+	if ((out == NULL) || (col == NULL)) {
+		abort();
+	}
+	while (i < n) {
+		int32_t cp    = s[i++];
+		int     extra = 0;
+		if ((cp & 0xe0) == 0xc0) {
+			cp &= 0x1f;
+			extra = 1;
+		} else if ((cp & 0xf0) == 0xe0) {
+			cp &= 0x0f;
+			extra = 2;
+		} else if ((cp & 0xf8) == 0xf0) {
+			cp &= 0x07;
+			extra = 3;
+		}
+		while ((extra-- > 0) && (i < n) && ((s[i] & 0xc0) == 0x80)) {
+			cp = (cp << 6) | (s[i++] & 0x3f);
+		}
+		col[len]   = c;
+		out[len++] = cp;
+		c          = (cp == '\n') ? 0 : c + 1;
+	}
+	col[len]  = c;
+	*lenp     = len;
+	*columnsp = col;
+	return (out);
+}
+
+// check_state makes sure that a saved state is restored exactly.
+static void
+check_state(const char *state, unsigned len)
+{
+	char     again[TREE_SITTER_SERIALIZATION_BUFFER_SIZE];
+	void    *copy = tree_sitter_d_external_scanner_create();
+	unsigned n;
+
+	if (len > sizeof(again)) {
+		fprintf(stderr, "scanner state overflows its buffer\n");
+		abort();
+	}
+	tree_sitter_d_external_scanner_deserialize(copy, state, len);
+	n = tree_sitter_d_external_scanner_serialize(copy, again);
+	if ((n != len) || (memcmp(again, state, n) != 0)) {
+		fprintf(stderr, "scanner state not restored\n");
+		abort();
+	}
+	tree_sitter_d_external_scanner_destroy(copy);
+}
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	bool       valid[ERROR + 1];
+	char       state[TREE_SITTER_SERIALIZATION_BUFFER_SIZE];
+	unsigned   saved = 0;
+	fuzz_lexer fl;
+	int32_t   *text;
+	uint32_t  *columns;
+	void      *s;
+	uint32_t   pos = 0;
+
+	if (size < 2) {
+		return (0);
+	}
+	for (int i = 0; i <= ERROR; i++) {
+		valid[i] = ((data[i / 8] >> (i % 8)) & 1) != 0;
+	}
+	// during error recovery, the runtime makes every token valid
+	if (valid[ERROR]) {
+		memset(valid, 1, sizeof(valid));
+	}
+
+	memset(&fl, 0, sizeof(fl));
+	text       = decode(data + 2, size - 2, &fl.len, &columns);
+	fl.text    = text;
+	fl.columns = columns;
+	fl.base.advance                    = fuzz_advance;
+	fl.base.mark_end                   = fuzz_mark_end;
+	fl.base.get_column                 = fuzz_get_column;
+	fl.base.is_at_included_range_start = fuzz_is_at_included_range_start;
+	fl.base.eof                        = fuzz_eof;
+	fl.base.log                        = fuzz_log;
+
+	s = tree_sitter_d_external_scanner_create();
+	while (pos <= fl.len) {
+		uint32_t end;
+
+		tree_sitter_d_external_scanner_deserialize(s, state, saved);
+		fl.pos                = pos;
+		fl.marked             = false;
+		fl.eof_advances       = 0;
+		fl.base.lookahead     = (pos < fl.len) ? fl.text[pos] : 0;
+		fl.base.result_symbol = 0;
+
+		if (!tree_sitter_d_external_scanner_scan(s, &fl.base, valid)) {
+			pos++; // the runtime lexes something else here
+			continue;
+		}
+		if ((fl.base.result_symbol > ERROR) ||
+		    !valid[fl.base.result_symbol]) {
+			fprintf(stderr, "scanner returned invalid token %u\n",
+			    (unsigned) fl.base.result_symbol);
+			abort();
+		}
+		end = fl.marked ? fl.mark : fl.pos;
+		if (end < pos) {
+			fprintf(stderr, "token ends before it starts\n");
+			abort();
+		}
+		saved = tree_sitter_d_external_scanner_serialize(s, state);
+		check_state(state, saved);
+
+		// an empty token (at the end, say) moves nothing along
+		pos = (end > pos) ? end : pos + 1;
+	}
+	tree_sitter_d_external_scanner_destroy(s);
+	free(text);
+	free(columns);
+	return (0);
+}
@@ -0,0 +1,5 @@
+module github.com/gdamore/tree-sitter-d
+
+go 1.22
+
+require github.com/tree-sitter/go-tree-sitter v0.23.1
@@ -18,6 +18,10 @@ module.exports = grammar({
     $._string,
     $.not_in,
     $.not_is,
+    $.comment,
+    $._string_context,
+    $._asm_body,
+    $._string_chunk,
     $._after_eof,
     $.error_sentinel,
   ],
@@ -96,57 +100,14 @@ module.exports = grammar({
 
     end_file: (_) => token(seq(prec(100, choice(/\x1a/, /__EOF__/)))),
 
+    // Nesting comments (/+ ... +/) are recognized by the external scanner,
+    // which permits arbitrary nesting depth.  The other forms are handled
+    // here, when the scanner declines to match.
     comment: (_) =>
       token(
         choice(
           seq("//", /(\\+(.|\r?\n)|[^\\\n])*/),
           seq("/*", /[^*]*\*+([^/*][^*]*\*+)*/, "/"),
-          // nesting comments, we "only" support 5 levels of nesting
-          seq(
-            "/+",
-            repeat(
-              choice(
-                /[^+]/,
-                /\+[^\/]/,
-                seq(
-                  "/+",
-                  repeat(
-                    choice(
-                      /[^+]/,
-                      /\+[^\/]/,
-                      seq(
-                        "/+",
-                        repeat(
-                          choice(
-                            /[^+]/,
-                            /\+[^\/]/,
-                            seq(
-                              "/+",
-                              repeat(
-                                choice(
-                                  /[^+]/,
-                                  /\+[^\/]/,
-                                  seq(
-                                    "/+",
-                                    repeat(choice(/[^+]/, /\+[^\/]/)),
-                                    "+/",
-                                  ),
-                                ),
-                              ),
-                              "+/",
-                            ),
-                          ),
-                        ),
-                        "+/",
-                      ),
-                    ),
-                  ),
-                  "+/",
-                ),
-              ),
-            ),
-            "+/",
-          ),
         ),
       ),
 
@@ -455,7 +416,7 @@ module.exports = grammar({
         repeat($.at_attribute),
         optional(seq($.deprecated_attribute, repeat($.at_attribute))),
         $.module,
-        $.module_fqn,
+        field("name", $.module_fqn),
         ";",
       ),
 
@@ -480,11 +441,15 @@ module.exports = grammar({
     // libdparse calls this single_import
     imported: ($) =>
       choice(
-        $.module_fqn,
-        seq(field("alias", $.identifier), "=", $.module_fqn),
+        field("module", $.module_fqn),
+        seq(field("alias", $.identifier), "=", field("module", $.module_fqn)),
       ),
 
-    import_bind: ($) => seq($.identifier, optional(seq("=", $.identifier))),
+    import_bind: ($) =>
+      choice(
+        field("name", $.identifier),
+        seq(field("alias", $.identifier), "=", field("name", $.identifier)),
+      ),
 
     //
     // Mixin Declaration
@@ -549,26 +514,40 @@ module.exports = grammar({
       seq(
         repeat($._attribute),
         repeat($.storage_class),
-        $.type,
-        commaSep1(choice($.declarator, $.bitfield_declarator)),
+        field("type", $.type),
+        commaSep1(
+          field("declarator", choice($.declarator, $.bitfield_declarator)),
+        ),
         ";",
       ),
 
-    _declarator_identifier_list: ($) => prec.right(commaSep1($.identifier)),
+    _declarator_identifier_list: ($) =>
+      prec.right(commaSep1(field("name", $.identifier))),
 
     declarator: ($) =>
       prec.right(
         seq(
-          $.identifier,
-          optional(seq(optional($.template_parameters), "=", $._initializer)),
+          field("name", $.identifier),
+          optional(
+            seq(
+              optional(field("template_parameters", $.template_parameters)),
+              "=",
+              field("value", $._initializer),
+            ),
+          ),
         ),
       ),
 
     bitfield_declarator: ($) =>
       prec.right(
         choice(
-          seq(":", $._expr),
-          seq($.identifier, ":", $._expr, optional(seq("=", $._initializer))),
+          seq(":", field("width", $._expr)),
+          seq(
+            field("name", $.identifier),
+            ":",
+            field("width", $._expr),
+            optional(seq("=", field("value", $._initializer))),
+          ),
         ),
       ),
 
@@ -578,15 +557,20 @@ module.exports = grammar({
         repeat($.storage_class),
         $.enum,
         repeat($.storage_class),
-        optional($.type),
-        commaSep1($.manifest_declarator),
+        optional(field("type", $.type)),
+        commaSep1(field("declarator", $.manifest_declarator)),
         ";",
       ),
 
     manifest_declarator: ($) =>
       choice(
-        seq($.identifier, "=", $._initializer),
-        seq($.identifier, $.template_parameters, "=", $._initializer),
+        seq(field("name", $.identifier), "=", field("value", $._initializer)),
+        seq(
+          field("name", $.identifier),
+          field("template_parameters", $.template_parameters),
+          "=",
+          field("value", $._initializer),
+        ),
       ),
 
     //
@@ -635,7 +619,7 @@ module.exports = grammar({
     _auto_assignment: ($) =>
       seq(
         field("variable", $.identifier),
-        optional($.template_parameters),
+        optional(field("template_parameters", $.template_parameters)),
         "=",
         field("value", $._initializer),
       ),
@@ -652,17 +636,17 @@ module.exports = grammar({
           seq(
             $.alias,
             repeat($.storage_class),
-            $.type,
+            field("type", $.type),
             $._declarator_identifier_list,
             ";",
           ),
           seq(
             $.alias,
             repeat($.storage_class),
-            $.type,
-            $.identifier,
-            optional($.template_parameters),
-            $.parameters,
+            field("type", $.type),
+            field("name", $.identifier),
+            optional(field("template_parameters", $.template_parameters)),
+            field("parameters", $.parameters),
             repeat($.member_function_attribute),
             ";",
           ),
@@ -672,26 +656,26 @@ module.exports = grammar({
     alias_initializer: ($) =>
       choice(
         seq(
-          $.identifier,
-          optional($.template_parameters),
+          field("name", $.identifier),
+          optional(field("template_parameters", $.template_parameters)),
           "=",
           repeat($.storage_class),
-          $.type,
+          field("value", $.type),
         ),
         seq(
-          $.identifier,
-          optional($.template_parameters),
+          field("name", $.identifier),
+          optional(field("template_parameters", $.template_parameters)),
           "=",
           repeat($.storage_class),
-          $.function_literal,
+          field("value", $.function_literal),
         ),
         seq(
-          $.identifier,
-          optional($.template_parameters),
+          field("name", $.identifier),
+          optional(field("template_parameters", $.template_parameters)),
           "=",
           repeat($.storage_class),
-          $.type,
-          $.parameters,
+          field("value", $.type),
+          field("parameters", $.parameters),
           repeat($.member_function_attribute),
         ),
       ),
@@ -699,7 +683,8 @@ module.exports = grammar({
     //
     // Alias Assign (type alias)
     //
-    alias_assign: ($) => seq($.identifier, "=", $.type),
+    alias_assign: ($) =>
+      seq(field("name", $.identifier), "=", field("value", $.type)),
 
     //
     // Alias Reassignment (only in template declarations)
@@ -997,10 +982,25 @@ module.exports = grammar({
     call_expression: ($) =>
       prec.left(
         choice(
-          seq($._unary_expr, $.named_arguments),
-          prec(2, seq($._builtin_type, $.named_arguments)),
-          prec(1, seq($.identifier, $.named_arguments)),
-          seq($.type, $.named_arguments),
+          seq(
+            field("function", $._unary_expr),
+            field("arguments", $.named_arguments),
+          ),
+          prec(
+            2,
+            seq(
+              field("function", $._builtin_type),
+              field("arguments", $.named_arguments),
+            ),
+          ),
+          prec(
+            1,
+            seq(
+              field("function", $.identifier),
+              field("arguments", $.named_arguments),
+            ),
+          ),
+          seq(field("function", $.type), field("arguments", $.named_arguments)),
         ),
       ),
 
@@ -1045,8 +1045,13 @@ module.exports = grammar({
     // and deleted the old index expression as it was redundant)
     index_expression: ($) =>
       choice(
-        seq($._unary_expr, "[", "]"),
-        seq($._unary_expr, "[", commaSep1Comma($.index), "]"),
+        seq(field("operand", $._unary_expr), "[", "]"),
+        seq(
+          field("operand", $._unary_expr),
+          "[",
+          commaSep1Comma(field("index", $.index)),
+          "]",
+        ),
       ),
 
     index: ($) => seq($.expression, optional(seq("..", $.expression))),
@@ -1163,9 +1168,27 @@ module.exports = grammar({
 
     property_expression: ($) =>
       choice(
-        seq("(", $.type, ")", ".", $._identifier_or_template_instance),
-        prec.left(seq($._unary_expr, ".", $._identifier_or_template_instance)),
-        prec.left(seq($._unary_expr, ".", $.new_expression)),
+        seq(
+          "(",
+          field("object", $.type),
+          ")",
+          ".",
+          field("property", $._identifier_or_template_instance),
+        ),
+        prec.left(
+          seq(
+            field("object", $._unary_expr),
+            ".",
+            field("property", $._identifier_or_template_instance),
+          ),
+        ),
+        prec.left(
+          seq(
+            field("object", $._unary_expr),
+            ".",
+            field("property", $.new_expression),
+          ),
+        ),
       ),
 
     cast_expression: ($) =>
@@ -1275,11 +1298,20 @@ module.exports = grammar({
         $.package,
       ),
 
+    // The _string_context external is never produced.  It is only there so
+    // that the scanner can tell when it is inside the body of a string,
+    // where it must not recognize nesting comments or directives.
     raw_string: ($) =>
       choice(
-        seq("`", token.immediate(prec(1, /[^`]*/)), token.immediate(/`[cdw]?/)),
+        seq(
+          "`",
+          optional($._string_context),
+          token.immediate(prec(1, /[^`]*/)),
+          token.immediate(/`[cdw]?/),
+        ),
         seq(
           'r"',
+          optional($._string_context),
           token.immediate(prec(1, /[^"]*/)),
           token.immediate(/"[cdw]?/),
         ),
@@ -1288,6 +1320,7 @@ module.exports = grammar({
     hex_string: ($) =>
       seq(
         'x"',
+        optional($._string_context),
         token.immediate(prec(1, /[0-9A-Fa-f\s]*/)),
         token.immediate(/"[cdw]?/),
       ),
@@ -1302,6 +1335,7 @@ module.exports = grammar({
             token.immediate(prec(1, /[^"\\]+/)),
             $.escape_sequence,
             $.htmlentity,
+            $._string_context,
           ),
         ),
         token.immediate(/"[cdw]?/),
@@ -1313,7 +1347,14 @@ module.exports = grammar({
     interpolated_raw_string: ($) =>
       seq(
         "i`",
-        repeat(choice(/[^`$]+/, /\$[^(`]/, $.interpolation_expression)),
+        repeat(
+          choice(
+            /[^`$]+/,
+            /\$[^(`]/,
+            $.interpolation_expression,
+            $._string_context,
+          ),
+        ),
         choice("`", "$`"), // tailing "$" special
       ),
 
@@ -1330,6 +1371,7 @@ module.exports = grammar({
             $.htmlentity,
             $.interpolated_escape,
             $.interpolation_expression,
+            $._string_context,
           ),
         ),
         choice('"', '$"'), // tailing "$" special
@@ -1352,6 +1394,7 @@ module.exports = grammar({
     string_literal: ($) =>
       choice(
         $._string,
+        $._long_string,
         $.raw_string,
         $.hex_string,
         $.quoted_string,
@@ -1361,6 +1404,10 @@ module.exports = grammar({
         $.interpolated_token_string,
       ),
 
+    // The scanner splits long delimited and heredoc strings into chunks,
+    // so that editing one of them does not require lexing all of it again.
+    _long_string: ($) => seq(repeat1($._string_chunk), $._string),
+
     char_literal: ($) =>
       choice(
         /'[^\\']'/,
@@ -1518,7 +1565,7 @@ module.exports = grammar({
       prec.right(
         seq(
           $.if,
-          $.if_condition,
+          field("condition", $.if_condition),
           $.consequence,
           optional(seq($.else, $.alternative)),
         ),
@@ -1537,7 +1584,8 @@ module.exports = grammar({
         ")",
       ),
 
-    while_statement: ($) => seq($.while, $.if_condition, $.body),
+    while_statement: ($) =>
+      seq($.while, field("condition", $.if_condition), $.body),
 
     do_statement: ($) =>
       seq($.do, $.body, $.while, "(", field("condition", $.expression), ")"),
@@ -1576,20 +1624,20 @@ module.exports = grammar({
         seq(
           $._foreach,
           "(",
-          commaSep1($.foreach_type),
+          commaSep1(field("variable", $.foreach_type)),
           ";",
-          $.expression,
+          field("aggregate", $.expression),
           ")",
           $.body,
         ),
         seq(
           $._foreach,
           "(",
-          $.foreach_type,
+          field("variable", $.foreach_type),
           ";",
-          $.expression,
+          field("low", $.expression),
           "..",
-          $.expression,
+          field("high", $.expression),
           ")",
           $.body,
         ),
@@ -1598,15 +1646,16 @@ module.exports = grammar({
     foreach_type: ($) =>
       seq(
         repeat(choice($.ref, $.alias, $.enum, $.scope, $.type_ctor)),
-        optional($.type),
-        $.identifier,
+        optional(field("type", $.type)),
+        field("name", $.identifier),
       ),
 
     //
     // Switch Statement
     //
 
-    switch_statement: ($) => seq($.switch, "(", $.expression, ")", $.body),
+    switch_statement: ($) =>
+      seq($.switch, "(", field("condition", $.expression), ")", $.body),
 
     case_statement: ($) =>
       prec.right(
@@ -1642,7 +1691,8 @@ module.exports = grammar({
 
     break_statement: ($) => seq($.break, optional($.identifier), ";"),
 
-    return_statement: ($) => seq($.return, optional($.expression), ";"),
+    return_statement: ($) =>
+      seq($.return, optional(field("value", $.expression)), ";"),
 
     goto_statement: ($) =>
       choice(
@@ -1700,7 +1750,10 @@ module.exports = grammar({
         "}",
       ),
 
-    asm_inline: ($) => repeat1($._token_no_braces),
+    // The scanner normally lexes the whole body as one opaque token.
+    // The token stream form is only used when the scanner is built
+    // with TREE_SITTER_D_DETAILED_ASM.
+    asm_inline: ($) => choice($._asm_body, repeat1($._token_no_braces)),
 
     //
     // Mixin Statement
@@ -1717,22 +1770,26 @@ module.exports = grammar({
       seq(
         repeat($._attribute),
         choice(
-          seq($.struct, $.aggregate_body), // anonymous struct
-          seq($.struct, $.identifier, ";"),
-          seq($.struct, $.identifier, $.aggregate_body),
+          seq($.struct, field("body", $.aggregate_body)), // anonymous struct
+          seq($.struct, field("name", $.identifier), ";"),
           seq(
             $.struct,
-            $.identifier,
-            $.template_parameters,
-            optional($.constraint),
+            field("name", $.identifier),
+            field("body", $.aggregate_body),
+          ),
+          seq(
+            $.struct,
+            field("name", $.identifier),
+            field("template_parameters", $.template_parameters),
+            optional(field("constraint", $.constraint)),
             ";",
           ),
           seq(
             $.struct,
-            $.identifier,
-            $.template_parameters,
-            optional($.constraint),
-            $.aggregate_body,
+            field("name", $.identifier),
+            field("template_parameters", $.template_parameters),
+            optional(field("constraint", $.constraint)),
+            field("body", $.aggregate_body),
           ),
         ),
       ),
@@ -1743,22 +1800,26 @@ module.exports = grammar({
       seq(
         repeat($._attribute),
         choice(
-          seq($.union, $.aggregate_body), // anonymous union
-          seq($.union, $.identifier, ";"),
-          seq($.union, $.identifier, $.aggregate_body),
+          seq($.union, field("body", $.aggregate_body)), // anonymous union
+          seq($.union, field("name", $.identifier), ";"),
+          seq(
+            $.union,
+            field("name", $.identifier),
+            field("body", $.aggregate_body),
+          ),
           seq(
             $.union,
-            $.identifier,
-            $.template_parameters,
-            optional($.constraint),
+            field("name", $.identifier),
+            field("template_parameters", $.template_parameters),
+            optional(field("constraint", $.constraint)),
             ";",
           ),
           seq(
             $.union,
-            $.identifier,
-            $.template_parameters,
-            optional($.constraint),
-            $.aggregate_body,
+            field("name", $.identifier),
+            field("template_parameters", $.template_parameters),
+            optional(field("constraint", $.constraint)),
+            field("body", $.aggregate_body),
           ),
         ),
       ),
@@ -1791,7 +1852,7 @@ module.exports = grammar({
         $.this,
         ")",
         repeat($.member_function_attribute),
-        $.function_body,
+        field("body", $.function_body),
       ),
 
     //
@@ -1817,39 +1878,54 @@ module.exports = grammar({
       seq(
         repeat($._attribute),
         choice(
-          seq($.class, $.identifier, optional($.template_parameters), ";"),
-          seq($.class, $.identifier, $.aggregate_body),
-          seq($.class, $.identifier, ":", $._base_class_list, $.aggregate_body),
           seq(
             $.class,
-            $.identifier,
-            $.template_parameters,
-            optional($.constraint),
-            $.aggregate_body,
+            field("name", $.identifier),
+            optional(field("template_parameters", $.template_parameters)),
+            ";",
+          ),
+          seq(
+            $.class,
+            field("name", $.identifier),
+            field("body", $.aggregate_body),
           ),
           seq(
             $.class,
-            $.identifier,
-            $.template_parameters,
-            optional($.constraint),
+            field("name", $.identifier),
             ":",
             $._base_class_list,
-            optional($.constraint),
-            $.aggregate_body,
+            field("body", $.aggregate_body),
+          ),
+          seq(
+            $.class,
+            field("name", $.identifier),
+            field("template_parameters", $.template_parameters),
+            optional(field("constraint", $.constraint)),
+            field("body", $.aggregate_body),
           ),
           seq(
             $.class,
-            $.identifier,
-            $.template_parameters,
+            field("name", $.identifier),
+            field("template_parameters", $.template_parameters),
+            optional(field("constraint", $.constraint)),
             ":",
             $._base_class_list,
-            $.constraint,
-            $.aggregate_body,
+            optional(field("constraint", $.constraint)),
+            field("body", $.aggregate_body),
+          ),
+          seq(
+            $.class,
+            field("name", $.identifier),
+            field("template_parameters", $.template_parameters),
+            ":",
+            $._base_class_list,
+            field("constraint", $.constraint),
+            field("body", $.aggregate_body),
           ),
         ),
       ),
 
-    _base_class_list: ($) => commaSep1($.base_class),
+    _base_class_list: ($) => commaSep1(field("base", $.base_class)),
     base_class: ($) => $._type2,
 
     // Invariant was listed in 3.9 above already.
@@ -1864,17 +1940,17 @@ module.exports = grammar({
         choice(
           seq(
             $.this,
-            $.parameters,
+            field("parameters", $.parameters),
             repeat($.member_function_attribute),
-            $.function_body,
+            field("body", $.function_body),
           ),
           seq(
             $.this,
-            $.template_parameters,
-            $.parameters,
+            field("template_parameters", $.template_parameters),
+            field("parameters", $.parameters),
             repeat($.member_function_attribute),
-            optional($.constraint),
-            $.function_body,
+            optional(field("constraint", $.constraint)),
+            field("body", $.function_body),
           ),
           seq(
             optional($.shared),
@@ -1883,7 +1959,7 @@ module.exports = grammar({
             "(",
             ")",
             repeat($.member_function_attribute),
-            $.function_body,
+            field("body", $.function_body),
           ),
         ),
       ),
@@ -1897,7 +1973,7 @@ module.exports = grammar({
         "(",
         ")",
         repeat($.member_function_attribute),
-        $.function_body,
+        field("body", $.function_body),
       ),
 
     //
@@ -1916,53 +1992,57 @@ module.exports = grammar({
       seq(
         repeat($._attribute),
         choice(
-          seq($.interface, $.identifier, ";"),
-          seq($.interface, $.identifier, $.aggregate_body),
+          seq($.interface, field("name", $.identifier), ";"),
+          seq(
+            $.interface,
+            field("name", $.identifier),
+            field("body", $.aggregate_body),
+          ),
           seq(
             $.interface,
-            $.identifier,
+            field("name", $.identifier),
             ":",
             $._base_class_list,
-            $.aggregate_body,
+            field("body", $.aggregate_body),
           ),
           seq(
             $.interface,
-            $.identifier,
-            $.template_parameters,
-            $.aggregate_body,
+            field("name", $.identifier),
+            field("template_parameters", $.template_parameters),
+            field("body", $.aggregate_body),
           ),
           seq(
             $.interface,
-            $.identifier,
-            $.template_parameters,
+            field("name", $.identifier),
+            field("template_parameters", $.template_parameters),
             ":",
             $._base_class_list,
-            $.aggregate_body,
+            field("body", $.aggregate_body),
           ),
           seq(
             $.interface,
-            $.identifier,
-            $.template_parameters,
+            field("name", $.identifier),
+            field("template_parameters", $.template_parameters),
             ":",
             $._base_class_list,
-            $.constraint,
-            $.aggregate_body,
+            field("constraint", $.constraint),
+            field("body", $.aggregate_body),
           ),
           seq(
             $.interface,
-            $.identifier,
-            $.template_parameters,
-            $.constraint,
-            $.aggregate_body,
+            field("name", $.identifier),
+            field("template_parameters", $.template_parameters),
+            field("constraint", $.constraint),
+            field("body", $.aggregate_body),
           ),
           seq(
             $.interface,
-            $.identifier,
-            $.template_parameters,
-            $.constraint,
+            field("name", $.identifier),
+            field("template_parameters", $.template_parameters),
+            field("constraint", $.constraint),
             ":",
             $._base_class_list,
-            $.aggregate_body,
+            field("body", $.aggregate_body),
           ),
         ),
       ),
@@ -1977,14 +2057,27 @@ module.exports = grammar({
       seq(
         repeat($._attribute),
         choice(
-          seq($.enum, $.identifier, ";"),
-          seq($.enum, $.identifier, $._enum_body),
-          seq($.enum, $.identifier, ":", $.type, ";"),
-          seq($.enum, $.identifier, ":", $.type, $._enum_body),
+          seq($.enum, field("name", $.identifier), ";"),
+          seq($.enum, field("name", $.identifier), $._enum_body),
+          seq(
+            $.enum,
+            field("name", $.identifier),
+            ":",
+            field("type", $.type),
+            ";",
+          ),
+          seq(
+            $.enum,
+            field("name", $.identifier),
+            ":",
+            field("type", $.type),
+            $._enum_body,
+          ),
         ),
       ),
 
-    _enum_body: ($) => seq("{", commaSep1Comma($.enum_member), "}"),
+    _enum_body: ($) =>
+      seq("{", commaSep1Comma(field("member", $.enum_member)), "}"),
 
     _enum_member_attribute: ($) =>
       choice($.deprecated_attribute, $.at_attribute),
@@ -1992,21 +2085,29 @@ module.exports = grammar({
     enum_member: ($) =>
       seq(
         repeat($._enum_member_attribute),
-        $.identifier,
-        optional(seq("=", $._expr)),
+        field("name", $.identifier),
+        optional(seq("=", field("value", $._expr))),
       ),
 
     anonymous_enum_declaration: ($) =>
       seq(
         repeat($._attribute),
         $.enum,
-        optional(seq(":", $.type)),
+        optional(seq(":", field("type", $.type))),
         "{",
-        commaSep1Comma(choice($.anonymous_enum_member, $.enum_member)),
+        commaSep1Comma(
+          field("member", choice($.anonymous_enum_member, $.enum_member)),
+        ),
         "}",
       ),
 
-    anonymous_enum_member: ($) => seq($.type, $.identifier, "=", $._expr),
+    anonymous_enum_member: ($) =>
+      seq(
+        field("type", $.type),
+        field("name", $.identifier),
+        "=",
+        field("value", $._expr),
+      ),
 
     /**************************************************
      *
@@ -2020,36 +2121,36 @@ module.exports = grammar({
         prec.right(
           choice(
             seq(
-              $.type,
-              $.identifier,
-              $.parameters,
+              field("type", $.type),
+              field("name", $.identifier),
+              field("parameters", $.parameters),
               repeat($.member_function_attribute),
-              $.function_body,
+              field("body", $.function_body),
             ),
             seq(
-              $.type,
-              $.identifier,
-              $.template_parameters,
-              $.parameters,
+              field("type", $.type),
+              field("name", $.identifier),
+              field("template_parameters", $.template_parameters),
+              field("parameters", $.parameters),
               repeat($.member_function_attribute),
-              optional($.constraint),
-              $.function_body,
+              optional(field("constraint", $.constraint)),
+              field("body", $.function_body),
             ),
             seq(
               repeat1($.storage_class),
-              $.identifier,
-              $.parameters,
+              field("name", $.identifier),
+              field("parameters", $.parameters),
               repeat($.member_function_attribute),
-              $.function_body,
+              field("body", $.function_body),
             ),
             seq(
               repeat1($.storage_class),
-              $.identifier,
-              $.template_parameters,
-              $.parameters,
+              field("name", $.identifier),
+              field("template_parameters", $.template_parameters),
+              field("parameters", $.parameters),
               repeat($.member_function_attribute),
-              optional($.constraint),
-              $.function_body,
+              optional(field("constraint", $.constraint)),
+              field("body", $.function_body),
             ),
           ),
         ),
@@ -2101,23 +2202,32 @@ module.exports = grammar({
     _parameter: ($) =>
       prec.right(
         choice(
-          seq(repeat($.parameter_attribute), $.type),
-          seq(repeat($.parameter_attribute), $.type, $.ellipses),
+          seq(repeat($.parameter_attribute), field("type", $.type)),
+          seq(repeat($.parameter_attribute), field("type", $.type), $.ellipses),
           seq(
             repeat($.parameter_attribute),
-            $.type,
+            field("type", $.type),
             "=",
-            $._expr,
+            field("default", $._expr),
             optional($.ellipses),
           ),
-          seq(repeat($.parameter_attribute), $.type, $.identifier),
-          seq(repeat($.parameter_attribute), $.type, $.identifier, $.ellipses),
           seq(
             repeat($.parameter_attribute),
-            $.type,
-            $.identifier,
+            field("type", $.type),
+            field("name", $.identifier),
+          ),
+          seq(
+            repeat($.parameter_attribute),
+            field("type", $.type),
+            field("name", $.identifier),
+            $.ellipses,
+          ),
+          seq(
+            repeat($.parameter_attribute),
+            field("type", $.type),
+            field("name", $.identifier),
             "=",
-            $._expr,
+            field("default", $._expr),
             optional($.ellipses),
           ),
         ),
@@ -2212,9 +2322,9 @@ module.exports = grammar({
       seq(
         repeat($._attribute),
         $.template,
-        $.identifier,
-        $.template_parameters,
-        optional($.constraint),
+        field("name", $.identifier),
+        field("template_parameters", $.template_parameters),
+        optional(field("constraint", $.constraint)),
         "{",
         repeat($._declaration),
         "}",
@@ -2224,7 +2334,12 @@ module.exports = grammar({
     // Template Instance
     //
     template_instance: ($) =>
-      prec.left(seq($.identifier, $.template_arguments)),
+      prec.left(
+        seq(
+          field("name", $.identifier),
+          field("arguments", $.template_arguments),
+        ),
+      ),
 
     template_arguments: ($) =>
       prec.right(
@@ -2507,7 +2622,7 @@ module.exports = grammar({
      *
      */
     unittest_declaration: ($) =>
-      seq(repeat($._attribute), $.unittest, $.block_statement),
+      seq(repeat($._attribute), $.unittest, field("body", $.block_statement)),
   },
 
   // It is unfortunate, but many constructs in D require look-ahead
@@ -2576,5 +2691,5 @@ function sep1(rule, delim) {
 }
 
 function binaryOp(left, op, right) {
-  return seq(left, field("operator", op), right);
+  return seq(field("left", left), field("operator", op), field("right", right));
 }
@@ -0,0 +1,356 @@
+/*
+ * Import graph of a D workspace.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// dimports prints the import graph of the D sources under the given
+// paths, one "module<TAB>import" line per edge, parsing the files on a
+// number of threads.  Only the module header of each file is parsed (see
+// imports.h), unless -F is given, or the header is partial, in which case
+// that file is parsed again in full.  With -c both are timed, and the
+// files whose header misses some of their top-level imports are listed.
+
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "imports.h"
+
+typedef struct {
+	char  *path;
+	char  *src;
+	size_t len;
+} file;
+
+static file  *files;
+static size_t nfiles;
+
+typedef struct {
+	atomic_size_t next;
+	bool          full;
+	d_imports    *results;
+	int           err;
+} pass;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec);
+}
+
+static char *
+read_file(const char *path, size_t *lenp)
+{
+	FILE  *f;
+	char  *buf;
+	long   sz;
+	size_t n;
+
+	if ((f = fopen(path, "rb")) == NULL) {
+		return (NULL);
+	}
+	if ((fseek(f, 0, SEEK_END) != 0) || ((sz = ftell(f)) < 0) ||
+	    (fseek(f, 0, SEEK_SET) != 0)) {
+		fclose(f);
+		return (NULL);
+	}
+	if ((buf = malloc((size_t) sz + 1)) == NULL) {
+		fclose(f);
+		return (NULL);
+	}
+	n = fread(buf, 1, (size_t) sz, f);
+	fclose(f);
+	buf[n] = 0;
+	*lenp  = n;
+	return (buf);
+}
+
+static bool
+is_source(const char *path)
+{
+	size_t n = strlen(path);
+	return (((n > 2) && (strcmp(path + n - 2, ".d") == 0)) ||
+	    ((n > 3) && (strcmp(path + n - 3, ".di") == 0)));
+}
+
+static int
+push_path(const char *path)
+{
+	file *nf;
+
+	if ((nf = realloc(files, (nfiles + 1) * sizeof(file))) == NULL) {
+		return (ENOMEM);
+	}
+	files = nf;
+	memset(&files[nfiles], 0, sizeof(file));
+	if ((files[nfiles].path = strdup(path)) == NULL) {
+		return (ENOMEM);
+	}
+	nfiles++;
+	return (0);
+}
+
+static int
+walk_path(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+	(void) st;
+	(void) ftw;
+	if ((type != FTW_F) || !is_source(path)) {
+		return (0);
+	}
+	return (push_path(path));
+}
+
+static int
+cmp_file(const void *a, const void *b)
+{
+	return (strcmp(((const file *) a)->path, ((const file *) b)->path));
+}
+
+static void *
+worker(void *arg)
+{
+	pass       *p = arg;
+	d_importer *imp;
+	size_t      i;
+
+	if ((imp = d_importer_new()) == NULL) {
+		p->err = ENOMEM;
+		return (NULL);
+	}
+	while ((i = atomic_fetch_add(&p->next, 1)) < nfiles) {
+		int rv = d_importer_run(imp, files[i].src, files[i].len,
+		    p->full, &p->results[i]);
+		if ((rv == 0) && p->results[i].partial) {
+			d_imports_free(&p->results[i]);
+			rv = d_importer_run(imp, files[i].src, files[i].len,
+			    true, &p->results[i]);
+		}
+		if (rv != 0) {
+			p->err = rv;
+			break;
+		}
+	}
+	d_importer_delete(imp);
+	return (NULL);
+}
+
+// run_pass finds the imports of every file, returning the elapsed time,
+// or 0 on failure.
+static uint64_t
+run_pass(int nthreads, bool full, d_imports *results)
+{
+	pthread_t *threads;
+	pass       p;
+	uint64_t   start;
+	int        started = 0;
+
+	memset(&p, 0, sizeof(p));
+	atomic_init(&p.next, 0);
+	p.full    = full;
+	p.results = results;
+	if ((threads = calloc((size_t) nthreads, sizeof(pthread_t))) == NULL) {
+		return (0);
+	}
+	start = now_ns();
+	for (int i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, worker, &p) != 0) {
+			break;
+		}
+		started++;
+	}
+	for (int i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	free(threads);
+	if ((started == 0) || (p.err != 0)) {
+		return (0);
+	}
+	return (now_ns() - start);
+}
+
+static void
+report(const char *what, int nthreads, uint64_t ns, const d_imports *results)
+{
+	uint64_t n = 0;
+	for (size_t i = 0; i < nfiles; i++) {
+		n += results[i].parsed;
+	}
+	fprintf(stderr, "%zu files, %d threads, %s: %.1f ms, %.1f MB parsed\n",
+	    nfiles, nthreads, what, (double) ns / 1e6, (double) n / 1e6);
+}
+
+static bool
+same_imports(const d_imports *a, const d_imports *b)
+{
+	if (a->nimports != b->nimports) {
+		return (false);
+	}
+	for (size_t i = 0; i < a->nimports; i++) {
+		if (strcmp(a->imports[i], b->imports[i]) != 0) {
+			return (false);
+		}
+	}
+	return (true);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+	    "usage: dimports [-j threads] [-F | -c] [-o graph] path ...\n");
+	exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *outfile  = NULL;
+	bool        full     = false;
+	bool        compare  = false;
+	int         nthreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	d_imports  *results;
+	d_imports  *other = NULL;
+	uint64_t    elapsed;
+	FILE       *out = stdout;
+	int         opt;
+
+	while ((opt = getopt(argc, argv, "j:Fco:")) != -1) {
+		switch (opt) {
+		case 'j':
+			if ((nthreads = atoi(optarg)) < 1) {
+				usage();
+			}
+			break;
+		case 'F':
+			full = true;
+			break;
+		case 'c':
+			compare = true;
+			break;
+		case 'o':
+			outfile = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if ((optind == argc) || (full && compare)) {
+		usage();
+	}
+	if (nthreads < 1) {
+		nthreads = 1;
+	}
+
+	for (int i = optind; i < argc; i++) {
+		struct stat st;
+		int         rv;
+		// a file named explicitly is read whatever its suffix
+		if (stat(argv[i], &st) != 0) {
+			rv = errno;
+		} else if (S_ISDIR(st.st_mode)) {
+			rv = nftw(argv[i], walk_path, 16, FTW_PHYS);
+			rv = (rv < 0) ? errno : rv;
+		} else {
+			rv = push_path(argv[i]);
+		}
+		if (rv != 0) {
+			fprintf(stderr, "dimports: %s: %s\n", argv[i],
+			    strerror(rv));
+			return (1);
+		}
+	}
+	qsort(files, nfiles, sizeof(file), cmp_file);
+
+	// the sources are read up front, so that only parsing is timed
+	for (size_t i = 0; i < nfiles; i++) {
+		files[i].src = read_file(files[i].path, &files[i].len);
+		if (files[i].src == NULL) {
+			fprintf(stderr, "dimports: %s: %s\n", files[i].path,
+			    strerror(errno));
+			return (1);
+		}
+	}
+
+	if (((results = calloc(nfiles + 1, sizeof(d_imports))) == NULL) ||
+	    ((elapsed = run_pass(nthreads, full, results)) == 0)) {
+		fprintf(stderr, "dimports: cannot parse\n");
+		return (1);
+	}
+
+	if ((outfile != NULL) && ((out = fopen(outfile, "w")) == NULL)) {
+		fprintf(stderr, "dimports: %s: %s\n", outfile,
+		    strerror(errno));
+		return (1);
+	}
+	for (size_t i = 0; i < nfiles; i++) {
+		const d_imports *r = &results[i];
+		for (size_t j = 0; j < r->nimports; j++) {
+			fprintf(out, "%s\t%s\n",
+			    r->module ? r->module : files[i].path,
+			    r->imports[j]);
+		}
+	}
+	if (out != stdout) {
+		fclose(out);
+	}
+
+	report(full ? "full" : "header", nthreads, elapsed, results);
+
+	if (compare) {
+		uint64_t full_ns;
+		size_t   missed = 0;
+		other = calloc(nfiles + 1, sizeof(d_imports));
+		if ((other == NULL) ||
+		    ((full_ns = run_pass(nthreads, true, other)) == 0)) {
+			fprintf(stderr, "dimports: cannot parse\n");
+			return (1);
+		}
+		report("full", nthreads, full_ns, other);
+		fprintf(stderr, "speedup %.2fx\n",
+		    (double) full_ns / (double) elapsed);
+		for (size_t i = 0; i < nfiles; i++) {
+			if (!same_imports(&results[i], &other[i])) {
+				fprintf(stderr,
+				    "%s: imports after the module header\n",
+				    files[i].path);
+				missed++;
+			}
+		}
+		fprintf(stderr, "%zu files with imports after the header\n",
+		    missed);
+	}
+
+	for (size_t i = 0; i < nfiles; i++) {
+		d_imports_free(&results[i]);
+		if (other != NULL) {
+			d_imports_free(&other[i]);
+		}
+		free(files[i].src);
+		free(files[i].path);
+	}
+	free(results);
+	free(other);
+	free(files);
+	return (0);
+}
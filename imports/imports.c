@@ -0,0 +1,552 @@
+/*
+ * Module header (module and import declaration) extraction.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// A build only needs the module header of each file, which is usually a
+// small part of it.  The header is found with a scan of the tokens that
+// knows just enough of D to recognize the attributes and declarations
+// that may appear in it; only that prefix is then parsed, so that the
+// names are those the grammar sees.  Anything the scan does not
+// recognize ends the header, so it can stop early, but never late.
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tree_sitter/api.h>
+
+#include "imports.h"
+#include "tree-sitter-d.h"
+
+enum tok {
+	T_EOF,
+	T_IDENT,
+	T_AT,
+	T_BANG,
+	T_LPAREN,
+	T_RPAREN,
+	T_COLON,
+	T_SEMI,
+	T_LBRACE,
+	T_OTHER,
+};
+
+typedef struct {
+	const char *s;
+	size_t      n;
+	size_t      i;
+	size_t      start; // of the last token
+	size_t      len;
+} lexer;
+
+// attributes that may precede a module or import declaration, or make
+// up an attribute declaration; those marked may have an argument list
+static const struct {
+	const char *name;
+	bool        args;
+} attrs[] = {
+	{ "abstract", false },
+	{ "align", true },
+	{ "auto", false },
+	{ "const", false },
+	{ "deprecated", true },
+	{ "export", false },
+	{ "extern", true },
+	{ "final", false },
+	{ "__gshared", false },
+	{ "immutable", false },
+	{ "inout", false },
+	{ "nothrow", false },
+	{ "override", false },
+	{ "package", true },
+	{ "pragma", true },
+	{ "private", false },
+	{ "protected", false },
+	{ "public", false },
+	{ "pure", false },
+	{ "ref", false },
+	{ "return", false },
+	{ "scope", false },
+	{ "shared", false },
+	{ "static", false },
+	{ "synchronized", false },
+};
+
+static bool
+is_ident_char(char c)
+{
+	return (isalnum((unsigned char) c) || (c == '_') ||
+	    ((unsigned char) c >= 0x80));
+}
+
+// skip_space skips whitespace and comments, including nested ones.
+static void
+skip_space(lexer *l)
+{
+	while (l->i < l->n) {
+		const char *s = l->s;
+		if (isspace((unsigned char) s[l->i])) {
+			l->i++;
+		} else if ((s[l->i] == '/') && (l->i + 1 < l->n) &&
+		    (s[l->i + 1] == '/')) {
+			while ((l->i < l->n) && (s[l->i] != '\n')) {
+				l->i++;
+			}
+		} else if ((s[l->i] == '/') && (l->i + 1 < l->n) &&
+		    (s[l->i + 1] == '*')) {
+			l->i += 2;
+			while ((l->i + 1 < l->n) &&
+			    !((s[l->i] == '*') && (s[l->i + 1] == '/'))) {
+				l->i++;
+			}
+			l->i = (l->i + 2 < l->n) ? l->i + 2 : l->n;
+		} else if ((s[l->i] == '/') && (l->i + 1 < l->n) &&
+		    (s[l->i + 1] == '+')) {
+			int depth = 1;
+			l->i += 2;
+			while ((l->i + 1 < l->n) && (depth > 0)) {
+				if ((s[l->i] == '/') && (s[l->i + 1] == '+')) {
+					depth++;
+					l->i += 2;
+				} else if ((s[l->i] == '+') &&
+				    (s[l->i + 1] == '/')) {
+					depth--;
+					l->i += 2;
+				} else {
+					l->i++;
+				}
+			}
+			if (depth > 0) {
+				l->i = l->n;
+			}
+		} else {
+			return;
+		}
+	}
+}
+
+// skip_quoted skips a string or character literal, from the quote.
+static void
+skip_quoted(lexer *l, bool escapes)
+{
+	char q = l->s[l->i++];
+	while (l->i < l->n) {
+		char c = l->s[l->i++];
+		if (c == q) {
+			return;
+		}
+		if (escapes && (c == '\\') && (l->i < l->n)) {
+			l->i++;
+		}
+	}
+}
+
+static enum tok
+next(lexer *l)
+{
+	char c;
+
+	skip_space(l);
+	l->start = l->i;
+	if (l->i >= l->n) {
+		l->len = 0;
+		return (T_EOF);
+	}
+	c = l->s[l->i];
+	if ((c == 'r') && (l->i + 1 < l->n) && (l->s[l->i + 1] == '"')) {
+		l->i++;
+		skip_quoted(l, false);
+		l->len = l->i - l->start;
+		return (T_OTHER);
+	}
+	if (is_ident_char(c) && !isdigit((unsigned char) c)) {
+		while ((l->i < l->n) && is_ident_char(l->s[l->i])) {
+			l->i++;
+		}
+		l->len = l->i - l->start;
+		return (T_IDENT);
+	}
+	if ((c == '"') || (c == '\'') || (c == '`')) {
+		skip_quoted(l, c != '`');
+		l->len = l->i - l->start;
+		return (T_OTHER);
+	}
+	l->i++;
+	l->len = 1;
+	switch (c) {
+	case '@':
+		return (T_AT);
+	case '!':
+		return (T_BANG);
+	case '(':
+		return (T_LPAREN);
+	case ')':
+		return (T_RPAREN);
+	case ':':
+		return (T_COLON);
+	case ';':
+		return (T_SEMI);
+	case '{':
+		return (T_LBRACE);
+	default:
+		return (T_OTHER);
+	}
+}
+
+static bool
+ident_is(const lexer *l, const char *word)
+{
+	return ((strlen(word) == l->len) &&
+	    (memcmp(l->s + l->start, word, l->len) == 0));
+}
+
+// skip_parens skips a balanced argument list, after its '('.
+static bool
+skip_parens(lexer *l)
+{
+	int depth = 1;
+	while (depth > 0) {
+		switch (next(l)) {
+		case T_EOF:
+			return (false);
+		case T_LPAREN:
+			depth++;
+			break;
+		case T_RPAREN:
+			depth--;
+			break;
+		default:
+			break;
+		}
+	}
+	return (true);
+}
+
+// optional_parens skips an argument list if one is next.
+static bool
+optional_parens(lexer *l)
+{
+	size_t save = l->i;
+	if (next(l) == T_LPAREN) {
+		return (skip_parens(l));
+	}
+	l->i = save;
+	return (true);
+}
+
+// attribute consumes the rest of an attribute whose first token has been
+// read, returning false if it is not one.
+static bool
+attribute(lexer *l, enum tok t)
+{
+	size_t save;
+
+	if (t == T_AT) {
+		switch (next(l)) {
+		case T_LPAREN:
+			return (skip_parens(l));
+		case T_IDENT:
+			break;
+		default:
+			return (false);
+		}
+		// @foo!bar or @foo!(bar), then perhaps arguments
+		save = l->i;
+		if (next(l) == T_BANG) {
+			enum tok a = next(l);
+			if ((a == T_LPAREN) && !skip_parens(l)) {
+				return (false);
+			}
+		} else {
+			l->i = save;
+		}
+		return (optional_parens(l));
+	}
+	if (t != T_IDENT) {
+		return (false);
+	}
+	for (size_t i = 0; i < sizeof(attrs) / sizeof(attrs[0]); i++) {
+		if (ident_is(l, attrs[i].name)) {
+			return (attrs[i].args ? optional_parens(l) : true);
+		}
+	}
+	return (false);
+}
+
+// may_import returns true if the declaration that ends the header, whose
+// first token after any attributes has been read, may itself hold
+// imports.  "static" is an attribute to the scan, so "static if" is seen
+// as an attributed "if".
+static bool
+may_import(const lexer *l, enum tok t, bool attributed)
+{
+	if (t == T_LBRACE) {
+		return (attributed);
+	}
+	if (t != T_IDENT) {
+		return (false);
+	}
+	return (ident_is(l, "version") || ident_is(l, "debug") ||
+	    ident_is(l, "mixin") ||
+	    (attributed && (ident_is(l, "if") || ident_is(l, "foreach"))));
+}
+
+size_t
+d_imports_header_len(const char *src, size_t len, bool *partial)
+{
+	lexer  l   = { .s = src, .n = len };
+	size_t end = 0;
+
+	if (partial != NULL) {
+		*partial = false;
+	}
+	if ((len >= 2) && (src[0] == '#') && (src[1] == '!')) {
+		while ((l.i < len) && (src[l.i] != '\n')) {
+			l.i++;
+		}
+	}
+	for (;;) {
+		enum tok t          = next(&l);
+		bool     attributed = false;
+
+		while (attribute(&l, t)) {
+			attributed = true;
+			t          = next(&l);
+		}
+		if ((t == T_IDENT) &&
+		    (ident_is(&l, "module") || ident_is(&l, "import"))) {
+			// the declaration runs to its ';'
+			while ((t = next(&l)) != T_SEMI) {
+				if ((t == T_EOF) || (t == T_LBRACE)) {
+					return (end);
+				}
+				if ((t == T_LPAREN) && !skip_parens(&l)) {
+					return (end);
+				}
+			}
+		} else if ((t == T_COLON) && attributed) {
+			// an attribute declaration, such as "@safe:"
+		} else if ((t == T_SEMI) && !attributed) {
+			// an empty declaration
+		} else {
+			if (partial != NULL) {
+				*partial = may_import(&l, t, attributed);
+			}
+			return (end);
+		}
+		end = l.i;
+	}
+}
+
+// symbols used from the tree
+enum sym {
+	S_MODULE_DEF,
+	S_MODULE_DECLARATION,
+	S_MODULE_FQN,
+	S_IMPORT_DECLARATION,
+	S_IMPORTED,
+	S_COUNT,
+};
+
+static const char *sym_names[S_COUNT] = {
+	[S_MODULE_DEF]         = "module_def",
+	[S_MODULE_DECLARATION] = "module_declaration",
+	[S_MODULE_FQN]         = "module_fqn",
+	[S_IMPORT_DECLARATION] = "import_declaration",
+	[S_IMPORTED]           = "imported",
+};
+
+// fields used from the tree
+enum fld {
+	F_NAME,   // of a module_declaration
+	F_MODULE, // of an imported
+	F_COUNT,
+};
+
+static const char *field_names[F_COUNT] = {
+	[F_NAME]   = "name",
+	[F_MODULE] = "module",
+};
+
+struct d_importer {
+	TSParser *parser;
+	TSSymbol  syms[S_COUNT];
+	TSFieldId fields[F_COUNT];
+};
+
+d_importer *
+d_importer_new(void)
+{
+	d_importer *imp;
+
+	if ((imp = calloc(1, sizeof(*imp))) == NULL) {
+		return (NULL);
+	}
+	if (((imp->parser = ts_parser_new()) == NULL) ||
+	    !ts_parser_set_language(imp->parser, tree_sitter_d())) {
+		d_importer_delete(imp);
+		return (NULL);
+	}
+	for (int i = 0; i < S_COUNT; i++) {
+		imp->syms[i] = ts_language_symbol_for_name(tree_sitter_d(),
+		    sym_names[i], (uint32_t) strlen(sym_names[i]), true);
+		if (imp->syms[i] == 0) {
+			d_importer_delete(imp);
+			return (NULL);
+		}
+	}
+	for (int i = 0; i < F_COUNT; i++) {
+		imp->fields[i] = ts_language_field_id_for_name(tree_sitter_d(),
+		    field_names[i], (uint32_t) strlen(field_names[i]));
+		if (imp->fields[i] == 0) {
+			d_importer_delete(imp);
+			return (NULL);
+		}
+	}
+	return (imp);
+}
+
+void
+d_importer_delete(d_importer *imp)
+{
+	if (imp != NULL) {
+		if (imp->parser != NULL) {
+			ts_parser_delete(imp->parser);
+		}
+		free(imp);
+	}
+}
+
+// fqn_field returns the text of the module_fqn in a field of a node,
+// without whitespace, or NULL (setting *nomem if that is why).
+static char *
+fqn_field(const d_importer *imp, TSNode node, enum fld f, const char *src,
+    bool *nomem)
+{
+	TSNode   c = ts_node_child_by_field_id(node, imp->fields[f]);
+	uint32_t s, e;
+	char    *name;
+	size_t   k = 0;
+
+	if (ts_node_is_null(c) ||
+	    (ts_node_symbol(c) != imp->syms[S_MODULE_FQN])) {
+		return (NULL);
+	}
+	s = ts_node_start_byte(c);
+	e = ts_node_end_byte(c);
+	if ((name = malloc(e - s + 1)) == NULL) {
+		*nomem = true;
+		return (NULL);
+	}
+	for (uint32_t j = s; j < e; j++) {
+		if (!isspace((unsigned char) src[j])) {
+			name[k++] = src[j];
+		}
+	}
+	name[k] = 0;
+	return (name);
+}
+
+static bool
+add_import(d_imports *out, char *name)
+{
+	char **ni;
+
+	ni = realloc(out->imports, (out->nimports + 1) * sizeof(char *));
+	if (ni == NULL) {
+		free(name);
+		return (false);
+	}
+	out->imports                 = ni;
+	out->imports[out->nimports++] = name;
+	return (true);
+}
+
+// collect visits the declarations under a source_file or module_def.
+static bool
+collect(const d_importer *imp, TSNode parent, const char *src, d_imports *out)
+{
+	uint32_t n     = ts_node_named_child_count(parent);
+	bool     nomem = false;
+
+	for (uint32_t i = 0; i < n; i++) {
+		TSNode   c   = ts_node_named_child(parent, i);
+		TSSymbol sym = ts_node_symbol(c);
+		if (sym == imp->syms[S_MODULE_DEF]) {
+			if (!collect(imp, c, src, out)) {
+				return (false);
+			}
+		} else if ((sym == imp->syms[S_MODULE_DECLARATION]) &&
+		    (out->module == NULL)) {
+			out->module = fqn_field(imp, c, F_NAME, src, &nomem);
+		} else if (sym == imp->syms[S_IMPORT_DECLARATION]) {
+			uint32_t m = ts_node_named_child_count(c);
+			for (uint32_t j = 0; j < m; j++) {
+				TSNode   d = ts_node_named_child(c, j);
+				TSSymbol s = ts_node_symbol(d);
+				char    *name;
+				if (s != imp->syms[S_IMPORTED]) {
+					continue;
+				}
+				name = fqn_field(
+				    imp, d, F_MODULE, src, &nomem);
+				if ((name != NULL) && !add_import(out, name)) {
+					return (false);
+				}
+			}
+		}
+		if (nomem) {
+			return (false);
+		}
+	}
+	return (true);
+}
+
+int
+d_importer_run(d_importer *imp, const char *src, size_t len, bool full,
+    d_imports *out)
+{
+	TSTree *tree;
+	bool    ok;
+
+	memset(out, 0, sizeof(*out));
+	if (len > UINT32_MAX) {
+		len = UINT32_MAX;
+	}
+	if (!full) {
+		len = d_imports_header_len(src, len, &out->partial);
+	}
+	out->parsed = (uint32_t) len;
+	if (len == 0) {
+		return (0);
+	}
+	tree = ts_parser_parse_string(imp->parser, NULL, src, (uint32_t) len);
+	if (tree == NULL) {
+		return (ENOMEM);
+	}
+	ok = collect(imp, ts_tree_root_node(tree), src, out);
+	ts_tree_delete(tree);
+	if (!ok) {
+		d_imports_free(out);
+		return (ENOMEM);
+	}
+	return (0);
+}
+
+void
+d_imports_free(d_imports *imports)
+{
+	for (size_t i = 0; i < imports->nimports; i++) {
+		free(imports->imports[i]);
+	}
+	free(imports->imports);
+	free(imports->module);
+	memset(imports, 0, sizeof(*imports));
+}
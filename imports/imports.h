@@ -0,0 +1,60 @@
+/*
+ * Module header (module and import declaration) extraction.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef D_IMPORTS_H
+#define D_IMPORTS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The module header is the run of module, import, and attribute (such
+// as "@safe:") declarations at the start of a file.  The first other
+// declaration ends it; imports after that, including those in version
+// blocks and functions, are not part of the header.  When the header
+// ends on a declaration that may itself hold imports, namely a version,
+// debug, static if, static foreach or mixin declaration, or a block of
+// attributes, it is marked partial, and a caller that needs every import
+// should parse the whole file instead.
+
+typedef struct {
+	char    *module; // declared module name, or NULL
+	char   **imports;
+	size_t   nimports;
+	uint32_t parsed;  // bytes given to the parser
+	bool     partial; // header ended where imports may follow
+} d_imports;
+
+// d_imports_header_len returns the length of the module header, found
+// with a light scan of the tokens, without parsing.  Only that much of
+// the source needs to be parsed to find the module and its imports.  If
+// partial is not NULL, it is set to whether the header is partial.
+extern size_t d_imports_header_len(
+    const char *src, size_t len, bool *partial);
+
+typedef struct d_importer d_importer;
+
+// d_importer_new returns NULL if out of memory, or if the language is
+// missing the symbols needed.  An importer may be used by one thread at
+// a time.
+extern d_importer *d_importer_new(void);
+extern void        d_importer_delete(d_importer *imp);
+
+// d_importer_run finds the module name and the imports of a file.  If
+// full is false, only the module header is parsed, and out->partial says
+// whether that may have missed some imports.  If full is true, the
+// whole file is parsed, and all top-level imports are found, which
+// is useful for comparison.  It returns 0, or ENOMEM.
+extern int d_importer_run(d_importer *imp, const char *src, size_t len,
+    bool full, d_imports *out);
+
+extern void d_imports_free(d_imports *imports);
+
+#endif // D_IMPORTS_H
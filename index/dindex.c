@@ -0,0 +1,277 @@
+/*
+ * Symbol indexer for D workspaces.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// dindex keeps an index of the definitions and references in a tree of D
+// sources (see symindex.h).  Given paths, it updates the index, parsing
+// only the files whose content has changed since it was last written.
+// With -s or -m it answers a lookup from the mapped index instead, which
+// takes about the same time however large the workspace is.
+
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <ftw.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "symindex.h"
+#include "tree-sitter-d-tags.h"
+
+static char **paths;
+static size_t npaths;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec);
+}
+
+static char *
+read_file(const char *path, size_t *lenp)
+{
+	FILE  *f;
+	char  *buf;
+	long   sz;
+	size_t n;
+
+	if ((f = fopen(path, "rb")) == NULL) {
+		return (NULL);
+	}
+	if ((fseek(f, 0, SEEK_END) != 0) || ((sz = ftell(f)) < 0) ||
+	    (fseek(f, 0, SEEK_SET) != 0)) {
+		fclose(f);
+		return (NULL);
+	}
+	if ((buf = malloc((size_t) sz + 1)) == NULL) {
+		fclose(f);
+		return (NULL);
+	}
+	n = fread(buf, 1, (size_t) sz, f);
+	fclose(f);
+	buf[n] = 0;
+	*lenp  = n;
+	return (buf);
+}
+
+static bool
+is_source(const char *path)
+{
+	size_t n = strlen(path);
+	return (((n > 2) && (strcmp(path + n - 2, ".d") == 0)) ||
+	    ((n > 3) && (strcmp(path + n - 3, ".di") == 0)));
+}
+
+static int
+push_path(const char *path)
+{
+	char **np;
+
+	if ((np = realloc(paths, (npaths + 1) * sizeof(char *))) == NULL) {
+		return (ENOMEM);
+	}
+	paths = np;
+	if ((paths[npaths] = strdup(path)) == NULL) {
+		return (ENOMEM);
+	}
+	npaths++;
+	return (0);
+}
+
+static int
+walk_path(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+	(void) st;
+	(void) ftw;
+	if ((type != FTW_F) || !is_source(path)) {
+		return (0);
+	}
+	return (push_path(path));
+}
+
+static int
+cmp_path(const void *a, const void *b)
+{
+	return (strcmp(*(char *const *) a, *(char *const *) b));
+}
+
+static int
+update(const char *file, char **args, int nargs)
+{
+	symindex         *old = NULL;
+	symindex_builder *b;
+	size_t            reused = 0;
+	size_t            parsed = 0;
+	uint64_t          start  = now_ns();
+	int               rv;
+
+	for (int i = 0; i < nargs; i++) {
+		struct stat st;
+		// a file named explicitly is indexed whatever its suffix
+		if (stat(args[i], &st) != 0) {
+			rv = errno;
+		} else if (S_ISDIR(st.st_mode)) {
+			rv = nftw(args[i], walk_path, 16, FTW_PHYS);
+			rv = (rv < 0) ? errno : rv;
+		} else {
+			rv = push_path(args[i]);
+		}
+		if (rv != 0) {
+			fprintf(stderr, "dindex: %s: %s\n", args[i],
+			    strerror(rv));
+			return (1);
+		}
+	}
+	qsort(paths, npaths, sizeof(char *), cmp_path);
+
+	if ((rv = symindex_open(file, &old)) == EINVAL) {
+		fprintf(stderr, "dindex: %s: not usable, rebuilding\n", file);
+	} else if ((rv != 0) && (rv != ENOENT)) {
+		fprintf(stderr, "dindex: %s: %s\n", file, strerror(rv));
+		return (1);
+	}
+	if ((b = symindex_builder_new(old)) == NULL) {
+		fprintf(stderr, "dindex: cannot create parser\n");
+		return (1);
+	}
+	for (size_t i = 0; i < npaths; i++) {
+		char  *src;
+		size_t len;
+		if ((i > 0) && (strcmp(paths[i], paths[i - 1]) == 0)) {
+			continue;
+		}
+		if ((src = read_file(paths[i], &len)) == NULL) {
+			fprintf(stderr, "dindex: %s: %s\n", paths[i],
+			    strerror(errno));
+			continue;
+		}
+		switch (symindex_add(b, paths[i], src, len)) {
+		case 1:
+			reused++;
+			break;
+		case 0:
+			parsed++;
+			break;
+		default:
+			fprintf(stderr, "dindex: out of memory\n");
+			return (1);
+		}
+		free(src);
+	}
+	if ((rv = symindex_write(b, file)) != 0) {
+		fprintf(stderr, "dindex: %s: %s\n", file, strerror(rv));
+		return (1);
+	}
+	symindex_builder_free(b);
+	symindex_close(old);
+	printf("%zu files: %zu parsed, %zu unchanged, %.1f ms\n",
+	    reused + parsed, parsed, reused,
+	    (double) (now_ns() - start) / 1e6);
+	return (0);
+}
+
+static int
+lookup(const char *file, const char *name, bool module)
+{
+	symindex       *idx;
+	const uint32_t *ents;
+	size_t          n;
+	uint64_t        start;
+	uint64_t        elapsed;
+	int             rv;
+
+	start = now_ns();
+	if ((rv = symindex_open(file, &idx)) != 0) {
+		fprintf(stderr, "dindex: %s: %s\n", file, strerror(rv));
+		return (1);
+	}
+	if (module) {
+		ents = symindex_lookup_module(idx, name, &n);
+	} else {
+		ents = symindex_lookup(idx, name, &n);
+	}
+	elapsed = now_ns() - start;
+
+	for (size_t i = 0; i < n; i++) {
+		const symindex_sym  *s;
+		const symindex_file *f;
+		if (module) {
+			f = symindex_file_at(idx, ents[i]);
+			printf("%s\n", symindex_string(idx, f->path));
+			continue;
+		}
+		s = symindex_sym_at(idx, ents[i]);
+		f = symindex_file_at(idx, s->file);
+		printf("%s:%u:%u: %s\n",
+		    symindex_string(idx, f ? f->path : 0), s->row + 1,
+		    s->column + 1,
+		    ts_d_tag_kind_name((ts_d_tag_kind) s->kind));
+	}
+	fprintf(stderr, "%zu found in %.3f ms\n", n, (double) elapsed / 1e6);
+	symindex_close(idx);
+	return (n > 0 ? 0 : 1);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+	    "usage: dindex [-f index] path ...\n"
+	    "       dindex [-f index] -s symbol\n"
+	    "       dindex [-f index] -m module\n");
+	exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *file   = ".dindex";
+	const char *symbol = NULL;
+	const char *module = NULL;
+	int         opt;
+
+	while ((opt = getopt(argc, argv, "f:s:m:")) != -1) {
+		switch (opt) {
+		case 'f':
+			file = optarg;
+			break;
+		case 's':
+			symbol = optarg;
+			break;
+		case 'm':
+			module = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if ((symbol != NULL) && (module != NULL)) {
+		usage();
+	}
+	if ((symbol != NULL) || (module != NULL)) {
+		if (optind != argc) {
+			usage();
+		}
+		return (lookup(file, symbol ? symbol : module, !symbol));
+	}
+	if (optind == argc) {
+		usage();
+	}
+	return (update(file, argv + optind, argc - optind));
+}
@@ -0,0 +1,687 @@
+/*
+ * Persistent symbol index for D workspaces.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <tree_sitter/api.h>
+
+#include "symindex.h"
+#include "tree-sitter-d-tags.h"
+#include "tree-sitter-d.h"
+
+#ifndef SYMINDEX_GRAMMAR
+#define SYMINDEX_GRAMMAR "unknown"
+#endif
+
+struct symindex {
+	const uint8_t         *base;
+	size_t                 size;
+	const symindex_header *hdr;
+	const symindex_file   *files;
+	const symindex_sym    *syms;
+	const uint32_t        *names;
+	const uint32_t        *modules;
+	const char            *strings;
+};
+
+static uint64_t
+fnv1a(const char *s, size_t len)
+{
+	uint64_t h = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < len; i++) {
+		h ^= (uint8_t) s[i];
+		h *= 0x100000001b3ull;
+	}
+	return (h);
+}
+
+// section checks that an array of n elements at off lies within the file.
+static bool
+section(const symindex *idx, uint32_t off, uint32_t n, size_t sz)
+{
+	return ((off % 4 == 0) && (off <= idx->size) &&
+	    ((uint64_t) n * sz <= idx->size - off));
+}
+
+int
+symindex_open(const char *path, symindex **idxp)
+{
+	symindex              *idx;
+	const symindex_header *h;
+	struct stat            st;
+	void                  *base;
+	int                    fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		return (errno);
+	}
+	if (fstat(fd, &st) != 0) {
+		int rv = errno;
+		close(fd);
+		return (rv);
+	}
+	if ((size_t) st.st_size < sizeof(symindex_header)) {
+		close(fd);
+		return (EINVAL);
+	}
+	base = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		return (errno);
+	}
+	if ((idx = calloc(1, sizeof(*idx))) == NULL) {
+		munmap(base, (size_t) st.st_size);
+		return (ENOMEM);
+	}
+	idx->base = base;
+	idx->size = (size_t) st.st_size;
+	idx->hdr  = h = base;
+
+	// Only the header and the section bounds are checked here, so that
+	// opening costs the same for any size of index.  The accessors check
+	// the indices and offsets stored in the records.
+	if ((memcmp(h->magic, SYMINDEX_MAGIC, sizeof(h->magic)) != 0) ||
+	    (h->format != SYMINDEX_FORMAT) ||
+	    (h->endian != SYMINDEX_ENDIAN) ||
+	    !section(idx, h->files, h->nfiles, sizeof(symindex_file)) ||
+	    !section(idx, h->syms, h->nsyms, sizeof(symindex_sym)) ||
+	    !section(idx, h->names, h->nsyms, sizeof(uint32_t)) ||
+	    !section(idx, h->modules, h->nmodules, sizeof(uint32_t)) ||
+	    !section(idx, h->strings, h->strings_len, 1) ||
+	    (h->strings_len == 0) ||
+	    (idx->base[h->strings + h->strings_len - 1] != 0)) {
+		symindex_close(idx);
+		return (EINVAL);
+	}
+	idx->files   = (const void *) (idx->base + h->files);
+	idx->syms    = (const void *) (idx->base + h->syms);
+	idx->names   = (const void *) (idx->base + h->names);
+	idx->modules = (const void *) (idx->base + h->modules);
+	idx->strings = (const char *) (idx->base + h->strings);
+	*idxp        = idx;
+	return (0);
+}
+
+void
+symindex_close(symindex *idx)
+{
+	if (idx != NULL) {
+		munmap((void *) idx->base, idx->size);
+		free(idx);
+	}
+}
+
+const symindex_header *
+symindex_header_of(const symindex *idx)
+{
+	return (idx->hdr);
+}
+
+const symindex_file *
+symindex_file_at(const symindex *idx, uint32_t i)
+{
+	return (i < idx->hdr->nfiles ? &idx->files[i] : NULL);
+}
+
+const symindex_sym *
+symindex_sym_at(const symindex *idx, uint32_t i)
+{
+	return (i < idx->hdr->nsyms ? &idx->syms[i] : NULL);
+}
+
+const char *
+symindex_string(const symindex *idx, uint32_t off)
+{
+	return (off < idx->hdr->strings_len ? idx->strings + off : "");
+}
+
+int64_t
+symindex_find_file(const symindex *idx, const char *path)
+{
+	uint32_t lo = 0;
+	uint32_t hi = idx->hdr->nfiles;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		int      c;
+		c = strcmp(symindex_string(idx, idx->files[mid].path), path);
+		if (c == 0) {
+			return (mid);
+		}
+		if (c < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return (-1);
+}
+
+static const char *
+sym_name(const symindex *idx, uint32_t i)
+{
+	const symindex_sym *s = symindex_sym_at(idx, i);
+	return (s != NULL ? symindex_string(idx, s->name) : "");
+}
+
+static const char *
+module_name(const symindex *idx, uint32_t i)
+{
+	const symindex_file *f = symindex_file_at(idx, i);
+	return (f != NULL ? symindex_string(idx, f->module) : "");
+}
+
+// equal_range finds the run of entries in a sorted array whose key is
+// the given string.
+static const uint32_t *
+equal_range(const symindex *idx, const uint32_t *ents, uint32_t n,
+    const char *(*key)(const symindex *, uint32_t), const char *want,
+    size_t *countp)
+{
+	uint32_t lo = 0;
+	uint32_t hi = n;
+	uint32_t first;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (strcmp(key(idx, ents[mid]), want) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	first = lo;
+	hi    = n;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (strcmp(key(idx, ents[mid]), want) <= 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	*countp = lo - first;
+	return (ents + first);
+}
+
+const uint32_t *
+symindex_lookup(const symindex *idx, const char *name, size_t *countp)
+{
+	return (equal_range(
+	    idx, idx->names, idx->hdr->nsyms, sym_name, name, countp));
+}
+
+const uint32_t *
+symindex_lookup_module(const symindex *idx, const char *module, size_t *countp)
+{
+	return (equal_range(idx, idx->modules, idx->hdr->nmodules,
+	    module_name, module, countp));
+}
+
+// Building.  Strings are interned, as most names are referenced many
+// times, and the records are kept in growable arrays until written.
+
+struct symindex_builder {
+	const symindex *old;
+	TSParser       *parser;
+	ts_d_tagger    *tagger;
+	symindex_file  *files;
+	uint32_t        nfiles;
+	uint32_t        files_cap;
+	symindex_sym   *syms;
+	uint32_t        nsyms;
+	uint32_t        syms_cap;
+	char           *pool;
+	uint32_t        pool_len;
+	uint32_t        pool_cap;
+	uint32_t       *interned; // open addressed, 0 is empty
+	uint32_t        ninterned;
+	uint32_t        interned_cap;
+	const char     *src; // of the file being tagged
+	char           *scratch;
+	size_t          scratch_cap;
+	bool            nomem;
+};
+
+static bool
+grow(void **arr, uint32_t *cap, uint32_t need, size_t sz)
+{
+	uint32_t ncap = *cap ? *cap : 64;
+	void    *n;
+
+	if (need <= *cap) {
+		return (true);
+	}
+	while (ncap < need) {
+		ncap *= 2;
+	}
+	if ((n = realloc(*arr, (size_t) ncap * sz)) == NULL) {
+		return (false);
+	}
+	*arr = n;
+	*cap = ncap;
+	return (true);
+}
+
+static bool
+rehash(symindex_builder *b)
+{
+	uint32_t  cap = b->interned_cap ? b->interned_cap * 2 : 1024;
+	uint32_t *tab;
+
+	if ((tab = calloc(cap, sizeof(uint32_t))) == NULL) {
+		return (false);
+	}
+	for (uint32_t i = 0; i < b->interned_cap; i++) {
+		uint32_t off = b->interned[i];
+		uint32_t h;
+		if (off == 0) {
+			continue;
+		}
+		h = (uint32_t) fnv1a(b->pool + off, strlen(b->pool + off));
+		while (tab[h & (cap - 1)] != 0) {
+			h++;
+		}
+		tab[h & (cap - 1)] = off;
+	}
+	free(b->interned);
+	b->interned     = tab;
+	b->interned_cap = cap;
+	return (true);
+}
+
+// intern returns the string offset of s, adding it if needed, or 0 if
+// out of memory.
+static uint32_t
+intern(symindex_builder *b, const char *s, size_t len)
+{
+	uint32_t h;
+	uint32_t off;
+
+	if (len == 0) {
+		return (0);
+	}
+	if ((b->ninterned + 1) * 2 > b->interned_cap) {
+		if (!rehash(b)) {
+			b->nomem = true;
+			return (0);
+		}
+	}
+	h = (uint32_t) fnv1a(s, len);
+	for (;; h++) {
+		off = b->interned[h & (b->interned_cap - 1)];
+		if (off == 0) {
+			break;
+		}
+		if ((strncmp(b->pool + off, s, len) == 0) &&
+		    (b->pool[off + len] == 0)) {
+			return (off);
+		}
+	}
+	if ((len > UINT32_MAX - b->pool_len - 1) ||
+	    !grow((void **) &b->pool, &b->pool_cap,
+	        b->pool_len + (uint32_t) len + 1, 1)) {
+		b->nomem = true;
+		return (0);
+	}
+	off = b->pool_len;
+	memcpy(b->pool + off, s, len);
+	b->pool[off + len] = 0;
+	b->pool_len += (uint32_t) len + 1;
+	b->interned[h & (b->interned_cap - 1)] = off;
+	b->ninterned++;
+	return (off);
+}
+
+symindex_builder *
+symindex_builder_new(const symindex *old)
+{
+	symindex_builder *b;
+
+	if ((b = calloc(1, sizeof(*b))) == NULL) {
+		return (NULL);
+	}
+	// an index from another version of the grammar may tag differently
+	if ((old != NULL) &&
+	    (strncmp(old->hdr->grammar, SYMINDEX_GRAMMAR,
+	         sizeof(old->hdr->grammar)) == 0)) {
+		b->old = old;
+	}
+	b->parser = ts_parser_new();
+	b->tagger = ts_d_tagger_new(tree_sitter_d());
+	if ((b->parser == NULL) || (b->tagger == NULL) ||
+	    !ts_parser_set_language(b->parser, tree_sitter_d()) ||
+	    !grow((void **) &b->pool, &b->pool_cap, 1, 1)) {
+		symindex_builder_free(b);
+		return (NULL);
+	}
+	b->pool[0]  = 0;
+	b->pool_len = 1;
+	return (b);
+}
+
+void
+symindex_builder_free(symindex_builder *b)
+{
+	if (b == NULL) {
+		return;
+	}
+	if (b->parser != NULL) {
+		ts_parser_delete(b->parser);
+	}
+	ts_d_tagger_delete(b->tagger);
+	free(b->files);
+	free(b->syms);
+	free(b->pool);
+	free(b->interned);
+	free(b->scratch);
+	free(b);
+}
+
+static symindex_sym *
+add_sym(symindex_builder *b)
+{
+	if (!grow((void **) &b->syms, &b->syms_cap, b->nsyms + 1,
+	        sizeof(symindex_sym))) {
+		b->nomem = true;
+		return (NULL);
+	}
+	return (&b->syms[b->nsyms++]);
+}
+
+static void
+add_tag(const ts_d_tag *tag, void *arg)
+{
+	symindex_builder *b     = arg;
+	symindex_file    *f     = &b->files[b->nfiles - 1];
+	uint32_t          start = ts_node_start_byte(tag->name);
+	uint32_t          end   = ts_node_end_byte(tag->name);
+	TSPoint           pt    = ts_node_start_point(tag->name);
+	symindex_sym     *s;
+	size_t            n = 0;
+
+	// Module names may be split over lines, so the whitespace is dropped
+	// from all names, giving the form they are looked up by.
+	if (end - start >= b->scratch_cap) {
+		char *ns;
+		if ((ns = realloc(b->scratch, end - start + 1)) == NULL) {
+			b->nomem = true;
+			return;
+		}
+		b->scratch     = ns;
+		b->scratch_cap = end - start + 1;
+	}
+	for (uint32_t i = start; i < end; i++) {
+		if (!isspace((unsigned char) b->src[i])) {
+			b->scratch[n++] = b->src[i];
+		}
+	}
+	if ((s = add_sym(b)) == NULL) {
+		return;
+	}
+	s->name   = intern(b, b->scratch, n);
+	s->file   = b->nfiles - 1;
+	s->kind   = (uint32_t) tag->kind;
+	s->row    = pt.row;
+	s->column = pt.column;
+	s->start  = ts_node_start_byte(tag->node);
+	s->end    = ts_node_end_byte(tag->node);
+	f->nsyms++;
+	if ((tag->kind == TS_D_TAG_DEFINITION_MODULE) && (f->module == 0)) {
+		f->module = s->name;
+	}
+}
+
+// reuse copies the symbols of a file from the old index, if its content
+// is unchanged.
+static bool
+reuse(symindex_builder *b, symindex_file *f)
+{
+	const symindex_file *of;
+	int64_t              i;
+
+	if ((b->old == NULL) ||
+	    ((i = symindex_find_file(b->old, b->pool + f->path)) < 0)) {
+		return (false);
+	}
+	of = symindex_file_at(b->old, (uint32_t) i);
+	if ((of->hash != f->hash) || (of->size != f->size)) {
+		return (false);
+	}
+	for (uint32_t j = 0; j < of->nsyms; j++) {
+		const symindex_sym *os;
+		const char         *name;
+		symindex_sym       *s;
+		if ((os = symindex_sym_at(b->old, of->first + j)) == NULL) {
+			break;
+		}
+		name = symindex_string(b->old, os->name);
+		if ((s = add_sym(b)) == NULL) {
+			return (true);
+		}
+		*s      = *os;
+		s->name = intern(b, name, strlen(name));
+		s->file = b->nfiles - 1;
+		f->nsyms++;
+	}
+	f->module = intern(b, symindex_string(b->old, of->module),
+	    strlen(symindex_string(b->old, of->module)));
+	return (true);
+}
+
+int
+symindex_add(symindex_builder *b, const char *path, const char *src,
+    size_t len)
+{
+	symindex_file *f;
+	TSTree        *tree;
+
+	if (len > UINT32_MAX) {
+		len = UINT32_MAX; // tree-sitter cannot address more
+	}
+	if (!grow((void **) &b->files, &b->files_cap, b->nfiles + 1,
+	        sizeof(symindex_file))) {
+		return (-1);
+	}
+	f = &b->files[b->nfiles++];
+	memset(f, 0, sizeof(*f));
+	f->hash  = fnv1a(src, len);
+	f->size  = (uint32_t) len;
+	f->path  = intern(b, path, strlen(path));
+	f->first = b->nsyms;
+	if (reuse(b, f)) {
+		return (b->nomem ? -1 : 1);
+	}
+	tree = ts_parser_parse_string(b->parser, NULL, src, (uint32_t) len);
+	if (tree != NULL) {
+		TSNode root = ts_tree_root_node(tree);
+		b->src      = src;
+		ts_d_tagger_run(b->tagger, root, add_tag, b);
+		ts_tree_delete(tree);
+	}
+	return (b->nomem ? -1 : 0);
+}
+
+typedef struct {
+	const char *key;
+	uint32_t    file;
+	uint32_t    start;
+	uint32_t    index;
+} sort_ent;
+
+static int
+cmp_ent(const void *a, const void *b)
+{
+	const sort_ent *x = a;
+	const sort_ent *y = b;
+	int             c;
+
+	if ((c = strcmp(x->key, y->key)) != 0) {
+		return (c);
+	}
+	if (x->file != y->file) {
+		return (x->file < y->file ? -1 : 1);
+	}
+	if (x->start != y->start) {
+		return (x->start < y->start ? -1 : 1);
+	}
+	return (x->index < y->index ? -1 : x->index > y->index);
+}
+
+// sorted returns the indices of n entries in key order.
+static uint32_t *
+sorted(sort_ent *ents, uint32_t n)
+{
+	uint32_t *out;
+
+	if ((out = malloc(((size_t) n + 1) * sizeof(uint32_t))) == NULL) {
+		return (NULL);
+	}
+	qsort(ents, n, sizeof(sort_ent), cmp_ent);
+	for (uint32_t i = 0; i < n; i++) {
+		out[i] = ents[i].index;
+	}
+	return (out);
+}
+
+static bool
+write_all(FILE *f, const void *data, size_t len)
+{
+	return ((len == 0) || (fwrite(data, 1, len, f) == len));
+}
+
+int
+symindex_write(symindex_builder *b, const char *path)
+{
+	symindex_header hdr;
+	symindex_file  *files = NULL;
+	symindex_sym   *syms  = NULL;
+	sort_ent       *ents  = NULL;
+	uint32_t       *order = NULL;
+	uint32_t       *names = NULL;
+	uint32_t       *mods  = NULL;
+	uint32_t        nmods = 0;
+	uint32_t        n     = 0;
+	char            tmp[1024];
+	FILE           *f;
+	int             rv = ENOMEM;
+
+	if (b->nomem) {
+		return (ENOMEM);
+	}
+	if (((files = calloc(b->nfiles + 1, sizeof(*files))) == NULL) ||
+	    ((syms = calloc(b->nsyms + 1, sizeof(*syms))) == NULL) ||
+	    ((ents = calloc((size_t) b->nfiles + b->nsyms + 1,
+	          sizeof(*ents))) == NULL)) {
+		goto out;
+	}
+
+	// files by path, with their symbols renumbered to match
+	for (uint32_t i = 0; i < b->nfiles; i++) {
+		ents[i].key   = b->pool + b->files[i].path;
+		ents[i].index = i;
+	}
+	if ((order = sorted(ents, b->nfiles)) == NULL) {
+		goto out;
+	}
+	for (uint32_t i = 0; i < b->nfiles; i++) {
+		const symindex_file *of = &b->files[order[i]];
+		files[i]                = *of;
+		files[i].first          = n;
+		for (uint32_t j = 0; j < of->nsyms; j++) {
+			syms[n]      = b->syms[of->first + j];
+			syms[n].file = i;
+			n++;
+		}
+		if (of->module != 0) {
+			ents[nmods].key   = b->pool + of->module;
+			ents[nmods].file  = 0;
+			ents[nmods].start = 0;
+			ents[nmods].index = i;
+			nmods++;
+		}
+	}
+	if ((mods = sorted(ents, nmods)) == NULL) {
+		goto out;
+	}
+	for (uint32_t i = 0; i < b->nsyms; i++) {
+		ents[i].key   = b->pool + syms[i].name;
+		ents[i].file  = syms[i].file;
+		ents[i].start = syms[i].start;
+		ents[i].index = i;
+	}
+	if ((names = sorted(ents, b->nsyms)) == NULL) {
+		goto out;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, SYMINDEX_MAGIC, sizeof(hdr.magic));
+	strncpy(hdr.grammar, SYMINDEX_GRAMMAR, sizeof(hdr.grammar) - 1);
+	hdr.format      = SYMINDEX_FORMAT;
+	hdr.endian      = SYMINDEX_ENDIAN;
+	hdr.nfiles      = b->nfiles;
+	hdr.nsyms       = b->nsyms;
+	hdr.nmodules    = nmods;
+	hdr.files       = sizeof(hdr);
+	hdr.syms        = hdr.files + b->nfiles * sizeof(symindex_file);
+	hdr.names       = hdr.syms + b->nsyms * sizeof(symindex_sym);
+	hdr.modules     = hdr.names + b->nsyms * sizeof(uint32_t);
+	hdr.strings     = hdr.modules + nmods * sizeof(uint32_t);
+	hdr.strings_len = b->pool_len;
+
+	snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long) getpid());
+	if ((f = fopen(tmp, "wb")) == NULL) {
+		rv = errno;
+		goto out;
+	}
+	if (!write_all(f, &hdr, sizeof(hdr)) ||
+	    !write_all(f, files, b->nfiles * sizeof(symindex_file)) ||
+	    !write_all(f, syms, b->nsyms * sizeof(symindex_sym)) ||
+	    !write_all(f, names, b->nsyms * sizeof(uint32_t)) ||
+	    !write_all(f, mods, nmods * sizeof(uint32_t)) ||
+	    !write_all(f, b->pool, b->pool_len)) {
+		rv = errno ? errno : EIO;
+		fclose(f);
+		unlink(tmp);
+		goto out;
+	}
+	if (fclose(f) != 0) {
+		rv = errno;
+		unlink(tmp);
+		goto out;
+	}
+	if (rename(tmp, path) != 0) {
+		rv = errno;
+		unlink(tmp);
+		goto out;
+	}
+	rv = 0;
+
+out:
+	free(files);
+	free(syms);
+	free(ents);
+	free(order);
+	free(names);
+	free(mods);
+	return (rv);
+}
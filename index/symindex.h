@@ -0,0 +1,122 @@
+/*
+ * Persistent symbol index for D workspaces.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef SYMINDEX_H
+#define SYMINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The index is a single file, laid out so that it can be mapped and
+// used in place.  All integers are in host byte order; an index written
+// on a host of the other byte order is rejected, and simply rebuilt.
+//
+//   header
+//   files     symindex_file[nfiles], sorted by path
+//   syms      symindex_sym[nsyms], grouped by file
+//   names     uint32_t[nsyms], symbol indices sorted by name
+//   modules   uint32_t[nmodules], file indices sorted by module name
+//   strings   NUL terminated strings; offset 0 is the empty string
+//
+// Symbols are the tags found by queries/tags.scm (see tags/tags.c), and
+// their kind is a ts_d_tag_kind.  Each file is keyed by a hash of its
+// content, so that an update only parses the files that changed.
+
+#define SYMINDEX_MAGIC "DSYMIDX"
+#define SYMINDEX_FORMAT 1
+#define SYMINDEX_ENDIAN 0x01020304u
+
+typedef struct {
+	char     magic[8];
+	uint32_t format;
+	uint32_t endian;
+	char     grammar[16]; // grammar VERSION the index was built with
+	uint32_t nfiles;
+	uint32_t nsyms;
+	uint32_t nmodules;
+	uint32_t files;   // offset of the files section
+	uint32_t syms;    // offset of the syms section
+	uint32_t names;   // offset of the names section
+	uint32_t modules; // offset of the modules section
+	uint32_t strings; // offset of the string pool
+	uint32_t strings_len;
+	uint32_t reserved;
+} symindex_header;
+
+typedef struct {
+	uint64_t hash;   // FNV-1a of the content
+	uint32_t size;   // content length in bytes
+	uint32_t path;   // string offset
+	uint32_t module; // string offset of the module name, or 0
+	uint32_t first;  // index of the first symbol
+	uint32_t nsyms;
+	uint32_t reserved;
+} symindex_file;
+
+typedef struct {
+	uint32_t name;   // string offset
+	uint32_t file;   // file index
+	uint32_t kind;   // ts_d_tag_kind
+	uint32_t row;    // zero based position of the name
+	uint32_t column; // in bytes
+	uint32_t start;  // byte span of the tagged node
+	uint32_t end;
+} symindex_sym;
+
+typedef struct symindex symindex;
+
+// symindex_open maps an index.  It returns 0, or an errno; EINVAL means
+// the file is not an index this code can read.
+extern int symindex_open(const char *path, symindex **idxp);
+extern void symindex_close(symindex *idx);
+
+extern const symindex_header *symindex_header_of(const symindex *idx);
+
+// The accessors return NULL for an index out of range.
+extern const symindex_file *symindex_file_at(const symindex *, uint32_t);
+extern const symindex_sym  *symindex_sym_at(const symindex *, uint32_t);
+
+// symindex_string returns the string at an offset, or "" if the offset
+// is out of range.
+extern const char *symindex_string(const symindex *idx, uint32_t off);
+
+// symindex_find_file returns the index of the file with a path, or -1.
+extern int64_t symindex_find_file(const symindex *idx, const char *path);
+
+// symindex_lookup returns the indices of the symbols with a name, which
+// point into the mapped index, and stores their number in countp.
+extern const uint32_t *symindex_lookup(
+    const symindex *idx, const char *name, size_t *countp);
+
+// symindex_lookup_module is like symindex_lookup, but returns the
+// indices of the files that declare a module.
+extern const uint32_t *symindex_lookup_module(
+    const symindex *idx, const char *module, size_t *countp);
+
+// A builder makes a new index, reusing the symbols of an old one for
+// files whose content is unchanged.  The old index, if not NULL, must
+// stay open until the builder is freed.
+typedef struct symindex_builder symindex_builder;
+
+extern symindex_builder *symindex_builder_new(const symindex *old);
+extern void              symindex_builder_free(symindex_builder *b);
+
+// symindex_add adds a file, parsing it unless the old index has the same
+// content for the same path.  It returns 1 if the old symbols were
+// reused, 0 if the file was parsed, or -1 if out of memory.
+extern int symindex_add(symindex_builder *b, const char *path,
+    const char *src, size_t len);
+
+// symindex_write writes the index to a temporary file, and renames it
+// into place, so that readers with the old index mapped are unaffected.
+// It returns 0 or an errno.
+extern int symindex_write(symindex_builder *b, const char *path);
+
+#endif // SYMINDEX_H
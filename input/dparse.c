@@ -0,0 +1,286 @@
+/*
+ * Parsing large D sources from mapped files.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// dparse parses D sources the way a tool reading very large files
+// should, through a mapped input (see mapinput.h), and compares that with
+// the usual way of reading each file into memory and parsing the copy.
+// Each way is run in a process of its own, so that the peak resident
+// size reported is its own; with -m only the one way is run.
+
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <tree_sitter/api.h>
+
+#include "mapinput.h"
+#include "tree-sitter-d.h"
+
+typedef struct {
+	uint64_t load_ns;
+	uint64_t parse_ns;
+	uint64_t bytes;
+	uint64_t reads;
+	size_t   errors; // files with syntax errors
+	int      failures;
+} result;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec);
+}
+
+// max_rss_mb returns the peak resident size of the process.
+static double
+max_rss_mb(void)
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+	return ((double) ru.ru_maxrss / (1024.0 * 1024.0)); // bytes
+#else
+	return ((double) ru.ru_maxrss / 1024.0); // kilobytes
+#endif
+}
+
+static char *
+read_file(const char *path, size_t *lenp)
+{
+	FILE  *f;
+	char  *buf;
+	long   sz;
+	size_t n;
+
+	if ((f = fopen(path, "rb")) == NULL) {
+		return (NULL);
+	}
+	if ((fseek(f, 0, SEEK_END) != 0) || ((sz = ftell(f)) < 0) ||
+	    (fseek(f, 0, SEEK_SET) != 0)) {
+		fclose(f);
+		return (NULL);
+	}
+	if ((buf = malloc((size_t) sz + 1)) == NULL) {
+		fclose(f);
+		return (NULL);
+	}
+	n = fread(buf, 1, (size_t) sz, f);
+	fclose(f);
+	buf[n] = 0;
+	*lenp  = n;
+	return (buf);
+}
+
+// parse_copy reads a file into memory, and parses the copy.
+static void
+parse_copy(TSParser *parser, const char *path, result *r)
+{
+	uint64_t start = now_ns();
+	TSTree  *tree;
+	char    *src;
+	size_t   len;
+
+	if ((src = read_file(path, &len)) == NULL) {
+		fprintf(stderr, "dparse: %s: %s\n", path, strerror(errno));
+		r->failures++;
+		return;
+	}
+	if (len > UINT32_MAX) {
+		fprintf(stderr, "dparse: %s: %s\n", path, strerror(EFBIG));
+		free(src);
+		r->failures++;
+		return;
+	}
+	r->load_ns += now_ns() - start;
+	start = now_ns();
+	tree  = ts_parser_parse_string(parser, NULL, src, (uint32_t) len);
+	r->parse_ns += now_ns() - start;
+	r->bytes += len;
+	if (tree == NULL) {
+		fprintf(stderr, "dparse: %s: parse failed\n", path);
+		r->failures++;
+	} else {
+		r->errors += ts_node_has_error(ts_tree_root_node(tree));
+		ts_tree_delete(tree);
+	}
+	free(src);
+}
+
+// parse_map parses a file through a mapped input.
+static void
+parse_map(TSParser *parser, const char *path, size_t window, result *r)
+{
+	uint64_t  start = now_ns();
+	mapinput *mi;
+	TSTree   *tree;
+	int       rv;
+
+	if ((rv = mapinput_open(path, window, &mi)) != 0) {
+		fprintf(stderr, "dparse: %s: %s\n", path, strerror(rv));
+		r->failures++;
+		return;
+	}
+	r->load_ns += now_ns() - start;
+	start = now_ns();
+	tree  = ts_parser_parse(parser, NULL, mapinput_input(mi));
+	r->parse_ns += now_ns() - start;
+	r->bytes += mapinput_size(mi);
+	r->reads += mapinput_reads(mi);
+	if (tree == NULL) {
+		fprintf(stderr, "dparse: %s: parse failed\n", path);
+		r->failures++;
+	} else {
+		r->errors += ts_node_has_error(ts_tree_root_node(tree));
+		ts_tree_delete(tree);
+	}
+	mapinput_close(mi);
+}
+
+// run parses the files the one way, and reports the best of the
+// iterations, and the peak resident size.
+static int
+run(bool map, char **files, int nfiles, int iterations, size_t window)
+{
+	TSParser *parser = ts_parser_new();
+	result    best;
+
+	ts_parser_set_language(parser, tree_sitter_d());
+	memset(&best, 0, sizeof(best));
+	for (int i = 0; i < iterations; i++) {
+		result r;
+		memset(&r, 0, sizeof(r));
+		for (int j = 0; j < nfiles; j++) {
+			if (map) {
+				parse_map(parser, files[j], window, &r);
+			} else {
+				parse_copy(parser, files[j], &r);
+			}
+		}
+		if ((i == 0) ||
+		    (r.load_ns + r.parse_ns < best.load_ns + best.parse_ns)) {
+			best = r;
+		}
+		if (r.failures != 0) {
+			best = r;
+			break;
+		}
+	}
+	ts_parser_delete(parser);
+
+	printf("%-4s  %d files, %.1f MB, %zu with errors: load %.1f ms, "
+	       "parse %.1f ms (%.1f MB/s), max RSS %.1f MB",
+	    map ? "map" : "copy", nfiles, (double) best.bytes / 1e6,
+	    best.errors, (double) best.load_ns / 1e6,
+	    (double) best.parse_ns / 1e6,
+	    best.parse_ns ? (double) best.bytes * 1e3 / (double) best.parse_ns
+	                  : 0.0,
+	    max_rss_mb());
+	if (map) {
+		printf(", %llu reads", (unsigned long long) best.reads);
+	}
+	printf("\n");
+	fflush(stdout);
+	return (best.failures);
+}
+
+// run_child runs one way in a process of its own.
+static int
+run_child(bool map, char **files, int nfiles, int iterations, size_t window)
+{
+	pid_t pid;
+	int   status;
+
+	fflush(stdout);
+	if ((pid = fork()) < 0) {
+		fprintf(stderr, "dparse: fork: %s\n", strerror(errno));
+		return (1);
+	}
+	if (pid == 0) {
+		_exit(run(map, files, nfiles, iterations, window) ? 1 : 0);
+	}
+	if (waitpid(pid, &status, 0) != pid) {
+		fprintf(stderr, "dparse: wait: %s\n", strerror(errno));
+		return (1);
+	}
+	return ((WIFEXITED(status) && (WEXITSTATUS(status) == 0)) ? 0 : 1);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+	    "usage: dparse [-m map|copy] [-n iterations] [-w window-kb] "
+	    "file ...\n");
+	exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *mode       = NULL;
+	int         iterations = 1;
+	size_t      window     = MAPINPUT_WINDOW;
+	int         failures   = 0;
+	int         opt;
+
+	while ((opt = getopt(argc, argv, "m:n:w:")) != -1) {
+		switch (opt) {
+		case 'm':
+			mode = optarg;
+			if ((strcmp(mode, "map") != 0) &&
+			    (strcmp(mode, "copy") != 0)) {
+				usage();
+			}
+			break;
+		case 'n':
+			if ((iterations = atoi(optarg)) < 1) {
+				usage();
+			}
+			break;
+		case 'w':
+			window = (size_t) strtoul(optarg, NULL, 10) * 1024;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc == 0) {
+		usage();
+	}
+
+	if (mode != NULL) {
+		failures = run(strcmp(mode, "map") == 0, argv, argc,
+		    iterations, window);
+	} else {
+		// read each file once first, so that both ways find it in
+		// the page cache
+		for (int i = 0; i < argc; i++) {
+			size_t len;
+			free(read_file(argv[i], &len));
+		}
+		failures += run_child(false, argv, argc, iterations, window);
+		failures += run_child(true, argv, argc, iterations, window);
+	}
+	return (failures != 0 ? 1 : 0);
+}
@@ -0,0 +1,171 @@
+/*
+ * Parsing D sources from memory-mapped files.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <tree_sitter/api.h>
+
+#include "mapinput.h"
+
+struct mapinput {
+	const char *data;
+	size_t      size;
+	size_t      page;
+	size_t      window;
+	size_t      furthest; // end of the furthest chunk given out
+	size_t      released; // pages before this have been released
+	uint64_t    reads;
+};
+
+int
+mapinput_open(const char *path, size_t window, mapinput **mip)
+{
+	mapinput   *mi;
+	struct stat st;
+	void       *base;
+	int         fd;
+	int         rv;
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		return (errno);
+	}
+	if (fstat(fd, &st) != 0) {
+		rv = errno;
+		close(fd);
+		return (rv);
+	}
+	if ((uint64_t) st.st_size > UINT32_MAX) {
+		close(fd);
+		return (EFBIG); // tree-sitter cannot address more
+	}
+	if ((mi = calloc(1, sizeof(*mi))) == NULL) {
+		close(fd);
+		return (ENOMEM);
+	}
+	mi->size   = (size_t) st.st_size;
+	mi->page   = (size_t) sysconf(_SC_PAGESIZE);
+	mi->window = window;
+	mi->data   = "";
+
+	// an empty file cannot be mapped, and needs no mapping
+	if (mi->size > 0) {
+		base = mmap(NULL, mi->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (base == MAP_FAILED) {
+			rv = errno;
+			close(fd);
+			free(mi);
+			return (rv);
+		}
+		(void) madvise(base, mi->size, MADV_SEQUENTIAL);
+		mi->data = base;
+	}
+	close(fd);
+	*mip = mi;
+	return (0);
+}
+
+void
+mapinput_close(mapinput *mi)
+{
+	if (mi != NULL) {
+		if (mi->size > 0) {
+			munmap((void *) mi->data, mi->size);
+		}
+		free(mi);
+	}
+}
+
+const char *
+mapinput_data(const mapinput *mi)
+{
+	return (mi->data);
+}
+
+uint32_t
+mapinput_size(const mapinput *mi)
+{
+	return ((uint32_t) mi->size);
+}
+
+uint64_t
+mapinput_reads(const mapinput *mi)
+{
+	return (mi->reads);
+}
+
+// release gives back the pages more than the window behind the furthest
+// byte read, a window's worth at a time, to keep the system calls few.
+// The mapping stays, so a later read of those pages faults them in again.
+static void
+release(mapinput *mi)
+{
+	size_t upto;
+
+	if ((mi->window == 0) || (mi->furthest <= mi->window)) {
+		return;
+	}
+	upto = (mi->furthest - mi->window) / mi->page * mi->page;
+	if (upto - mi->released < mi->window) {
+		return;
+	}
+	(void) madvise((void *) (mi->data + mi->released),
+	    upto - mi->released, MADV_DONTNEED);
+	mi->released = upto;
+}
+
+static const char *
+read_chunk(void *payload, uint32_t byte, TSPoint pos, uint32_t *nread)
+{
+	mapinput *mi = payload;
+	size_t    end;
+
+	(void) pos;
+	mi->reads++;
+	if (byte >= mi->size) {
+		*nread = 0;
+		return ("");
+	}
+	end = ((size_t) byte / mi->page + 1) * mi->page;
+	if (end > mi->size) {
+		end = mi->size;
+	}
+	// finish a character that crosses into the next page
+	while ((end < mi->size) &&
+	    (((uint8_t) mi->data[end] & 0xc0) == 0x80)) {
+		end++;
+	}
+	if (end > mi->furthest) {
+		mi->furthest = end;
+		release(mi);
+	}
+	*nread = (uint32_t) (end - byte);
+	return (mi->data + byte);
+}
+
+TSInput
+mapinput_input(mapinput *mi)
+{
+	TSInput input;
+
+	memset(&input, 0, sizeof(input));
+	input.payload  = mi;
+	input.read     = read_chunk;
+	input.encoding = TSInputEncodingUTF8;
+	return (input);
+}
@@ -0,0 +1,53 @@
+/*
+ * Parsing D sources from memory-mapped files.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef MAPINPUT_H
+#define MAPINPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <tree_sitter/api.h>
+
+// A mapped input gives the parser a file as it is in the page cache,
+// without reading it into memory of its own.  The read callback returns
+// pointers into the mapping, a page or so at a time, so that nothing is
+// copied; each chunk is extended to the end of any UTF-8 character that
+// crosses the page boundary, as the runtime cannot decode a character
+// split between chunks.  The pages well behind the furthest byte read so
+// far are released from the process as the parse goes on, so that the
+// source need not stay resident; should the parser look back that far,
+// they are read again from the file.  The file must not be changed while
+// it is mapped.
+
+typedef struct mapinput mapinput;
+
+// default for the window, the bytes kept resident behind the furthest
+// byte read
+#define MAPINPUT_WINDOW (1u << 20)
+
+// mapinput_open maps a file.  Pages more than window bytes behind the
+// furthest byte read are released; a window of 0 keeps them all.  It
+// returns 0, EFBIG if the file is too large for the parser (4 GiB or
+// more), or another errno.
+extern int  mapinput_open(const char *path, size_t window, mapinput **mip);
+extern void mapinput_close(mapinput *mi);
+
+extern const char *mapinput_data(const mapinput *mi);
+extern uint32_t    mapinput_size(const mapinput *mi);
+
+// mapinput_reads returns the number of chunks the parser has asked for.
+extern uint64_t mapinput_reads(const mapinput *mi);
+
+// mapinput_input returns the input to give ts_parser_parse.  The input
+// refers to mi, which must outlive the parse.
+extern TSInput mapinput_input(mapinput *mi);
+
+#endif // MAPINPUT_H
@@ -40,10 +40,10 @@
 (parameter_attribute (in) @keyword.storage)
 (parameter_attribute (out) @keyword.storage)
 
-(function_declaration (identifier) @function)
+(function_declaration name: (identifier) @function)
 
-(call_expression (identifier) @function)
-(call_expression (type (template_instance (identifier) @function)))
+(call_expression function: (identifier) @function)
+(call_expression function: (type (template_instance name: (identifier) @function)))
 (template_arguments (identifier) @variable.parameter)
 
 (named_argument (identifier) @variable.parameter)
@@ -0,0 +1,20 @@
+// Package queries embeds the query files, so that the Go binding can
+// provide them (go:embed cannot refer to a parent directory).
+package queries
+
+import _ "embed"
+
+//go:embed highlights.scm
+var Highlights string
+
+//go:embed injections.scm
+var Injections string
+
+//go:embed tags.scm
+var Tags string
+
+//go:embed indents.scm
+var Indents string
+
+//go:embed textobjects.scm
+var TextObjects string
@@ -1,28 +1,28 @@
-(module_def (module_declaration (module_fqn) @name)) @definition.module
+(module_def (module_declaration name: (module_fqn) @name)) @definition.module
 
-(struct_declaration (struct) . (identifier) @name) @definition.class
-(interface_declaration (interface) . (identifier) @name) @definition.interface
-(enum_declaration (enum) . (identifier) @name) @definition.type
+(struct_declaration name: (identifier) @name) @definition.class
+(interface_declaration name: (identifier) @name) @definition.interface
+(enum_declaration name: (identifier) @name) @definition.type
 
-(class_declaration (class) . (identifier) @name) @definition.class
+(class_declaration name: (identifier) @name) @definition.class
 (constructor (this) @name) @definition.method
 (destructor (this) @name) @definition.method
 (postblit (this) @name) @definition.method
 
-(manifest_declarator . (identifier) @name) @definition.type
+(manifest_declarator name: (identifier) @name) @definition.type
 
-(function_declaration (identifier) @name) @definition.function
+(function_declaration name: (identifier) @name) @definition.function
 
-(union_declaration (union) . (identifier) @name) @definition.type
+(union_declaration name: (identifier) @name) @definition.type
 
-(anonymous_enum_declaration (enum_member . (identifier) @name)) @definition.constant
+(anonymous_enum_declaration member: (enum_member name: (identifier) @name)) @definition.constant
 
-(enum_declaration (enum_member . (identifier) @name)) @definition.constant
+(enum_declaration member: (enum_member name: (identifier) @name)) @definition.constant
 
-(call_expression (identifier) @name) @reference.call
-(call_expression (type (template_instance (identifier) @name))) @reference.call
-(parameter (type (identifier) @name) @reference.class (identifier))
+(call_expression function: (identifier) @name) @reference.call
+(call_expression function: (type (template_instance name: (identifier) @name))) @reference.call
+(parameter type: (type (identifier) @name) @reference.class name: (identifier))
 
-(variable_declaration (type (identifier) @name) @reference.class (declarator))
+(variable_declaration type: (type (identifier) @name) @reference.class declarator: (declarator))
 
-((alias_declaration (alias_initializer . (identifier) @name))) @definition.class
+((alias_declaration (alias_initializer name: (identifier) @name))) @definition.class
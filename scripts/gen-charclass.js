@@ -0,0 +1,148 @@
+/*
+ * Generate src/charclass.h, the character classification tables used
+ * by the external scanner.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// usage: node scripts/gen-charclass.js > src/charclass.h
+//
+// The classes are derived from the Unicode properties known to the
+// JavaScript engine, rather than from the C library, so that the scanner
+// behaves the same way regardless of the process locale.  They mirror
+// what the wide character functions report in a UTF-8 locale:
+//
+//   CC_SPACE  - White_Space, less the no-break spaces and NEL (iswspace)
+//   CC_ALNUM  - Alphabetic or decimal digit (iswalnum)
+//   CC_DIGIT  - ASCII decimal digits only (iswdigit)
+//   CC_XDIGIT - ASCII hexadecimal digits only (iswxdigit)
+//   CC_EOL    - D end of line characters (\n, \r, U+2028, U+2029)
+
+const CC_SPACE = 0x01;
+const CC_ALNUM = 0x02;
+const CC_DIGIT = 0x04;
+const CC_XDIGIT = 0x08;
+const CC_EOL = 0x10;
+
+const MAX = 0x110000;
+const BLOCK = 256;
+
+const space = /\p{White_Space}/u;
+const alnum = /[\p{Alphabetic}\p{Nd}]/u;
+const notSpace = new Set([0x85, 0xa0, 0x2007, 0x202f]);
+const eol = new Set([0x0a, 0x0d, 0x2028, 0x2029]);
+
+function classify(cp) {
+  // lone surrogates are not characters
+  if (cp >= 0xd800 && cp <= 0xdfff) {
+    return 0;
+  }
+  const s = String.fromCodePoint(cp);
+  let cc = 0;
+  if (space.test(s) && !notSpace.has(cp)) {
+    cc |= CC_SPACE;
+  }
+  if (alnum.test(s)) {
+    cc |= CC_ALNUM;
+  }
+  if (cp >= 0x30 && cp <= 0x39) {
+    cc |= CC_DIGIT | CC_XDIGIT;
+  }
+  if ((cp >= 0x41 && cp <= 0x46) || (cp >= 0x61 && cp <= 0x66)) {
+    cc |= CC_XDIGIT;
+  }
+  if (eol.has(cp)) {
+    cc |= CC_EOL;
+  }
+  return cc;
+}
+
+const blocks = [];
+const blockIndex = new Map();
+const stage1 = [];
+
+for (let hi = 0; hi < MAX / BLOCK; hi++) {
+  const block = [];
+  for (let lo = 0; lo < BLOCK; lo++) {
+    block.push(classify(hi * BLOCK + lo));
+  }
+  const key = block.join(",");
+  if (!blockIndex.has(key)) {
+    blockIndex.set(key, blocks.length);
+    blocks.push(block);
+  }
+  stage1.push(blockIndex.get(key));
+}
+
+if (blocks.length > 256) {
+  throw new Error(`too many blocks (${blocks.length}) for uint8_t index`);
+}
+
+function rows(values, perRow) {
+  const out = [];
+  for (let i = 0; i < values.length; i += perRow) {
+    out.push("\t" + values.slice(i, i + perRow).join(", ") + ",");
+  }
+  return out.join("\n");
+}
+
+const hex = (v) => "0x" + v.toString(16).padStart(2, "0");
+const ascii = [];
+for (let cp = 0; cp < 0x80; cp++) {
+  ascii.push(hex(classify(cp)));
+}
+
+console.log(`/*
+ * Character classification tables for the D scanner.
+ *
+ * THIS FILE IS GENERATED by scripts/gen-charclass.js -- DO NOT EDIT.
+ * Unicode version: ${process.versions.unicode}
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+#ifndef TREE_SITTER_D_CHARCLASS_H
+#define TREE_SITTER_D_CHARCLASS_H
+
+#include <stdint.h>
+
+#define CC_SPACE 0x${CC_SPACE.toString(16).padStart(2, "0")}
+#define CC_ALNUM 0x${CC_ALNUM.toString(16).padStart(2, "0")}
+#define CC_DIGIT 0x${CC_DIGIT.toString(16).padStart(2, "0")}
+#define CC_XDIGIT 0x${CC_XDIGIT.toString(16).padStart(2, "0")}
+#define CC_EOL 0x${CC_EOL.toString(16).padStart(2, "0")}
+
+// classes for ASCII, which is nearly everything we see
+static const uint8_t cc_ascii[128] = {
+${rows(ascii, 8)}
+};
+
+// two stage table for the rest: cc_index selects a ${BLOCK} entry block
+static const uint8_t cc_index[${stage1.length}] = {
+${rows(stage1, 16)}
+};
+
+static const uint8_t cc_blocks[${blocks.length}][${BLOCK}] = {
+${blocks
+  .map((b) => "\t{\n" + rows(b.map(hex), 8).replace(/^\t/gm, "\t\t") + "\n\t},")
+  .join("\n")}
+};
+
+static inline uint8_t
+char_class(int32_t c)
+{
+	if ((uint32_t) c < 0x80) {
+		return (cc_ascii[c]);
+	}
+	if ((uint32_t) c >= 0x${MAX.toString(16)}) {
+		return (0);
+	}
+	return (cc_blocks[cc_index[c >> 8]][c & 0xff]);
+}
+
+#endif // TREE_SITTER_D_CHARCLASS_H`);
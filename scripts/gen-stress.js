@@ -0,0 +1,199 @@
+/*
+ * Generate test/stress, a corpus of pathological D sources.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// usage: node scripts/gen-stress.js [scale] [directory]
+//
+// Each file stresses one thing that is known to make parsers slow or
+// hungry: deep nesting, long flat runs, ambiguity that keeps the GLR
+// stack split, and broken code that keeps error recovery busy.  They are
+// checked in, and parsed by test/stress_test.c (make test-stress), which
+// fails if any of them takes longer, or makes the process larger, than
+// its ceilings.  The output is the same on every run, so that the files
+// only change when this script does.  A scale above 1 makes larger
+// files, for finding where the time goes rather than for the tests.
+
+const fs = require("fs");
+const path = require("path");
+
+const scale = Number(process.argv[2] || 1);
+const dir = process.argv[3] || path.join(__dirname, "..", "test", "stress");
+
+if (!(scale > 0)) {
+  throw new Error(`bad scale ${process.argv[2]}`);
+}
+
+const n = (count) => Math.max(1, Math.round(count * scale));
+
+// a small LCG, so that the "random" inputs are reproducible
+let seed = 0x2545f491;
+function random(limit) {
+  seed = (Math.imul(seed, 1103515245) + 12345) >>> 0;
+  return (seed >>> 8) % limit;
+}
+
+const files = {
+  // deeply nested parenthesized expressions
+  "nested_parens.d"() {
+    const depth = n(1000);
+    return `int x = ${"(".repeat(depth)}1${")".repeat(depth)};\n`;
+  },
+
+  // deeply nested blocks and if statements
+  "nested_blocks.d"() {
+    const depth = n(500);
+    let s = "void f()\n";
+    for (let i = 0; i < depth; i++) {
+      s += `{ if (x${i})\n`;
+    }
+    s += "{ return; }\n";
+    s += "}\n".repeat(depth);
+    return s;
+  },
+
+  // nested template instances, and chained short instances
+  "templates.d"() {
+    const depth = n(300);
+    let s = "alias T = ";
+    for (let i = 0; i < depth; i++) {
+      s += `A${i % 7}!(int, `;
+    }
+    s += "int" + ")".repeat(depth) + ";\n";
+    const chain = Array.from({ length: n(2000) }, (_, i) => `B${i % 5}`);
+    s += `alias U = ${chain.join("!")};\n`;
+    return s;
+  },
+
+  // one very long chain of binary operators
+  "binary_chain.d"() {
+    const ops = ["+", "*", "-", "/", "&&", "||", "|", "^", "<<", "==", "~"];
+    let s = "auto x = a0";
+    for (let i = 1; i < n(8000); i++) {
+      s += ` ${ops[i % ops.length]} a${i}`;
+      if (i % 16 === 0) {
+        s += "\n    ";
+      }
+    }
+    return s + ";\n";
+  },
+
+  // long runs of attributes, and of user defined attributes
+  "attributes.d"() {
+    const attrs = [
+      "@safe",
+      "pure",
+      "nothrow",
+      "@nogc",
+      "static",
+      "const",
+      "shared",
+      "extern (C)",
+      "align (8)",
+      "deprecated",
+      "@property",
+      "@(42)",
+      "@UDA(1, \"x\")",
+      "public",
+    ];
+    let s = "";
+    for (let d = 0; d < n(40); d++) {
+      for (let i = 0; i < 100; i++) {
+        s += attrs[(i + d) % attrs.length] + (i % 8 === 7 ? "\n" : " ");
+      }
+      s += `int f${d}();\n`;
+    }
+    s += "@safe:\n".repeat(n(2000));
+    return s + "void g() {}\n";
+  },
+
+  // statements that are both declarations and expressions, which keep
+  // the GLR stack split until the end of each statement
+  "ambiguous.d"() {
+    let s = "void f()\n{\n";
+    for (let i = 0; i < n(3000); i++) {
+      switch (i % 4) {
+        case 0:
+          s += `    a${i} * b${i};\n`;
+          break;
+        case 1:
+          s += `    a${i}[b${i}] c${i};\n`;
+          break;
+        case 2:
+          s += `    a${i}!(b${i})[c${i}] * d${i};\n`;
+          break;
+        default:
+          s += `    a${i}.b${i}* c${i} = d${i};\n`;
+          break;
+      }
+    }
+    return s + "}\n";
+  },
+
+  // unbalanced and misplaced brackets, so that error recovery runs for
+  // nearly every line
+  "unbalanced.d"() {
+    const lines = [
+      "void f( {",
+      "int x = (1 + ;",
+      "] ) class {",
+      "if (a { b(); ]",
+      "struct S { int y = [1, 2; }",
+      "foreach (i; 0 .. ) {",
+      "} } }",
+      "auto z = a[b(c{d];",
+      "template T(U { alias",
+      "switch (x) { case : default",
+    ];
+    let s = "";
+    for (let i = 0; i < n(3000); i++) {
+      s += lines[random(lines.length)] + "\n";
+    }
+    return s;
+  },
+
+  // unterminated strings and comments, each running to the end of input
+  "unterminated.d"() {
+    let s = "";
+    for (let i = 0; i < n(1000); i++) {
+      s += `string s${i} = "ok ${i}";\n`;
+    }
+    s += 'string bad = "this string never ends\n';
+    s += 'int y = 1; // "\n'.repeat(n(1000));
+    s += "q{ token string { { {\n".repeat(n(200));
+    s += "/+ nested /+ comment /+ never closed\n".repeat(n(200));
+    return s;
+  },
+
+  // a reproducible stream of D tokens in no particular order
+  "soup.d"() {
+    const tokens = [
+      "(", ")", "{", "}", "[", "]", ";", ",", ".", "..", "...", "!", "=",
+      "+", "*", "&", "=>", "?", ":", "@", "$", "#line 1",
+      "if", "else", "while", "for", "foreach", "return", "class", "struct",
+      "template", "mixin", "static", "import", "alias", "auto", "int",
+      "version", "debug", "asm", "is", "typeof", "__traits", "in", "out",
+      "x", "y", "T", "foo", "0", "1.5", "0x1p-2", "'c'", '"s"', "r\"raw\"",
+      "q{ a }", "/* c */", "// c\n",
+    ];
+    const words = [];
+    for (let i = 0; i < n(12000); i++) {
+      words.push(tokens[random(tokens.length)]);
+      if (i % 16 === 15) {
+        words.push("\n");
+      }
+    }
+    return words.join(" ") + "\n";
+  },
+};
+
+fs.mkdirSync(dir, { recursive: true });
+const header = "// THIS FILE IS GENERATED by scripts/gen-stress.js -- DO NOT EDIT.\n";
+for (const [name, make] of Object.entries(files)) {
+  fs.writeFileSync(path.join(dir, name), header + make());
+}
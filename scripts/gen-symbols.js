@@ -0,0 +1,334 @@
+/*
+ * Generate bindings/c/tree-sitter-d-symbols.h, the symbol and field IDs of
+ * the generated parser, for C and C++ code that dispatches on them.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// usage: node scripts/gen-symbols.js src/parser.c src/node-types.json \
+//            > bindings/c/tree-sitter-d-symbols.h
+//
+// The IDs are assigned by tree-sitter generate, and only the generated
+// parser knows them, so they are read from its symbol tables.  Only the
+// symbols that can appear in a tree are given constants: the visible ones
+// that are their own public symbol (ts_node_symbol never returns the
+// others).  Named symbols are TS_D_SYM_<name>, anonymous ones are
+// TS_D_ANON_<name>, with punctuation spelled out as tree-sitter does
+// (so "!=" is TS_D_ANON_BANG_EQ), and fields are TS_D_FIELD_<name>.
+//
+// Every node type and field in node-types.json must have a constant, so
+// that a parser.c and node-types.json from different generations are
+// caught here, rather than by whoever uses the header.
+
+const fs = require("fs");
+const path = require("path");
+
+const [parserFile, nodeTypesFile] = process.argv.slice(2);
+if (!parserFile || !nodeTypesFile) {
+  console.error(
+    "usage: gen-symbols.js src/parser.c src/node-types.json > header.h",
+  );
+  process.exit(2);
+}
+
+function fail(msg) {
+  console.error(`gen-symbols: ${msg}`);
+  process.exit(1);
+}
+
+const src = fs.readFileSync(parserFile, "utf8");
+const nodeTypes = JSON.parse(fs.readFileSync(nodeTypesFile, "utf8"));
+const version = fs
+  .readFileSync(path.join(__dirname, "..", "VERSION"), "utf8")
+  .trim();
+
+function macro(name) {
+  const m = src.match(new RegExp(`^#define ${name} (\\d+)`, "m"));
+  if (!m) {
+    fail(`${parserFile}: no ${name}`);
+  }
+  return Number(m[1]);
+}
+
+// table returns the body of a static array initializer.
+function table(name) {
+  const start = src.search(new RegExp(`\\b${name}\\[\\w*\\] = \\{`));
+  if (start < 0) {
+    fail(`${parserFile}: no ${name}`);
+  }
+  const end = src.indexOf("\n};", start);
+  return src.slice(src.indexOf("{", start) + 1, end);
+}
+
+// the values of the symbol and field enumerations
+const ids = new Map([["ts_builtin_sym_end", 0]]);
+for (const m of src.matchAll(
+  /^\s+((?:sym|anon_sym|aux_sym|alias_sym|field)_\w+) = (\d+),$/gm,
+)) {
+  ids.set(m[1], Number(m[2]));
+}
+
+const STRING = /"(?:[^"\\]|\\.)*"/.source;
+const names = new Map();
+for (const m of table("ts_symbol_names").matchAll(
+  new RegExp(`\\[(\\w+)\\] = (${STRING}),`, "g"),
+)) {
+  names.set(m[1], m[2]);
+}
+const publicSymbol = new Map();
+for (const m of table("ts_symbol_map").matchAll(/\[(\w+)\] = (\w+),/g)) {
+  publicSymbol.set(m[1], m[2]);
+}
+const metadata = new Map();
+for (const m of table("ts_symbol_metadata").matchAll(
+  /\[(\w+)\] = \{\s*\.visible = (true|false),\s*\.named = (true|false),/g,
+)) {
+  metadata.set(m[1], { visible: m[2] === "true", named: m[3] === "true" });
+}
+const fieldNames = new Map();
+if (macro("FIELD_COUNT") > 0) {
+  for (const m of table("ts_field_names").matchAll(
+    new RegExp(`\\[(field_\\w+)\\] = (${STRING}),`, "g"),
+  )) {
+    fieldNames.set(m[1], m[2]);
+  }
+}
+
+// unquote turns a C string literal back into the string it stands for.
+function unquote(lit) {
+  const esc = { n: "\n", r: "\r", t: "\t", 0: "\0" };
+  return lit
+    .slice(1, -1)
+    .replace(/\\(.)/g, (_, c) => (c in esc ? esc[c] : c));
+}
+
+const WORDS = {
+  "~": "TILDE",
+  "`": "BQUOTE",
+  "!": "BANG",
+  "@": "AT",
+  "#": "POUND",
+  $: "DOLLAR",
+  "%": "PERCENT",
+  "^": "CARET",
+  "&": "AMP",
+  "*": "STAR",
+  "(": "LPAREN",
+  ")": "RPAREN",
+  "-": "DASH",
+  "+": "PLUS",
+  "=": "EQ",
+  "{": "LBRACE",
+  "}": "RBRACE",
+  "[": "LBRACK",
+  "]": "RBRACK",
+  "\\": "BSLASH",
+  "|": "PIPE",
+  ":": "COLON",
+  ";": "SEMI",
+  '"': "DQUOTE",
+  "'": "SQUOTE",
+  "<": "LT",
+  ">": "GT",
+  ",": "COMMA",
+  ".": "DOT",
+  "?": "QMARK",
+  "/": "SLASH",
+  " ": "SPACE",
+  "\n": "LF",
+  "\r": "CR",
+  "\t": "TAB",
+};
+
+// mangle makes an identifier of a node type, with runs of word characters
+// kept as they are, and anything else spelled out.
+function mangle(name) {
+  const parts = [];
+  let word = "";
+  for (const c of name) {
+    if (/\w/.test(c)) {
+      word += c;
+      continue;
+    }
+    if (word !== "") {
+      parts.push(word);
+      word = "";
+    }
+    parts.push(WORDS[c] || "U" + c.codePointAt(0).toString(16).toUpperCase());
+  }
+  if (word !== "") {
+    parts.push(word);
+  }
+  return parts.join("_").toUpperCase();
+}
+
+const symbols = [
+  { id: 0xffff, named: true, name: "ERROR", lit: '"ERROR"' },
+];
+for (const [sym, lit] of names) {
+  const meta = metadata.get(sym);
+  if (!meta || !meta.visible || publicSymbol.get(sym) !== sym) {
+    continue;
+  }
+  if (!ids.has(sym)) {
+    fail(`${parserFile}: no value for ${sym}`);
+  }
+  const name = unquote(lit);
+  symbols.push({
+    id: ids.get(sym),
+    named: meta.named,
+    name,
+    lit,
+  });
+}
+symbols.sort((a, b) => a.id - b.id);
+
+const fields = [];
+for (const [field, lit] of fieldNames) {
+  fields.push({ id: ids.get(field), name: unquote(lit), lit });
+}
+fields.sort((a, b) => a.id - b.id);
+
+// the constants, which must all be distinct
+const seen = new Map();
+function constant(prefix, name) {
+  const id = `TS_D_${prefix}_${mangle(name)}`;
+  if (seen.has(id)) {
+    fail(`"${name}" and "${seen.get(id)}" are both ${id}`);
+  }
+  seen.set(id, name);
+  return id;
+}
+for (const s of symbols) {
+  s.constant = constant(s.named ? "SYM" : "ANON", s.name);
+}
+for (const f of fields) {
+  f.constant = constant("FIELD", f.name);
+}
+
+// node-types.json must agree with the parser
+const have = new Set(symbols.map((s) => `${s.named}:${s.name}`));
+const haveFields = new Set(fields.map((f) => f.name));
+for (const t of nodeTypes) {
+  if (t.subtypes) {
+    continue; // supertypes are hidden
+  }
+  if (!have.has(`${t.named}:${t.type}`)) {
+    fail(`node type "${t.type}" is not in ${parserFile}`);
+  }
+  for (const f of Object.keys(t.fields || {})) {
+    if (!haveFields.has(f)) {
+      fail(`field "${f}" is not in ${parserFile}`);
+    }
+  }
+}
+
+function enumerators(list) {
+  const width = Math.max(...list.map((x) => x.constant.length));
+  return list
+    .map((x) => `\t${x.constant.padEnd(width)} = ${x.id},`)
+    .join("\n");
+}
+
+console.log(`/*
+ * Symbol and field IDs of the D grammar.
+ *
+ * THIS FILE IS GENERATED by scripts/gen-symbols.js -- DO NOT EDIT.
+ * Grammar version: ${version}
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef TREE_SITTER_D_SYMBOLS_H_
+#define TREE_SITTER_D_SYMBOLS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <tree_sitter/api.h>
+
+// The symbols are the values of ts_node_symbol, and the fields those of
+// ts_tree_cursor_current_field_id, so that a walk can switch on them
+// rather than compare type names.  They are only good for the parser they
+// were generated from, as tree-sitter generate may number them anew after
+// any change to the grammar, so check them with ts_d_symbols_check when
+// the language is loaded, if it might come from elsewhere.
+#define TS_D_SYMBOLS_VERSION "${version}"
+#define TS_D_SYMBOLS_LANGUAGE_VERSION ${macro("LANGUAGE_VERSION")}
+#define TS_D_SYMBOL_COUNT ${macro("SYMBOL_COUNT") + macro("ALIAS_COUNT")}
+#define TS_D_FIELD_COUNT ${macro("FIELD_COUNT")}
+
+typedef enum {
+${enumerators(symbols)}
+} ts_d_symbol;
+
+typedef enum {
+${fields.length ? enumerators(fields) : "\tTS_D_FIELD_NONE = 0,"}
+} ts_d_field;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ts_d_symbols_check returns NULL if every constant above has the same
+// meaning in lang, or else the name of the first one that does not (or
+// "symbol count" or "field count", if lang has a different number).
+static inline const char *
+ts_d_symbols_check(const TSLanguage *lang)
+{
+	static const struct {
+		uint16_t    id;
+		bool        named;
+		const char *name;
+	} symbols[] = {
+${symbols
+  .map((s) => `\t\t{ ${s.id}, ${s.named}, ${s.lit} },`)
+  .join("\n")}
+	};
+	static const struct {
+		uint16_t    id;
+		const char *name;
+	} fields[] = {
+${fields.length ? fields.map((f) => `\t\t{ ${f.id}, ${f.lit} },`).join("\n") : "\t\t{ 0, NULL },"}
+	};
+
+	if (ts_language_symbol_count(lang) != TS_D_SYMBOL_COUNT) {
+		return ("symbol count");
+	}
+	if (ts_language_field_count(lang) != TS_D_FIELD_COUNT) {
+		return ("field count");
+	}
+	for (size_t i = 0; i < sizeof(symbols) / sizeof(symbols[0]); i++) {
+		const char *name = symbols[i].name;
+		if (ts_language_symbol_for_name(lang, name,
+		        (uint32_t) strlen(name),
+		        symbols[i].named) != symbols[i].id) {
+			return (name);
+		}
+	}
+	for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+		const char *name = fields[i].name;
+		const char *have;
+		if (name == NULL) {
+			continue;
+		}
+		have = ts_language_field_name_for_id(lang, fields[i].id);
+		if ((have == NULL) || (strcmp(have, name) != 0)) {
+			return (name);
+		}
+	}
+	return (NULL);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TREE_SITTER_D_SYMBOLS_H_`);
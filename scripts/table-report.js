@@ -0,0 +1,199 @@
+/*
+ * Report the size of the generated parse tables.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// usage: node scripts/table-report.js [-o report.json] [-b baseline.json]
+//            [-t threshold%] src/parser.c [object or library ...]
+//
+// This extracts the table dimensions from the generated parser (the
+// STATE_COUNT, LARGE_STATE_COUNT and related macros, and the number of
+// entries in the parse, small parse, and action tables), and the size
+// of the source and of each compiled object.  Section sizes are taken
+// from size(1) when it is available; otherwise only the file size is
+// reported.
+//
+// With a baseline (an earlier report), every value is compared, and we
+// exit non-zero if any grew by more than threshold percent (default 1),
+// so that changes to the grammar's conflicts or inline rules that bloat
+// the tables do not go unnoticed.
+
+const fs = require("fs");
+const path = require("path");
+const { execFileSync } = require("child_process");
+
+function usage() {
+  console.error(
+    "usage: table-report.js [-o report.json] [-b baseline.json] " +
+      "[-t threshold%] parser.c [object ...]",
+  );
+  process.exit(2);
+}
+
+const args = process.argv.slice(2);
+let outFile;
+let baseFile;
+let threshold = 1;
+const files = [];
+while (args.length > 0) {
+  const a = args.shift();
+  if (a === "-o") {
+    outFile = args.shift();
+  } else if (a === "-b") {
+    baseFile = args.shift();
+  } else if (a === "-t") {
+    threshold = Number(args.shift());
+  } else if (a.startsWith("-")) {
+    usage();
+  } else {
+    files.push(a);
+  }
+}
+if (files.length === 0 || !(threshold >= 0)) {
+  usage();
+}
+
+const MACROS = [
+  "LANGUAGE_VERSION",
+  "STATE_COUNT",
+  "LARGE_STATE_COUNT",
+  "SYMBOL_COUNT",
+  "ALIAS_COUNT",
+  "TOKEN_COUNT",
+  "EXTERNAL_TOKEN_COUNT",
+  "FIELD_COUNT",
+  "MAX_ALIAS_SEQUENCE_LENGTH",
+  "PRODUCTION_ID_COUNT",
+];
+
+// countEntries counts the elements of a C array initializer, by counting
+// the top level commas between its braces.
+function countEntries(src, name) {
+  const start = src.search(new RegExp(`\\b${name}\\b[^=;]*=\\s*\\{`));
+  if (start < 0) {
+    return undefined;
+  }
+  let i = src.indexOf("{", start) + 1;
+  let depth = 0;
+  let count = 0;
+  let item = false;
+  for (; i < src.length; i++) {
+    const c = src[i];
+    if (c === "/" && src[i + 1] === "/") {
+      i = src.indexOf("\n", i);
+    } else if (c === "/" && src[i + 1] === "*") {
+      i = src.indexOf("*/", i) + 1;
+    } else if (c === "'" || c === '"') {
+      i = src.indexOf(c, i + 1);
+      item = true;
+    } else if (c === "(" || c === "{") {
+      depth++;
+      item = true;
+    } else if (c === ")" || c === "}") {
+      if (depth === 0) {
+        return count + (item ? 1 : 0);
+      }
+      depth--;
+    } else if (c === "," && depth === 0) {
+      count++;
+      item = false;
+    } else if (!/\s/.test(c)) {
+      item = true;
+    }
+  }
+  return undefined;
+}
+
+function parserStats(file) {
+  const src = fs.readFileSync(file, "utf8");
+  const stats = {};
+  for (const m of MACROS) {
+    const match = src.match(new RegExp(`^#define ${m} (\\d+)`, "m"));
+    if (match) {
+      stats[m] = Number(match[1]);
+    }
+  }
+  const small = countEntries(src, "ts_small_parse_table");
+  const actions = countEntries(src, "ts_parse_actions");
+  if (stats.LARGE_STATE_COUNT !== undefined && stats.SYMBOL_COUNT) {
+    stats.parse_table_entries = stats.LARGE_STATE_COUNT * stats.SYMBOL_COUNT;
+  }
+  if (small !== undefined) {
+    stats.small_parse_table_entries = small;
+  }
+  if (actions !== undefined) {
+    stats.parse_action_entries = actions;
+  }
+  // states of the main and keyword lexers together
+  stats.lex_states = (src.match(/^\s+case \d+:$/gm) || []).length;
+  stats.source_bytes = fs.statSync(file).size;
+  return stats;
+}
+
+function objectStats(file) {
+  const stats = { file_bytes: fs.statSync(file).size };
+  try {
+    // Berkeley format: text data bss dec hex filename
+    const out = execFileSync("size", [file], { encoding: "utf8" });
+    const fields = out.trim().split("\n").pop().trim().split(/\s+/);
+    stats.text = Number(fields[0]);
+    stats.data = Number(fields[1]);
+    stats.bss = Number(fields[2]);
+  } catch {
+    // size(1) is not available, or does not understand the file
+  }
+  return stats;
+}
+
+const report = { parser: parserStats(files[0]), objects: {} };
+for (const f of files.slice(1)) {
+  report.objects[path.basename(f)] = objectStats(f);
+}
+
+// flatten the report, for printing and comparison
+function flatten(r) {
+  const out = [];
+  for (const [k, v] of Object.entries(r.parser)) {
+    out.push([k, v]);
+  }
+  for (const [obj, s] of Object.entries(r.objects)) {
+    for (const [k, v] of Object.entries(s)) {
+      out.push([`${obj} ${k}`, v]);
+    }
+  }
+  return out;
+}
+
+const base = baseFile
+  ? new Map(flatten(JSON.parse(fs.readFileSync(baseFile, "utf8"))))
+  : new Map();
+
+let failed = false;
+console.log(
+  `${"measure".padEnd(40)} ${"value".padStart(12)}` +
+    (baseFile ? ` ${"baseline".padStart(12)} ${"change".padStart(8)}` : ""),
+);
+for (const [name, value] of flatten(report)) {
+  let line = `${name.padEnd(40)} ${String(value).padStart(12)}`;
+  if (base.has(name) && name !== "LANGUAGE_VERSION") {
+    const b = base.get(name);
+    const change = b === 0 ? 0 : (value - b) / b;
+    const bad = change * 100 > threshold;
+    failed ||= bad;
+    line +=
+      ` ${String(b).padStart(12)}` +
+      ` ${((change >= 0 ? "+" : "") + (change * 100).toFixed(1) + "%").padStart(8)}` +
+      (bad ? "  GREW" : "");
+  }
+  console.log(line);
+}
+
+if (outFile) {
+  fs.writeFileSync(outFile, JSON.stringify(report, null, 2) + "\n");
+}
+process.exit(failed ? 1 : 0);
@@ -1,5 +1,6 @@
 from os.path import isdir, join
 from platform import system
+from subprocess import CalledProcessError, check_output
 
 from setuptools import Extension, find_packages, setup
 from setuptools.command.build import build
@@ -22,6 +23,39 @@ class BdistWheel(bdist_wheel):
         return python, abi, platform
 
 
+def tree_sitter_runtime():
+    """Compile and link flags for the tree-sitter runtime, from pkg-config.
+
+    The runtime is only needed for parse_files, which is left out if it
+    is not installed."""
+    try:
+        cflags = check_output(["pkg-config", "--cflags", "tree-sitter"], text=True)
+        libs = check_output(["pkg-config", "--libs", "tree-sitter"], text=True)
+    except (OSError, CalledProcessError):
+        return None
+    return cflags.split(), libs.split()
+
+
+sources = [
+    "bindings/python/tree_sitter_d/binding.c",
+    "src/parser.c",
+    "src/scanner.c",
+]
+compile_args = ["-std=c11"] if system() != "Windows" else []
+link_args = []
+macros = [
+    ("Py_LIMITED_API", "0x03080000"),
+    ("PY_SSIZE_T_CLEAN", None),
+]
+
+runtime = tree_sitter_runtime()
+if runtime is not None:
+    sources.append("bindings/python/tree_sitter_d/batch.c")
+    compile_args += runtime[0]
+    link_args += runtime[1]
+    macros.append(("TREE_SITTER_D_BATCH", None))
+
+
 setup(
     packages=find_packages("bindings/python"),
     package_dir={"": "bindings/python"},
@@ -33,19 +67,11 @@ setup(
     ext_modules=[
         Extension(
             name="_binding",
-            sources=[
-                "bindings/python/tree_sitter_d/binding.c",
-                "src/parser.c",
-                # NOTE: if your language uses an external scanner, add it here.
-            ],
-            extra_compile_args=(
-                ["-std=c11"] if system() != 'Windows' else []
-            ),
-            define_macros=[
-                ("Py_LIMITED_API", "0x03080000"),
-                ("PY_SSIZE_T_CLEAN", None)
-            ],
-            include_dirs=["src"],
+            sources=sources,
+            extra_compile_args=compile_args,
+            extra_link_args=link_args,
+            define_macros=macros,
+            include_dirs=["src", "bindings/c"],
             py_limited_api=True,
         )
     ],
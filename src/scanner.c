@@ -8,12 +8,11 @@
  * SPDX-License-Identifier: MIT
  */
 #include "tree_sitter/parser.h"
+#include "charclass.h"
 #include <assert.h>
-#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <wctype.h>
 
 // NB: It is very important that two things are true.
 // First, this must match the externals in the grammar.js.
@@ -26,14 +25,101 @@ enum TokenType {
 	L_STRING, // string literal (all forms)
 	NOT_IN,
 	NOT_IS,
+	COMMENT,        // only nesting /+ +/ comments, others are internal
+	STRING_CONTEXT, // never returned, marks the inside of strings
+	ASM_BODY,       // entire body of an asm statement
+	L_STRING_CHUNK, // leading part of a long string literal
 	AFTER_EOF,
 	ERROR,
 };
 
-static bool
+// Character classification is done with the generated tables in
+// charclass.h, rather than with the C library's wide character functions,
+// which are slower, and whose results depend on the process locale.
+static inline bool
 is_eol(int c)
 {
-	return ((c == '\n') || (c == '\r') || (c == 0x2028) || (c == 0x2029));
+	return ((char_class(c) & CC_EOL) != 0);
+}
+
+static inline bool
+is_space(int c)
+{
+	return ((char_class(c) & CC_SPACE) != 0);
+}
+
+// is_space_or_eol is the common case when skipping whitespace
+static inline bool
+is_space_or_eol(int c)
+{
+	return ((char_class(c) & (CC_SPACE | CC_EOL)) != 0);
+}
+
+static inline bool
+is_alnum(int c)
+{
+	return ((char_class(c) & CC_ALNUM) != 0);
+}
+
+static inline bool
+is_digit(int c)
+{
+	return ((char_class(c) & CC_DIGIT) != 0);
+}
+
+static inline bool
+is_xdigit(int c)
+{
+	return ((char_class(c) & CC_XDIGIT) != 0);
+}
+
+// Long delimited and heredoc strings are returned in chunks of about
+// TREE_SITTER_D_STRING_CHUNK characters, each but the last one as an
+// L_STRING_CHUNK token, so that an edit inside a long string only needs
+// the chunk it falls in to be lexed again, rather than the whole string.
+// The scanner state carries what we need to resume scanning at the start
+// of the next chunk.  Define it to 0 to return each string as one token.
+#ifndef TREE_SITTER_D_STRING_CHUNK
+#define TREE_SITTER_D_STRING_CHUNK 4096
+#endif
+
+// this is an arbitrary, but reasonable limit
+// no heredoc identifiers longer than this
+#define HEREDOC_MAX 256
+
+enum string_kind {
+	STR_NONE,      // not in the middle of a string
+	STR_DELIMITED, // q"(...)" and similar
+	STR_HEREDOC,   // q"EOS ... EOS"
+};
+
+typedef struct {
+	uint8_t  kind;  // enum string_kind
+	bool     first; // delimited: no characters seen yet
+	uint32_t nest;  // delimited: nesting depth
+	int32_t  start; // delimited: opening (nesting) delimiter, or 0
+	int32_t  end;   // delimited: closing delimiter
+	uint32_t idlen; // heredoc: identifier length, with the closing quote
+	int32_t  identifier[HEREDOC_MAX + 1];
+} scanner;
+
+#define STATE_HEADER_SIZE (2 + 4 * sizeof(uint32_t))
+
+// chunk_limit returns the chunk size to use for the current string, or 0
+// if it must be returned whole, either because chunks are not valid here,
+// or because the state would not fit in the serialization buffer.  valid
+// is NULL for a string inside an opaque token string, which is always
+// matched whole.
+static unsigned
+chunk_limit(const scanner *s, const bool *valid)
+{
+	if ((TREE_SITTER_D_STRING_CHUNK == 0) || (valid == NULL) ||
+	    !valid[L_STRING_CHUNK] ||
+	    (STATE_HEADER_SIZE + (s->idlen * sizeof(int32_t)) >
+	        TREE_SITTER_SERIALIZATION_BUFFER_SIZE)) {
+		return (0);
+	}
+	return (TREE_SITTER_D_STRING_CHUNK);
 }
 
 // this looks for the optional suffix closer on various
@@ -56,57 +142,140 @@ match_string_suffix(TSLexer *lexer)
 }
 
 static bool
-match_delimited_string(TSLexer *lexer, int start, int end)
+end_string(TSLexer *lexer, scanner *s)
 {
-	int  c;
-	int  nest  = 0;
-	bool first = true;
-	lexer->advance(lexer, false); // skip opener
+	match_string_suffix(lexer);
+	lexer->result_symbol = L_STRING;
+	s->kind              = STR_NONE;
+	return (true);
+}
+
+static bool
+end_chunk(TSLexer *lexer, scanner *s, enum string_kind kind)
+{
+	lexer->mark_end(lexer);
+	lexer->result_symbol = L_STRING_CHUNK;
+	s->kind              = kind;
+	return (true);
+}
+
+// match_delimited_body scans the body of a delimited string, either just
+// after the opener, or at the start of a later chunk.
+static bool
+match_delimited_body(TSLexer *lexer, scanner *s, unsigned limit)
+{
+	int      c;
+	unsigned count = 0;
+
 	while ((c = lexer->lookahead) != 0) {
-		if (c == start && start != 0) {
+		if ((limit != 0) && (count >= limit) && !s->first) {
+			return (end_chunk(lexer, s, STR_DELIMITED));
+		}
+		if (c == s->start && s->start != 0) {
 			// nesting, increase the nest level
-			nest++;
+			s->nest++;
 		}
-		if (c == end) {
-			if (nest > 0) {
-				nest--;
-			} else if (!first) {
+		if (c == s->end) {
+			if (s->nest > 0) {
+				s->nest--;
+			} else if (!s->first) {
 				lexer->advance(lexer, false);
+				count++;
 				if ((c = lexer->lookahead) != '"') {
 					// do *not* advance, we already did
 					// this ensures e.g. }}" will work
 					continue;
 				}
 				lexer->advance(lexer, false);
-				lexer->result_symbol = L_STRING;
-				match_string_suffix(lexer);
-				return (true);
+				return (end_string(lexer, s));
 			}
 		}
-		first = false;
+		s->first = false;
 		lexer->advance(lexer, false);
+		count++;
 	}
 	return (false);
 }
 
 static bool
-match_heredoc_string(TSLexer *lexer)
+match_delimited_string(TSLexer *lexer, scanner *s, const bool *valid,
+    int start, int end)
+{
+	lexer->advance(lexer, false); // skip opener
+	s->first = true;
+	s->nest  = 0;
+	s->start = start;
+	s->end   = end;
+	s->idlen = 0;
+	return (match_delimited_body(lexer, s, chunk_limit(s, valid)));
+}
+
+// match_heredoc_body scans the lines of a heredoc string, looking for the
+// closing identifier.  Chunks always end at the start of a line, so that
+// the closing identifier is never split across two of them.
+static bool
+match_heredoc_body(
+    TSLexer *lexer, scanner *s, unsigned limit, bool line_start)
+{
+	int      c;
+	unsigned count = 0;
+	uint32_t j;
+
+	for (;;) {
+		if (line_start) {
+			bool chunk = (limit != 0) && (count >= limit);
+			if (chunk) {
+				lexer->mark_end(lexer);
+			}
+			j = 0;
+			while (((c = lexer->lookahead) != 0) &&
+			    (j < s->idlen)) {
+				if (c != s->identifier[j]) {
+					// no match
+					break;
+				}
+				lexer->advance(lexer, false);
+				j++;
+			}
+			if (j == s->idlen) {
+				// skip the quote
+				return (end_string(lexer, s));
+			}
+			if (chunk) {
+				// end was marked at the start of the line
+				lexer->result_symbol = L_STRING_CHUNK;
+				s->kind              = STR_HEREDOC;
+				return (true);
+			}
+			count += j;
+		}
+		while (((c = lexer->lookahead) != 0) && !is_eol(c)) {
+			lexer->advance(lexer, false);
+			count++;
+		}
+		if (c == 0) {
+			return (false);
+		}
+		lexer->advance(lexer, false); // advance past the newline
+		count++;
+		line_start = true;
+	}
+}
+
+static bool
+match_heredoc_string(TSLexer *lexer, scanner *s, const bool *valid)
 {
-	// this is an arbitrary, but reasonable limit
-	// no identifiers longer than this
-	int    identifier[256 + 2]; // +2 for closing " and null
-	size_t i = 0;
-	size_t j;
-	int    c;
+	uint32_t i = 0;
+	int      c;
 
 	// get the delimiter
-	while (i < (sizeof(identifier) - 2)) {
+	while (i < HEREDOC_MAX) {
 		c = lexer->lookahead;
 		// technically should not start with a digit, but we allow
-		if (is_eol(c) || ((!iswalnum(c)) && (c != '_'))) {
+		if (is_eol(c) || ((!is_alnum(c)) && (c != '_'))) {
 			break;
 		}
-		identifier[i++] = c;
+		s->identifier[i++] = c;
 		lexer->advance(lexer, false);
 	}
 	if (i == 0) {
@@ -114,33 +283,50 @@ match_heredoc_string(TSLexer *lexer)
 	}
 	// inject the closing quote at the end of the identifier
 	// this makes our logic below simpler
-	identifier[i++] = '"';
-	identifier[i]   = 0;
+	s->identifier[i++] = '"';
+	s->idlen           = i;
+	return (match_heredoc_body(lexer, s, chunk_limit(s, valid), false));
+}
 
-	while ((c = lexer->lookahead) != 0) {
-		while ((!is_eol(c)) && (c != 0)) {
-			lexer->advance(lexer, false);
-			c = lexer->lookahead;
-		}
-		lexer->advance(lexer, false); // advance past the newline
+// match_q_string matches a delimited or heredoc string, whose leading q"
+// has already been consumed.
+static bool
+match_q_string(TSLexer *lexer, scanner *s, const bool *valid)
+{
+	int c;
 
-		j = 0;
-		while (((c = lexer->lookahead) != 0) && (j < i)) {
-			if (c != identifier[j]) {
-				// no match
-				break;
-			}
-			lexer->advance(lexer, false);
-			j++;
-		}
-		if (j == i) {
-			// skip the quote
-			match_string_suffix(lexer);
-			lexer->result_symbol = L_STRING;
-			return (true);
+	switch ((c = lexer->lookahead)) {
+	case '(':
+		return (match_delimited_string(lexer, s, valid, '(', ')'));
+	case '[':
+		return (match_delimited_string(lexer, s, valid, '[', ']'));
+	case '{':
+		return (match_delimited_string(lexer, s, valid, '{', '}'));
+	case '<':
+		return (match_delimited_string(lexer, s, valid, '<', '>'));
+	default:
+		if (is_alnum(c) || c == '_') {
+			return (match_heredoc_string(lexer, s, valid));
 		}
+		// non-nesting delimited string
+		return (match_delimited_string(lexer, s, valid, 0, c));
 	}
-	return (false);
+}
+
+// match_string_chunk continues a string that was left unfinished by the
+// last L_STRING_CHUNK token.
+static bool
+match_string_chunk(TSLexer *lexer, scanner *s, const bool *valid)
+{
+	unsigned limit = chunk_limit(s, valid);
+
+	if (!valid[L_STRING] && !valid[L_STRING_CHUNK]) {
+		return (false);
+	}
+	if (s->kind == STR_HEREDOC) {
+		return (match_heredoc_body(lexer, s, limit, true));
+	}
+	return (match_delimited_body(lexer, s, limit));
 }
 
 static bool
@@ -156,7 +342,7 @@ match_directive(TSLexer *lexer, const bool *valid)
 	if (c == '!') {
 		return (false);
 	}
-	while ((iswspace(c) || is_eol(c)) && (c)) {
+	while (is_space_or_eol(c)) {
 		if (is_eol(c)) {
 			return (false);
 		}
@@ -175,6 +361,240 @@ match_directive(TSLexer *lexer, const bool *valid)
 	return (true);
 }
 
+// skip_nesting_comment is called after the opening /+ has been consumed,
+// and advances past the matching +/.
+static bool
+skip_nesting_comment(TSLexer *lexer)
+{
+	int      c;
+	unsigned depth = 1;
+
+	while ((c = lexer->lookahead) != 0) {
+		lexer->advance(lexer, false);
+		if ((c == '/') && (lexer->lookahead == '+')) {
+			lexer->advance(lexer, false);
+			depth++;
+		} else if ((c == '+') && (lexer->lookahead == '/')) {
+			lexer->advance(lexer, false);
+			if (--depth == 0) {
+				return (true);
+			}
+		}
+	}
+	return (false); // unterminated
+}
+
+// Nesting comments are handled here, because they can nest to any depth,
+// which cannot be expressed as a regular expression.  We only match the
+// /+ form; for // and /* comments we return false, and the internal lexer
+// handles them instead.
+static bool
+match_nesting_comment(TSLexer *lexer)
+{
+	assert(lexer->lookahead == '/');
+	lexer->advance(lexer, false);
+	if (lexer->lookahead != '+') {
+		return (false);
+	}
+	lexer->advance(lexer, false);
+	if (!skip_nesting_comment(lexer)) {
+		return (false);
+	}
+	lexer->mark_end(lexer);
+	lexer->result_symbol = COMMENT;
+	return (true);
+}
+
+// skip_quoted advances past the closing quote of a string or character
+// literal, whose opening quote has already been consumed.
+static inline bool
+skip_quoted(TSLexer *lexer, int quote, bool escapes)
+{
+	int c;
+	while ((c = lexer->lookahead) != 0) {
+		lexer->advance(lexer, false);
+		if ((c == '\\') && escapes) {
+			if (lexer->lookahead == 0) {
+				break;
+			}
+			lexer->advance(lexer, false);
+		} else if (c == quote) {
+			return (true);
+		}
+	}
+	return (false);
+}
+
+// skip_comment skips a comment of any form, and is called after the
+// leading '/' has been consumed.  It returns false if the comment is
+// unterminated, or if there is no comment here at all.
+static inline bool
+skip_comment(TSLexer *lexer)
+{
+	int c;
+	switch (lexer->lookahead) {
+	case '/':
+		while (((c = lexer->lookahead) != 0) && !is_eol(c)) {
+			lexer->advance(lexer, false);
+		}
+		return (true);
+	case '*':
+		lexer->advance(lexer, false);
+		while ((c = lexer->lookahead) != 0) {
+			lexer->advance(lexer, false);
+			if ((c == '*') && (lexer->lookahead == '/')) {
+				lexer->advance(lexer, false);
+				return (true);
+			}
+		}
+		return (false);
+	case '+':
+		lexer->advance(lexer, false);
+		return (skip_nesting_comment(lexer));
+	}
+	return (false);
+}
+
+static inline bool
+is_comment_start(int c)
+{
+	return ((c == '/') || (c == '*') || (c == '+'));
+}
+
+#ifdef TREE_SITTER_D_OPAQUE_TOKEN_STRINGS
+// match_token_string matches an entire q{ ... } token string as a single
+// string token, instead of letting the grammar produce a node for every
+// token inside it.  This is only done when built with
+// TREE_SITTER_D_OPAQUE_TOKEN_STRINGS, as it changes the shape of the tree.
+// Braces inside of string literals, character literals, and comments do
+// not count towards the nesting.  (The 'q' has already been consumed.)
+static bool
+match_token_string(TSLexer *lexer, scanner *s)
+{
+	int      c;
+	int      prev  = 'q';
+	unsigned word  = 1; // length of the identifier that ends at prev
+	unsigned depth = 0;
+
+	assert(lexer->lookahead == '{');
+	while ((c = lexer->lookahead) != 0) {
+		lexer->advance(lexer, false);
+		switch (c) {
+		case '{':
+			depth++;
+			break;
+		case '}':
+			if (--depth == 0) {
+				lexer->result_symbol = L_STRING;
+				lexer->mark_end(lexer);
+				return (true);
+			}
+			break;
+		case '"':
+			if ((word == 1) && (prev == 'q')) {
+				// q"(...)" and q"EOS ... EOS" have their own
+				// ends, and never any escapes
+				if (!match_q_string(lexer, s, NULL)) {
+					return (false);
+				}
+				break;
+			}
+			// r"..." strings are WYSIWYG, the others have escapes
+			if (!skip_quoted(
+			        lexer, '"', (word != 1) || (prev != 'r'))) {
+				return (false);
+			}
+			break;
+		case '`':
+			if (!skip_quoted(lexer, '`', false)) {
+				return (false);
+			}
+			break;
+		case '\'':
+			if (!skip_quoted(lexer, '\'', true)) {
+				return (false);
+			}
+			break;
+		case '/':
+			if (is_comment_start(lexer->lookahead) &&
+			    !skip_comment(lexer)) {
+				return (false);
+			}
+			break;
+		}
+		word = (is_alnum(c) || (c == '_')) ? word + 1 : 0;
+		prev = c;
+	}
+	return (false);
+}
+#endif // TREE_SITTER_D_OPAQUE_TOKEN_STRINGS
+
+#ifndef TREE_SITTER_D_DETAILED_ASM
+// match_asm_body matches the whole body of an asm statement (everything
+// between the braces) as a single token.  The contents of inline assembly
+// are compiler and CPU specific, and we do not validate them, so a node
+// for each token in the body is of little use, and costs a lot of memory
+// in sources with large amounts of assembly.  Comments in the middle of
+// the body are part of the token, but trailing ones are left to be lexed
+// as comments.  Build with TREE_SITTER_D_DETAILED_ASM for the token nodes.
+static bool
+match_asm_body(TSLexer *lexer)
+{
+	int      c;
+	unsigned depth = 0;
+	bool     empty = true;
+
+	while ((c = lexer->lookahead) != 0) {
+		if (is_space_or_eol(c)) {
+			lexer->advance(lexer, false);
+			continue;
+		}
+		if ((c == '}') && (depth == 0)) {
+			break;
+		}
+		lexer->advance(lexer, false);
+		switch (c) {
+		case '{':
+			depth++;
+			break;
+		case '}':
+			depth--;
+			break;
+		case '"':
+			if (!skip_quoted(lexer, '"', true)) {
+				return (false);
+			}
+			break;
+		case '`':
+			if (!skip_quoted(lexer, '`', false)) {
+				return (false);
+			}
+			break;
+		case '\'':
+			if (!skip_quoted(lexer, '\'', true)) {
+				return (false);
+			}
+			break;
+		case '/':
+			if (is_comment_start(lexer->lookahead)) {
+				if (!skip_comment(lexer)) {
+					return (false);
+				}
+				continue; // comments do not extend the token
+			}
+			break;
+		}
+		empty = false;
+		lexer->mark_end(lexer);
+	}
+	if (empty || (c == 0)) {
+		return (false);
+	}
+	lexer->result_symbol = ASM_BODY;
+	return (true);
+}
+#endif // TREE_SITTER_D_DETAILED_ASM
+
 static bool
 match_number_suffix(TSLexer *lexer, const bool *valid, bool is_float)
 {
@@ -237,7 +657,7 @@ match_number_suffix(TSLexer *lexer, const bool *valid, bool is_float)
 	}
 
 	// what follows the suffix must *NOT* be digit or a number.
-	if (iswalnum(c) || (c > 0x7f && !is_eol(c))) {
+	if (is_alnum(c) || (c > 0x7f && !is_eol(c))) {
 		return (false);
 	}
 	if (is_float) {
@@ -284,7 +704,7 @@ match_number(TSLexer *lexer, const bool *valid)
 		// something that is not a valid number (and thus the sole dot
 		// might apply from above).  Note that underscores are *not*
 		// permitted as the first character after the decimal point.
-		if (!iswdigit(c)) {
+		if (!is_digit(c)) {
 			return (false);
 		}
 		has_dot = true;
@@ -320,7 +740,7 @@ match_number(TSLexer *lexer, const bool *valid)
 	bool done = false;
 	while (((next = lexer->lookahead) != 0) && (!done)) {
 		c    = next;
-		if ((c > 0x7f) || iswspace(c) || (c == ';')) {
+		if ((c > 0x7f) || is_space(c) || (c == ';')) {
 			// optimization: not a valid number, that ends the
 			// sequence
 			break;
@@ -330,8 +750,8 @@ match_number(TSLexer *lexer, const bool *valid)
 			lexer->mark_end(lexer);
 			has_digit = true;
 			continue;
-		} else if (iswdigit(c) ||
-		    (is_hex && (!in_exp) && (iswxdigit(c)))) {
+		} else if (is_digit(c) ||
+		    (is_hex && (!in_exp) && (is_xdigit(c)))) {
 			lexer->advance(lexer, false);
 			lexer->mark_end(lexer);
 			has_digit = true;
@@ -355,7 +775,7 @@ match_number(TSLexer *lexer, const bool *valid)
 			c = lexer->lookahead;
 			// if the next character is a valid digit (note that
 			// binary doesn't support this, then we're good
-			if (iswdigit(c) || (is_hex && iswxdigit(c))) {
+			if (is_digit(c) || (is_hex && is_xdigit(c))) {
 				has_dot = true;
 				continue;
 			}
@@ -365,7 +785,7 @@ match_number(TSLexer *lexer, const bool *valid)
 			// make it a floating point number. Note that lone
 			// trailing periods like 1. are nuts, but this is what
 			// DMD does.
-			if (iswalnum(c) || c == '_' || c == '.' ||
+			if (is_alnum(c) || c == '_' || c == '.' ||
 			    (c > 0x7f && !is_eol(c))) {
 				// its something like ._property or somesuch
 				// in that case we just want the original int,
@@ -427,7 +847,7 @@ match_not_in_is(TSLexer *lexer, const bool *valid)
     lexer->advance(lexer, false);
     // eat intervening whitespace... usually there isn't any
     while ((c = lexer->lookahead) != 0) {
-        if (!iswspace(c) && !is_eol(c)) {
+        if (!is_space_or_eol(c)) {
             break;
         }
         lexer->advance(lexer, false);
@@ -452,7 +872,7 @@ match_not_in_is(TSLexer *lexer, const bool *valid)
     }
     lexer->advance(lexer, false);
     c = lexer->lookahead;
-    if (iswalnum(c) || ((c > 0x7F) && (!is_eol(c)))) {
+    if (is_alnum(c) || ((c > 0x7F) && (!is_eol(c)))) {
         return (false);
     }
     lexer->result_symbol = token;
@@ -463,32 +883,87 @@ match_not_in_is(TSLexer *lexer, const bool *valid)
 void *
 tree_sitter_d_external_scanner_create()
 {
-	return (NULL);
+	return (calloc(1, sizeof(scanner)));
 }
 
 void
 tree_sitter_d_external_scanner_destroy(void *arg)
 {
+	free(arg);
 }
 
+// The scanner is stateless, except in the middle of a long string, so
+// there is usually nothing to save.
 unsigned
 tree_sitter_d_external_scanner_serialize(void *arg, char *buffer)
 {
-	return (0); // we are completely stateless! :-)
+	scanner *s = arg;
+	unsigned n = 0;
+	uint32_t v[4];
+
+	if (s->kind == STR_NONE) {
+		return (0);
+	}
+	v[0]        = s->nest;
+	v[1]        = (uint32_t) s->start;
+	v[2]        = (uint32_t) s->end;
+	v[3]        = s->idlen;
+	buffer[n++] = (char) s->kind;
+	buffer[n++] = (char) s->first;
+	memcpy(buffer + n, v, sizeof(v));
+	n += sizeof(v);
+	memcpy(buffer + n, s->identifier, s->idlen * sizeof(int32_t));
+	n += s->idlen * sizeof(int32_t);
+	return (n);
 }
 
 void
 tree_sitter_d_external_scanner_deserialize(
     void *arg, const char *buffer, unsigned length)
 {
+	scanner *s = arg;
+	uint32_t v[4];
+
+	if (length < STATE_HEADER_SIZE) {
+		s->kind  = STR_NONE;
+		s->idlen = 0;
+		return;
+	}
+	memcpy(v, buffer + 2, sizeof(v));
+	s->kind  = (uint8_t) buffer[0];
+	s->first = buffer[1] != 0;
+	s->nest  = v[0];
+	s->start = (int32_t) v[1];
+	s->end   = (int32_t) v[2];
+	s->idlen = v[3];
+	if ((s->idlen > HEREDOC_MAX + 1) ||
+	    (length != STATE_HEADER_SIZE + s->idlen * sizeof(int32_t))) {
+		s->kind  = STR_NONE;
+		s->idlen = 0;
+		return;
+	}
+	memcpy(s->identifier, buffer + STATE_HEADER_SIZE,
+	    s->idlen * sizeof(int32_t));
 }
 
 bool
 tree_sitter_d_external_scanner_scan(
     void *arg, TSLexer *lexer, const bool *valid)
 {
-	int  c             = lexer->lookahead;
-	bool start_of_line = lexer->get_column(lexer) == 0;
+	scanner *s             = arg;
+	int      c             = lexer->lookahead;
+	bool     start_of_line = lexer->get_column(lexer) == 0;
+
+	// The rest of a long string that we have already started.
+	if (s->kind != STR_NONE) {
+		return (match_string_chunk(lexer, s, valid));
+	}
+
+	// The body of a string is not ours to lex.  (All symbols are valid
+	// during error recovery, so the string context means nothing then.)
+	if (valid[STRING_CONTEXT] && !valid[ERROR]) {
+		return (false);
+	}
 
 	if (valid[AFTER_EOF] && !valid[ERROR]) {
 	   while (lexer->lookahead != 0) {
@@ -500,7 +975,7 @@ tree_sitter_d_external_scanner_scan(
 	}
 
 	// consume whitespace -- we also skip newlines here
-	while ((iswspace(c) || is_eol(c)) && (c)) {
+	while (is_space_or_eol(c)) {
 		if (is_eol(c)) {
 			start_of_line = true;
 		}
@@ -518,7 +993,17 @@ tree_sitter_d_external_scanner_scan(
 		return (false);
 	}
 
-	if (c == '.' || isdigit(c)) {
+	if ((c == '/') && valid[COMMENT]) {
+		return (match_nesting_comment(lexer));
+	}
+
+#ifndef TREE_SITTER_D_DETAILED_ASM
+	if (valid[ASM_BODY] && !valid[ERROR]) {
+		return (match_asm_body(lexer));
+	}
+#endif
+
+	if (c == '.' || is_digit(c)) {
 		return (match_number(lexer, valid));
 	}
 
@@ -531,26 +1016,16 @@ tree_sitter_d_external_scanner_scan(
 
 	if ((c == 'q') && (valid[L_STRING])) {
 		lexer->advance(lexer, false);
+#ifdef TREE_SITTER_D_OPAQUE_TOKEN_STRINGS
+		if (lexer->lookahead == '{') {
+			return (match_token_string(lexer, s));
+		}
+#endif
 		if (lexer->lookahead != '"') {
 			return (false);
 		}
 		lexer->advance(lexer, false);
-		switch ((c = lexer->lookahead)) {
-		case '(':
-			return (match_delimited_string(lexer, '(', ')'));
-		case '[':
-			return (match_delimited_string(lexer, '[', ']'));
-		case '{':
-			return (match_delimited_string(lexer, '{', '}'));
-		case '<':
-			return (match_delimited_string(lexer, '<', '>'));
-		default:;
-			if (iswalnum(c) || c == '_') {
-				return (match_heredoc_string(lexer));
-			}
-			// non-nesting deliimted string
-			return (match_delimited_string(lexer, 0, c));
-		}
+		return (match_q_string(lexer, s, valid));
 	}
 
 	return (false);
@@ -0,0 +1,508 @@
+/*
+ * Walking only the active branches of conditional compilation.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// The grammar keeps every branch of a conditional, with the condition,
+// the first branch, and then "else" and the second branch as children of
+// one conditional_declaration (or conditional_statement) node.  The walk
+// decides each condition when it reaches the node, and then skips the
+// children on the inactive side of the else.  Chains such as
+// "else version (OSX)" are conditionals nested in the second branch, so
+// they need nothing special.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tree-sitter-d-conditions.h"
+
+enum sym {
+	S_CONDITIONAL_DECLARATION,
+	S_CONDITIONAL_STATEMENT,
+	S_CONDITION,
+	S_VERSION_CONDITION,
+	S_DEBUG_CONDITION,
+	S_STATIC_IF_CONDITION,
+	S_VERSION_SPECIFICATION,
+	S_DEBUG_SPECIFICATION,
+	S_ELSE,
+	S_EXPRESSION,
+	S_TRUE,
+	S_FALSE,
+	S_INT_LITERAL,
+	S_VERSION,
+	S_DEBUG,
+	S_COUNT,
+};
+
+static const char *sym_names[S_COUNT] = {
+	[S_CONDITIONAL_DECLARATION] = "conditional_declaration",
+	[S_CONDITIONAL_STATEMENT]   = "conditional_statement",
+	[S_CONDITION]               = "condition",
+	[S_VERSION_CONDITION]       = "version_condition",
+	[S_DEBUG_CONDITION]         = "debug_condition",
+	[S_STATIC_IF_CONDITION]     = "static_if_condition",
+	[S_VERSION_SPECIFICATION]   = "version_specification",
+	[S_DEBUG_SPECIFICATION]     = "debug_specification",
+	[S_ELSE]                    = "else",
+	[S_EXPRESSION]              = "expression",
+	[S_TRUE]                    = "true",
+	[S_FALSE]                   = "false",
+	[S_INT_LITERAL]             = "int_literal",
+	[S_VERSION]                 = "version",
+	[S_DEBUG]                   = "debug",
+};
+
+typedef struct {
+	char  **names;
+	size_t  n;
+	unsigned level;
+} ident_set;
+
+struct ts_d_config {
+	TSSymbol  syms[S_COUNT];
+	ident_set versions;
+	ident_set debugs;
+};
+
+// The state of a node during a walk.  For a conditional, it is which
+// branches are active, and how far through its children the walk is.
+enum {
+	ST_THEN      = 0x1, // first branch active
+	ST_ELSE      = 0x2, // second branch active
+	ST_COND      = 0x4, // a conditional node
+	ST_SEEN_COND = 0x8, // its condition has been visited
+	ST_SEEN_ELSE = 0x10,
+};
+
+typedef struct {
+	const ts_d_config *cfg;
+	const char        *src;
+	ts_d_walk_cb       cb;
+	ts_d_walk_cb       skip;
+	void              *arg;
+	uint8_t           *state; // of the node at each depth
+	uint32_t           cap;
+	ident_set          versions; // specified in the source
+	ident_set          debugs;
+	bool               nomem;
+} walker;
+
+static bool
+set_add(ident_set *s, const char *name, size_t len)
+{
+	char **nn;
+	char  *dup;
+
+	if ((dup = malloc(len + 1)) == NULL) {
+		return (false);
+	}
+	if ((nn = realloc(s->names, (s->n + 1) * sizeof(char *))) == NULL) {
+		free(dup);
+		return (false);
+	}
+	memcpy(dup, name, len);
+	dup[len]       = 0;
+	s->names       = nn;
+	s->names[s->n] = dup;
+	s->n++;
+	return (true);
+}
+
+static bool
+set_has(const ident_set *s, const char *name, size_t len)
+{
+	for (size_t i = 0; i < s->n; i++) {
+		if ((strncmp(s->names[i], name, len) == 0) &&
+		    (s->names[i][len] == 0)) {
+			return (true);
+		}
+	}
+	return (false);
+}
+
+static void
+set_free(ident_set *s)
+{
+	for (size_t i = 0; i < s->n; i++) {
+		free(s->names[i]);
+	}
+	free(s->names);
+	memset(s, 0, sizeof(*s));
+}
+
+ts_d_config *
+ts_d_config_new(const TSLanguage *language)
+{
+	ts_d_config *c;
+
+	if ((c = calloc(1, sizeof(*c))) == NULL) {
+		return (NULL);
+	}
+	for (int i = 0; i < S_COUNT; i++) {
+		const char *name = sym_names[i];
+		uint32_t    len  = (uint32_t) strlen(name);
+		c->syms[i] =
+		    ts_language_symbol_for_name(language, name, len, true);
+		if (c->syms[i] == 0) {
+			ts_d_config_delete(c);
+			return (NULL);
+		}
+	}
+	return (c);
+}
+
+void
+ts_d_config_delete(ts_d_config *c)
+{
+	if (c != NULL) {
+		set_free(&c->versions);
+		set_free(&c->debugs);
+		free(c);
+	}
+}
+
+bool
+ts_d_config_version(ts_d_config *c, const char *ident)
+{
+	return (set_add(&c->versions, ident, strlen(ident)));
+}
+
+bool
+ts_d_config_debug(ts_d_config *c, const char *ident)
+{
+	return (set_add(&c->debugs, ident, strlen(ident)));
+}
+
+void
+ts_d_config_debug_level(ts_d_config *c, unsigned level)
+{
+	c->debugs.level = level;
+}
+
+static inline bool
+is(const walker *w, TSNode node, enum sym s)
+{
+	return (ts_node_symbol(node) == w->cfg->syms[s]);
+}
+
+// argument returns the named child that follows the keyword of a version
+// or debug condition or specification, if any.
+static bool
+argument(const walker *w, TSNode node, TSNode *argp)
+{
+	uint32_t n = ts_node_named_child_count(node);
+	for (uint32_t i = 0; i < n; i++) {
+		TSNode c = ts_node_named_child(node, i);
+		if (!is(w, c, S_VERSION) && !is(w, c, S_DEBUG) &&
+		    !ts_node_is_extra(c)) {
+			*argp = c;
+			return (true);
+		}
+	}
+	return (false);
+}
+
+static unsigned
+int_value(const walker *w, TSNode node)
+{
+	unsigned v   = 0;
+	uint32_t end = ts_node_end_byte(node);
+
+	for (uint32_t i = ts_node_start_byte(node); i < end; i++) {
+		char ch = w->src[i];
+		if ((ch >= '0') && (ch <= '9')) {
+			v = (v * 10) + (unsigned) (ch - '0');
+		} else if (ch != '_') {
+			break;
+		}
+	}
+	return (v);
+}
+
+static bool
+in_set(const walker *w, const ident_set *cfg, const ident_set *local,
+    TSNode node)
+{
+	const char *name = w->src + ts_node_start_byte(node);
+	size_t      len  = ts_node_end_byte(node) - ts_node_start_byte(node);
+	return (set_has(cfg, name, len) || set_has(local, name, len));
+}
+
+// decide returns which branches of a conditional are active.
+static uint8_t
+decide(const walker *w, TSNode node)
+{
+	uint32_t n = ts_node_named_child_count(node);
+	TSNode   cond;
+	TSNode   arg;
+	unsigned level;
+
+	for (uint32_t i = 0;; i++) {
+		if (i == n) {
+			return (ST_THEN | ST_ELSE);
+		}
+		cond = ts_node_named_child(node, i);
+		if (is(w, cond, S_CONDITION)) {
+			break;
+		}
+	}
+	if (ts_node_named_child_count(cond) == 0) {
+		return (ST_THEN | ST_ELSE);
+	}
+	cond = ts_node_named_child(cond, 0);
+
+	if (is(w, cond, S_VERSION_CONDITION)) {
+		const char *name;
+		size_t      len;
+		if (!argument(w, cond, &arg) || is(w, arg, S_INT_LITERAL)) {
+			return (ST_THEN | ST_ELSE);
+		}
+		name = w->src + ts_node_start_byte(arg);
+		len  = ts_node_end_byte(arg) - ts_node_start_byte(arg);
+		if ((len == 3) && (memcmp(name, "all", 3) == 0)) {
+			return (ST_THEN);
+		}
+		if ((len == 4) && (memcmp(name, "none", 4) == 0)) {
+			return (ST_ELSE);
+		}
+		return (in_set(w, &w->cfg->versions, &w->versions, arg)
+		        ? ST_THEN
+		        : ST_ELSE);
+	}
+	if (is(w, cond, S_DEBUG_CONDITION)) {
+		level = w->cfg->debugs.level > w->debugs.level
+		    ? w->cfg->debugs.level
+		    : w->debugs.level;
+		if (!argument(w, cond, &arg)) {
+			return (level > 0 ? ST_THEN : ST_ELSE);
+		}
+		if (is(w, arg, S_INT_LITERAL)) {
+			return ((int_value(w, arg) <= level) ? ST_THEN
+			                                     : ST_ELSE);
+		}
+		return (in_set(w, &w->cfg->debugs, &w->debugs, arg)
+		        ? ST_THEN
+		        : ST_ELSE);
+	}
+	if (is(w, cond, S_STATIC_IF_CONDITION)) {
+		n = ts_node_named_child_count(cond);
+		for (uint32_t i = 0; i < n; i++) {
+			TSNode e = ts_node_named_child(cond, i);
+			if (!is(w, e, S_EXPRESSION) ||
+			    (ts_node_named_child_count(e) != 1)) {
+				continue;
+			}
+			e = ts_node_named_child(e, 0);
+			if (is(w, e, S_TRUE)) {
+				return (ST_THEN);
+			}
+			if (is(w, e, S_FALSE)) {
+				return (ST_ELSE);
+			}
+		}
+	}
+	return (ST_THEN | ST_ELSE);
+}
+
+// specify records a version or debug specification in active code.
+static void
+specify(walker *w, TSNode node, ident_set *set)
+{
+	TSNode arg;
+
+	if (!argument(w, node, &arg)) {
+		return;
+	}
+	if (is(w, arg, S_INT_LITERAL)) {
+		unsigned v = int_value(w, arg);
+		if (v > set->level) {
+			set->level = v;
+		}
+	} else if (!set_add(set, w->src + ts_node_start_byte(arg),
+	               ts_node_end_byte(arg) - ts_node_start_byte(arg))) {
+		w->nomem = true;
+	}
+}
+
+// active checks a child of a conditional, updating its parent's state.
+static bool
+active(const walker *w, uint8_t *parent, TSNode node)
+{
+	if (!(*parent & ST_COND)) {
+		return (true);
+	}
+	if (!(*parent & ST_SEEN_COND)) {
+		// attributes before the condition apply to both branches
+		if (is(w, node, S_CONDITION)) {
+			*parent |= ST_SEEN_COND;
+		}
+		return (true);
+	}
+	if (!(*parent & ST_SEEN_ELSE) && is(w, node, S_ELSE)) {
+		*parent |= ST_SEEN_ELSE;
+		return (true);
+	}
+	if (!ts_node_is_named(node) || ts_node_is_extra(node)) {
+		return (true); // braces, colons, and comments
+	}
+	return ((*parent & ST_SEEN_ELSE) ? (*parent & ST_ELSE)
+	                                 : (*parent & ST_THEN));
+}
+
+static bool
+walk(walker *w, TSNode node)
+{
+	TSTreeCursor cursor = ts_tree_cursor_new(node);
+	uint32_t     depth  = 0;
+
+	for (;;) {
+		TSNode  n       = ts_tree_cursor_current_node(&cursor);
+		bool    descend = false;
+		uint8_t st      = 0;
+
+		if ((depth == 0) || active(w, &w->state[depth - 1], n)) {
+			descend = w->cb(n, w->arg);
+			if (is(w, n, S_CONDITIONAL_DECLARATION) ||
+			    is(w, n, S_CONDITIONAL_STATEMENT)) {
+				st = ST_COND | decide(w, n);
+			} else if (is(w, n, S_VERSION_SPECIFICATION)) {
+				specify(w, n, &w->versions);
+			} else if (is(w, n, S_DEBUG_SPECIFICATION)) {
+				specify(w, n, &w->debugs);
+			}
+		} else if (w->skip != NULL) {
+			w->skip(n, w->arg);
+		}
+		if (w->nomem) {
+			break;
+		}
+		if (depth >= w->cap) {
+			uint32_t ncap = w->cap ? w->cap * 2 : 64;
+			uint8_t *ns   = realloc(w->state, ncap);
+			if (ns == NULL) {
+				w->nomem = true;
+				break;
+			}
+			w->state = ns;
+			w->cap   = ncap;
+		}
+		w->state[depth] = st;
+		if (descend && ts_tree_cursor_goto_first_child(&cursor)) {
+			depth++;
+			continue;
+		}
+		while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+			if ((depth == 0) ||
+			    !ts_tree_cursor_goto_parent(&cursor)) {
+				goto done;
+			}
+			depth--;
+		}
+	}
+done:
+	ts_tree_cursor_delete(&cursor);
+	free(w->state);
+	set_free(&w->versions);
+	set_free(&w->debugs);
+	return (!w->nomem);
+}
+
+bool
+ts_d_walk(const ts_d_config *cfg, TSNode node, const char *src,
+    ts_d_walk_cb cb, void *arg)
+{
+	walker w;
+
+	memset(&w, 0, sizeof(w));
+	w.cfg = cfg;
+	w.src = src;
+	w.cb  = cb;
+	w.arg = arg;
+	return (walk(&w, node));
+}
+
+typedef struct {
+	TSRange *ranges;
+	uint32_t n;
+	uint32_t cap;
+	bool     nomem;
+} range_list;
+
+static bool
+descend_all(TSNode node, void *arg)
+{
+	(void) node;
+	(void) arg;
+	return (true);
+}
+
+static bool
+add_range(TSNode node, void *arg)
+{
+	range_list *l = arg;
+	TSRange    *r;
+
+	if (l->n == l->cap) {
+		uint32_t ncap = l->cap ? l->cap * 2 : 16;
+		TSRange *nr   = realloc(l->ranges, ncap * sizeof(TSRange));
+		if (nr == NULL) {
+			l->nomem = true;
+			return (false);
+		}
+		l->ranges = nr;
+		l->cap    = ncap;
+	}
+	r              = &l->ranges[l->n++];
+	r->start_byte  = ts_node_start_byte(node);
+	r->end_byte    = ts_node_end_byte(node);
+	r->start_point = ts_node_start_point(node);
+	r->end_point   = ts_node_end_point(node);
+	return (false);
+}
+
+int64_t
+ts_d_inactive_ranges(const ts_d_config *cfg, TSNode node, const char *src,
+    TSRange **rangesp)
+{
+	walker     w;
+	range_list l = { 0 };
+
+	memset(&w, 0, sizeof(w));
+	w.cfg  = cfg;
+	w.src  = src;
+	w.cb   = descend_all;
+	w.skip = add_range;
+	w.arg  = &l;
+	if (!walk(&w, node) || l.nomem) {
+		free(l.ranges);
+		*rangesp = NULL;
+		return (-1);
+	}
+	*rangesp = l.ranges;
+	return (l.n);
+}
+
+bool
+ts_d_in_ranges(const TSRange *ranges, uint32_t n, uint32_t byte)
+{
+	uint32_t lo = 0;
+	uint32_t hi = n;
+
+	// the ranges are disjoint and in order, so the last range starting
+	// at or before byte is the only one that may hold it
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (ranges[mid].start_byte <= byte) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return ((lo > 0) && (byte < ranges[lo - 1].end_byte));
+}
@@ -0,0 +1,550 @@
+/*
+ * Native tag extraction for D trees.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// This finds the same definitions and references as queries/tags.scm,
+// with a single walk of the tree rather than the query engine.  Each
+// node's symbol is looked up in a table that says which pattern (if any)
+// it is the root of, and that pattern is then checked against the
+// node's children directly.  Where the pattern names a field, every
+// child in that field is tried, as a field may hold more than one node
+// (the function of ".foo()" is both the "." and the identifier).
+//
+// The checks follow the query semantics exactly: child patterns match
+// visible children in order, but not necessarily adjacent, and a field
+// matches only children with that field.  Any change to
+// tags.scm must be made here as well; test/tags_test.c compares the two.
+// The walk may also be limited to active code (see conditions.c).
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tree-sitter-d-conditions.h"
+#include "tree-sitter-d-tags.h"
+
+enum role {
+	R_NONE,
+	R_MODULE_DEF,
+	R_STRUCT,
+	R_INTERFACE,
+	R_ENUM,
+	R_CLASS,
+	R_UNION,
+	R_THIS, // constructor, destructor, and postblit
+	R_MANIFEST_DECLARATOR,
+	R_FUNCTION,
+	R_ANONYMOUS_ENUM,
+	R_CALL,
+	R_PARAMETER,
+	R_VARIABLE,
+	R_ALIAS,
+};
+
+// symbols used by the patterns
+enum sym {
+	S_MODULE_DEF,
+	S_MODULE_DECLARATION,
+	S_MODULE_FQN,
+	S_STRUCT_DECLARATION,
+	S_INTERFACE_DECLARATION,
+	S_ENUM_DECLARATION,
+	S_CLASS_DECLARATION,
+	S_UNION_DECLARATION,
+	S_CONSTRUCTOR,
+	S_DESTRUCTOR,
+	S_POSTBLIT,
+	S_THIS,
+	S_MANIFEST_DECLARATOR,
+	S_FUNCTION_DECLARATION,
+	S_IDENTIFIER,
+	S_ANONYMOUS_ENUM_DECLARATION,
+	S_ENUM_MEMBER,
+	S_CALL_EXPRESSION,
+	S_TYPE,
+	S_TEMPLATE_INSTANCE,
+	S_PARAMETER,
+	S_VARIABLE_DECLARATION,
+	S_DECLARATOR,
+	S_ALIAS_DECLARATION,
+	S_ALIAS_INITIALIZER,
+	S_COUNT,
+};
+
+static const char *sym_names[S_COUNT] = {
+	[S_MODULE_DEF]                 = "module_def",
+	[S_MODULE_DECLARATION]         = "module_declaration",
+	[S_MODULE_FQN]                 = "module_fqn",
+	[S_STRUCT_DECLARATION]         = "struct_declaration",
+	[S_INTERFACE_DECLARATION]      = "interface_declaration",
+	[S_ENUM_DECLARATION]           = "enum_declaration",
+	[S_CLASS_DECLARATION]          = "class_declaration",
+	[S_UNION_DECLARATION]          = "union_declaration",
+	[S_CONSTRUCTOR]                = "constructor",
+	[S_DESTRUCTOR]                 = "destructor",
+	[S_POSTBLIT]                   = "postblit",
+	[S_THIS]                       = "this",
+	[S_MANIFEST_DECLARATOR]        = "manifest_declarator",
+	[S_FUNCTION_DECLARATION]       = "function_declaration",
+	[S_IDENTIFIER]                 = "identifier",
+	[S_ANONYMOUS_ENUM_DECLARATION] = "anonymous_enum_declaration",
+	[S_ENUM_MEMBER]                = "enum_member",
+	[S_CALL_EXPRESSION]            = "call_expression",
+	[S_TYPE]                       = "type",
+	[S_TEMPLATE_INSTANCE]          = "template_instance",
+	[S_PARAMETER]                  = "parameter",
+	[S_VARIABLE_DECLARATION]       = "variable_declaration",
+	[S_DECLARATOR]                 = "declarator",
+	[S_ALIAS_DECLARATION]          = "alias_declaration",
+	[S_ALIAS_INITIALIZER]          = "alias_initializer",
+};
+
+// fields used by the patterns
+enum fld {
+	F_NAME,
+	F_MEMBER,
+	F_FUNCTION,
+	F_TYPE,
+	F_DECLARATOR,
+	F_COUNT,
+};
+
+static const char *field_names[F_COUNT] = {
+	[F_NAME]       = "name",
+	[F_MEMBER]     = "member",
+	[F_FUNCTION]   = "function",
+	[F_TYPE]       = "type",
+	[F_DECLARATOR] = "declarator",
+};
+
+static const struct {
+	enum sym  sym;
+	enum role role;
+} roots[] = {
+	{ S_MODULE_DEF, R_MODULE_DEF },
+	{ S_STRUCT_DECLARATION, R_STRUCT },
+	{ S_INTERFACE_DECLARATION, R_INTERFACE },
+	{ S_ENUM_DECLARATION, R_ENUM },
+	{ S_CLASS_DECLARATION, R_CLASS },
+	{ S_UNION_DECLARATION, R_UNION },
+	{ S_CONSTRUCTOR, R_THIS },
+	{ S_DESTRUCTOR, R_THIS },
+	{ S_POSTBLIT, R_THIS },
+	{ S_MANIFEST_DECLARATOR, R_MANIFEST_DECLARATOR },
+	{ S_FUNCTION_DECLARATION, R_FUNCTION },
+	{ S_ANONYMOUS_ENUM_DECLARATION, R_ANONYMOUS_ENUM },
+	{ S_CALL_EXPRESSION, R_CALL },
+	{ S_PARAMETER, R_PARAMETER },
+	{ S_VARIABLE_DECLARATION, R_VARIABLE },
+	{ S_ALIAS_DECLARATION, R_ALIAS },
+};
+
+// Child lists are walked with cursors that are reset for each use,
+// rather than created, so that a walk does not allocate.  The patterns
+// go at most three levels of children below their root.
+#define LEVELS 3
+
+struct ts_d_tagger {
+	TSSymbol     syms[S_COUNT];
+	TSFieldId    fields[F_COUNT];
+	uint8_t     *roles; // role of each symbol
+	uint32_t     nsyms;
+	TSTreeCursor cursors[LEVELS];
+	ts_d_tag_cb  cb;
+	void        *arg;
+};
+
+static const char *kind_names[] = {
+	[TS_D_TAG_DEFINITION_MODULE]    = "definition.module",
+	[TS_D_TAG_DEFINITION_CLASS]     = "definition.class",
+	[TS_D_TAG_DEFINITION_INTERFACE] = "definition.interface",
+	[TS_D_TAG_DEFINITION_TYPE]      = "definition.type",
+	[TS_D_TAG_DEFINITION_METHOD]    = "definition.method",
+	[TS_D_TAG_DEFINITION_FUNCTION]  = "definition.function",
+	[TS_D_TAG_DEFINITION_CONSTANT]  = "definition.constant",
+	[TS_D_TAG_REFERENCE_CALL]       = "reference.call",
+	[TS_D_TAG_REFERENCE_CLASS]      = "reference.class",
+};
+
+const char *
+ts_d_tag_kind_name(ts_d_tag_kind kind)
+{
+	if ((unsigned) kind >= sizeof(kind_names) / sizeof(kind_names[0])) {
+		return (NULL);
+	}
+	return (kind_names[kind]);
+}
+
+ts_d_tagger *
+ts_d_tagger_new(const TSLanguage *language)
+{
+	ts_d_tagger *t;
+
+	if ((t = calloc(1, sizeof(*t))) == NULL) {
+		return (NULL);
+	}
+	t->nsyms = ts_language_symbol_count(language);
+	if ((t->roles = calloc(t->nsyms, sizeof(uint8_t))) == NULL) {
+		free(t);
+		return (NULL);
+	}
+	// The query engine compares public symbols, which is also what
+	// ts_language_symbol_for_name and ts_node_symbol return, so that
+	// aliases of the same name are treated alike.
+	for (int i = 0; i < S_COUNT; i++) {
+		const char *name = sym_names[i];
+		uint32_t    len  = (uint32_t) strlen(name);
+		t->syms[i] =
+		    ts_language_symbol_for_name(language, name, len, true);
+		if (t->syms[i] == 0) {
+			ts_d_tagger_delete(t);
+			return (NULL);
+		}
+	}
+	for (int i = 0; i < F_COUNT; i++) {
+		const char *name = field_names[i];
+		uint32_t    len  = (uint32_t) strlen(name);
+		t->fields[i] =
+		    ts_language_field_id_for_name(language, name, len);
+		if (t->fields[i] == 0) {
+			ts_d_tagger_delete(t);
+			return (NULL);
+		}
+	}
+	for (size_t i = 0; i < sizeof(roots) / sizeof(roots[0]); i++) {
+		t->roles[t->syms[roots[i].sym]] = (uint8_t) roots[i].role;
+	}
+	return (t);
+}
+
+void
+ts_d_tagger_delete(ts_d_tagger *t)
+{
+	if (t != NULL) {
+		free(t->roles);
+		free(t);
+	}
+}
+
+static inline bool
+is(const ts_d_tagger *t, TSNode node, enum sym s)
+{
+	return (ts_node_symbol(node) == t->syms[s]);
+}
+
+static void
+emit(ts_d_tagger *t, ts_d_tag_kind kind, TSNode name, TSNode node)
+{
+	ts_d_tag tag;
+	tag.kind = kind;
+	tag.name = name;
+	tag.node = node;
+	t->cb(&tag, t->arg);
+}
+
+// first_child positions the cursor for a level at the first child of a
+// node, returning false if it has none.
+static bool
+first_child(ts_d_tagger *t, int level, TSNode node)
+{
+	ts_tree_cursor_reset(&t->cursors[level], node);
+	return (ts_tree_cursor_goto_first_child(&t->cursors[level]));
+}
+
+static inline bool
+next_child(ts_d_tagger *t, int level)
+{
+	return (ts_tree_cursor_goto_next_sibling(&t->cursors[level]));
+}
+
+static inline TSNode
+child(ts_d_tagger *t, int level)
+{
+	return (ts_tree_cursor_current_node(&t->cursors[level]));
+}
+
+// each_child emits a tag for each child of the given symbol.
+// (parent (sym) @name) @kind
+static void
+each_child(ts_d_tagger *t, int level, TSNode node, enum sym s,
+    ts_d_tag_kind kind, TSNode tagged)
+{
+	if (!first_child(t, level, node)) {
+		return;
+	}
+	do {
+		TSNode c = child(t, level);
+		if (is(t, c, s)) {
+			emit(t, kind, c, tagged);
+		}
+	} while (next_child(t, level));
+}
+
+static inline TSNode
+field(const ts_d_tagger *t, TSNode node, enum fld f)
+{
+	return (ts_node_child_by_field_id(node, t->fields[f]));
+}
+
+static inline bool
+in_field(const ts_d_tagger *t, int level, enum fld f)
+{
+	return (ts_tree_cursor_current_field_id(&t->cursors[level]) ==
+	    t->fields[f]);
+}
+
+// named handles (parent name: (sym) @name) @kind, walking the children
+// of the parent at the given level.
+static void
+named(ts_d_tagger *t, int level, TSNode node, enum sym s,
+    ts_d_tag_kind kind, TSNode tagged)
+{
+	if (!first_child(t, level, node)) {
+		return;
+	}
+	do {
+		TSNode c = child(t, level);
+		if (in_field(t, level, F_NAME) && is(t, c, s)) {
+			emit(t, kind, c, tagged);
+		}
+	} while (next_child(t, level));
+}
+
+// (parent member: (enum_member name: (identifier) @name)) @kind
+static void
+members(ts_d_tagger *t, TSNode node, ts_d_tag_kind kind)
+{
+	if (!first_child(t, 0, node)) {
+		return;
+	}
+	do {
+		TSNode c = child(t, 0);
+		if (in_field(t, 0, F_MEMBER) && is(t, c, S_ENUM_MEMBER)) {
+			named(t, 1, c, S_IDENTIFIER, kind, node);
+		}
+	} while (next_child(t, 0));
+}
+
+// type_idents handles (type (identifier) @name) @reference.class, for
+// the type of a parameter or variable.
+static void
+type_idents(ts_d_tagger *t, TSNode type)
+{
+	if (!ts_node_is_null(type) && is(t, type, S_TYPE)) {
+		each_child(t, 1, type, S_IDENTIFIER, TS_D_TAG_REFERENCE_CLASS,
+		    type);
+	}
+}
+
+// (parameter type: (type (identifier) @name) @reference.class
+//     name: (identifier))
+static void
+parameter(ts_d_tagger *t, TSNode node)
+{
+	TSNode name = field(t, node, F_NAME);
+	if (!ts_node_is_null(name) && is(t, name, S_IDENTIFIER)) {
+		type_idents(t, field(t, node, F_TYPE));
+	}
+}
+
+// (variable_declaration type: (type (identifier) @name) @reference.class
+//     declarator: (declarator))
+static void
+variable(ts_d_tagger *t, TSNode node)
+{
+	if (!first_child(t, 0, node)) {
+		return;
+	}
+	do {
+		if (in_field(t, 0, F_DECLARATOR) &&
+		    is(t, child(t, 0), S_DECLARATOR)) {
+			type_idents(t, field(t, node, F_TYPE));
+			return;
+		}
+	} while (next_child(t, 0));
+}
+
+static void
+call(ts_d_tagger *t, TSNode node)
+{
+	if (!first_child(t, 0, node)) {
+		return;
+	}
+	do {
+		TSNode fn = child(t, 0);
+		if (!in_field(t, 0, F_FUNCTION)) {
+			continue;
+		}
+		if (is(t, fn, S_IDENTIFIER)) {
+			// (call_expression function: (identifier) @name)
+			emit(t, TS_D_TAG_REFERENCE_CALL, fn, node);
+		} else if (is(t, fn, S_TYPE) && first_child(t, 1, fn)) {
+			// (call_expression function:
+			//     (type (template_instance
+			//         name: (identifier) @name)))
+			do {
+				TSNode ti = child(t, 1);
+				if (is(t, ti, S_TEMPLATE_INSTANCE)) {
+					named(t, 2, ti, S_IDENTIFIER,
+					    TS_D_TAG_REFERENCE_CALL, node);
+				}
+			} while (next_child(t, 1));
+		}
+	} while (next_child(t, 0));
+}
+
+// (alias_declaration (alias_initializer name: (identifier) @name)) @kind
+static void
+alias(ts_d_tagger *t, TSNode node)
+{
+	if (!first_child(t, 0, node)) {
+		return;
+	}
+	do {
+		TSNode c = child(t, 0);
+		if (is(t, c, S_ALIAS_INITIALIZER)) {
+			named(t, 1, c, S_IDENTIFIER,
+			    TS_D_TAG_DEFINITION_CLASS, node);
+		}
+	} while (next_child(t, 0));
+}
+
+static void
+module_def(ts_d_tagger *t, TSNode node)
+{
+	if (!first_child(t, 0, node)) {
+		return;
+	}
+	do {
+		TSNode c = child(t, 0);
+		if (is(t, c, S_MODULE_DECLARATION)) {
+			named(t, 1, c, S_MODULE_FQN,
+			    TS_D_TAG_DEFINITION_MODULE, node);
+		}
+	} while (next_child(t, 0));
+}
+
+static void
+visit(ts_d_tagger *t, TSNode node, enum role role)
+{
+	switch (role) {
+	case R_NONE:
+		break;
+	case R_MODULE_DEF:
+		module_def(t, node);
+		break;
+	case R_STRUCT:
+	case R_CLASS:
+		named(t, 0, node, S_IDENTIFIER, TS_D_TAG_DEFINITION_CLASS,
+		    node);
+		break;
+	case R_INTERFACE:
+		named(t, 0, node, S_IDENTIFIER, TS_D_TAG_DEFINITION_INTERFACE,
+		    node);
+		break;
+	case R_ENUM:
+		named(t, 0, node, S_IDENTIFIER, TS_D_TAG_DEFINITION_TYPE,
+		    node);
+		members(t, node, TS_D_TAG_DEFINITION_CONSTANT);
+		break;
+	case R_UNION:
+	case R_MANIFEST_DECLARATOR:
+		named(t, 0, node, S_IDENTIFIER, TS_D_TAG_DEFINITION_TYPE,
+		    node);
+		break;
+	case R_THIS:
+		each_child(
+		    t, 0, node, S_THIS, TS_D_TAG_DEFINITION_METHOD, node);
+		break;
+	case R_FUNCTION:
+		named(t, 0, node, S_IDENTIFIER, TS_D_TAG_DEFINITION_FUNCTION,
+		    node);
+		break;
+	case R_ANONYMOUS_ENUM:
+		members(t, node, TS_D_TAG_DEFINITION_CONSTANT);
+		break;
+	case R_CALL:
+		call(t, node);
+		break;
+	case R_PARAMETER:
+		parameter(t, node);
+		break;
+	case R_VARIABLE:
+		variable(t, node);
+		break;
+	case R_ALIAS:
+		alias(t, node);
+		break;
+	}
+}
+
+static void
+begin(ts_d_tagger *t, TSNode node, ts_d_tag_cb cb, void *arg)
+{
+	t->cb  = cb;
+	t->arg = arg;
+	for (int i = 0; i < LEVELS; i++) {
+		t->cursors[i] = ts_tree_cursor_new(node);
+	}
+}
+
+static void
+end(ts_d_tagger *t)
+{
+	for (int i = 0; i < LEVELS; i++) {
+		ts_tree_cursor_delete(&t->cursors[i]);
+	}
+}
+
+static bool
+visit_node(TSNode n, void *arg)
+{
+	ts_d_tagger *t   = arg;
+	TSSymbol     sym = ts_node_symbol(n);
+
+	if ((sym < t->nsyms) && (t->roles[sym] != R_NONE)) {
+		visit(t, n, (enum role) t->roles[sym]);
+	}
+	return (true);
+}
+
+void
+ts_d_tagger_run(ts_d_tagger *t, TSNode node, ts_d_tag_cb cb, void *arg)
+{
+	TSTreeCursor walk = ts_tree_cursor_new(node);
+
+	begin(t, node, cb, arg);
+	for (;;) {
+		visit_node(ts_tree_cursor_current_node(&walk), t);
+		if (ts_tree_cursor_goto_first_child(&walk)) {
+			continue;
+		}
+		while (!ts_tree_cursor_goto_next_sibling(&walk)) {
+			if (!ts_tree_cursor_goto_parent(&walk)) {
+				goto done;
+			}
+		}
+	}
+done:
+	end(t);
+	ts_tree_cursor_delete(&walk);
+}
+
+bool
+ts_d_tagger_run_active(ts_d_tagger *t, const ts_d_config *config,
+    TSNode node, const char *src, ts_d_tag_cb cb, void *arg)
+{
+	bool ok;
+
+	begin(t, node, cb, arg);
+	ok = ts_d_walk(config, node, src, visit_node, t);
+	end(t);
+	return (ok);
+}
@@ -18,11 +18,7 @@ int f() {
       (block_statement
         (asm_statement
           (asm)
-          (asm_inline
-            (identifier)
-            (int_literal)
-            (int_literal)
-            (int_literal))
+          (asm_inline)
           (comment))))))
 
 ================================================================================
@@ -67,10 +63,7 @@ int f() {
           (pure)
           (at_attribute
             (identifier))
-          (asm_inline
-            (identifier)
-            (identifier)
-            (identifier)))))))
+          (asm_inline))))))
 
 ================================================================================
 Inline assembler braces
@@ -92,8 +85,31 @@ int f() {
       (block_statement
         (asm_statement
           (asm)
-          (asm_inline
-            (identifier)
-            (string_literal
-              (quoted_string)))
+          (asm_inline)
+          (comment))))))
+
+================================================================================
+Inline assembler with interior comments
+================================================================================
+void f() {
+  asm {
+    // leading comment
+    mov EAX, 1; /* interior */ nop;
+    /+ trailing /+ nested +/ +/
+  }
+}
+--------------------------------------------------------------------------------
+
+(source_file
+  (function_declaration
+    (type
+      (void))
+    (identifier)
+    (parameters)
+    (function_body
+      (block_statement
+        (asm_statement
+          (asm)
+          (comment)
+          (asm_inline)
           (comment))))))
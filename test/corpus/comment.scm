@@ -85,3 +85,51 @@ enum w = "/+ is /* not */ a // comment+/";
       (identifier)
       (string_literal
         (quoted_string)))))
+
+==================
+Deeply nested comment
+==================
+/+ 1 /+ 2 /+ 3 /+ 4 /+ 5 /+ 6 /+ 7 +/ 6 +/ 5 +/ 4 +/ 3 +/ 2 +/ 1 +/
+int x;
+/+/ odd +/
+/++/
+---
+
+(source_file
+  (comment)
+  (variable_declaration
+    (type
+      (int))
+    (declarator
+      (identifier)))
+  (comment)
+  (comment))
+
+==================
+Nesting comment markers in strings
+==================
+enum a = `/+ not a comment +/`;
+enum b = r"/+ not a comment +/";
+enum c = "\n/+ not a comment +/";
+---
+
+(source_file
+  (manifest_constant
+    (enum)
+    (manifest_declarator
+      (identifier)
+      (string_literal
+        (raw_string))))
+  (manifest_constant
+    (enum)
+    (manifest_declarator
+      (identifier)
+      (string_literal
+        (raw_string))))
+  (manifest_constant
+    (enum)
+    (manifest_declarator
+      (identifier)
+      (string_literal
+        (quoted_string
+          (escape_sequence))))))
@@ -0,0 +1,233 @@
+/*
+ * Time and memory ceilings for parsing pathological inputs.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// Each input (normally test/stress/*.d, from scripts/gen-stress.js) is
+// parsed with ts_d_parse_bounded, with a timeout of the time ceiling,
+// and must finish within it.  Once all are parsed, the peak resident
+// size of the process must be under the memory ceiling.  The limits
+// themselves are checked on the largest input: each must stop the
+// parse, and the parser must then parse it again as before.
+
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <tree_sitter/api.h>
+
+#include "../bench/corpus.h"
+#include "tree-sitter-d-bounded.h"
+#include "tree-sitter-d.h"
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec);
+}
+
+// max_rss_mb returns the peak resident size of the process.
+static double
+max_rss_mb(void)
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+	return ((double) ru.ru_maxrss / (1024.0 * 1024.0)); // bytes
+#else
+	return ((double) ru.ru_maxrss / 1024.0); // kilobytes
+#endif
+}
+
+// expect parses src with the limits given, and checks the status.
+static bool
+expect(TSParser *parser, const char *name, const char *src, uint32_t len,
+    const ts_d_parse_limits *limits, ts_d_parse_status want)
+{
+	TSTree           *tree;
+	ts_d_parse_status got;
+
+	got = ts_d_parse_bounded(parser, NULL, src, len, limits, &tree);
+	if (tree != NULL) {
+		ts_tree_delete(tree);
+	}
+	if (got != want) {
+		printf("FAIL %s: got \"%s\", wanted \"%s\"\n", name,
+		    ts_d_parse_status_name(got), ts_d_parse_status_name(want));
+		return (false);
+	}
+	return (true);
+}
+
+// check_limits makes sure that each limit stops the parse, and that the
+// parser is left fit for the next one.
+static int
+check_limits(TSParser *parser, const char *name, const char *src,
+    uint32_t len, uint32_t nodes)
+{
+	ts_d_parse_limits limits;
+	size_t            cancel   = 1;
+	int               failures = 0;
+	TSTree           *tree;
+
+	memset(&limits, 0, sizeof(limits));
+	limits.max_bytes = len - 1;
+	failures += !expect(
+	    parser, name, src, len, &limits, TS_D_PARSE_TOO_LARGE);
+
+	memset(&limits, 0, sizeof(limits));
+	limits.cancel = &cancel;
+	failures +=
+	    !expect(parser, name, src, len, &limits, TS_D_PARSE_CANCELLED);
+
+	memset(&limits, 0, sizeof(limits));
+	limits.max_operations = 1000;
+	failures += !expect(
+	    parser, name, src, len, &limits, TS_D_PARSE_OVER_BUDGET);
+
+	memset(&limits, 0, sizeof(limits));
+	limits.timeout_micros = 1;
+	failures +=
+	    !expect(parser, name, src, len, &limits, TS_D_PARSE_TIMED_OUT);
+
+	// a stopped parse must not be resumed by the next one
+	tree = ts_parser_parse_string(parser, NULL, src, len);
+	if (ts_node_descendant_count(ts_tree_root_node(tree)) != nodes) {
+		printf("FAIL %s: different tree after stopped parses\n", name);
+		failures++;
+	}
+	ts_tree_delete(tree);
+
+	printf("limits checked on %s\n", name);
+	return (failures);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+	    "usage: stress_test [-t ms] [-m megabytes] [-o operations] "
+	    "file.d ...\n");
+	exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+	ts_d_parse_limits limits;
+	TSParser         *parser;
+	uint64_t          max_ms   = 2000;
+	double            max_mb   = 256;
+	int               failures = 0;
+	int               largest  = -1;
+	size_t            most     = 0;
+	uint32_t          nodes    = 0;
+	int               opt;
+
+	memset(&limits, 0, sizeof(limits));
+	while ((opt = getopt(argc, argv, "t:m:o:")) != -1) {
+		switch (opt) {
+		case 't':
+			max_ms = strtoull(optarg, NULL, 10);
+			break;
+		case 'm':
+			max_mb = atof(optarg);
+			break;
+		case 'o':
+			limits.max_operations = strtoull(optarg, NULL, 10);
+			break;
+		default:
+			usage();
+		}
+	}
+	if ((optind == argc) || (max_ms == 0) || (max_mb <= 0)) {
+		usage();
+	}
+	limits.timeout_micros = max_ms * 1000;
+
+	parser = ts_parser_new();
+	ts_parser_set_language(parser, tree_sitter_d());
+	for (int i = optind; i < argc; i++) {
+		ts_d_parse_status status;
+		TSTree           *tree;
+		size_t            len;
+		char             *src;
+		uint64_t          start;
+		double            ms;
+
+		if ((src = corpus_read_file(argv[i], &len)) == NULL) {
+			fprintf(stderr, "stress_test: %s: %s\n", argv[i],
+			    strerror(errno));
+			return (1);
+		}
+		if (len > UINT32_MAX) {
+			fprintf(stderr, "stress_test: %s: too large\n",
+			    argv[i]);
+			return (1);
+		}
+		start  = now_ns();
+		status = ts_d_parse_bounded(
+		    parser, NULL, src, (uint32_t) len, &limits, &tree);
+		ms = (double) (now_ns() - start) / 1e6;
+		if (status != TS_D_PARSE_OK) {
+			printf("FAIL %s: %s after %.1f ms\n", argv[i],
+			    ts_d_parse_status_name(status), ms);
+			failures++;
+		} else {
+			TSNode root = ts_tree_root_node(tree);
+			printf("ok   %s: %zu bytes, %u nodes, %.1f ms%s\n",
+			    argv[i], len, ts_node_descendant_count(root), ms,
+			    ts_node_has_error(root) ? ", with errors" : "");
+			if (len > most) {
+				largest = i;
+				most    = len;
+				nodes   = ts_node_descendant_count(root);
+			}
+			ts_tree_delete(tree);
+		}
+		free(src);
+	}
+
+	if (largest >= 0) {
+		size_t len;
+		char  *src = corpus_read_file(argv[largest], &len);
+		if (src == NULL) {
+			fprintf(stderr, "stress_test: %s: %s\n", argv[largest],
+			    strerror(errno));
+			return (1);
+		}
+		failures += check_limits(
+		    parser, argv[largest], src, (uint32_t) len, nodes);
+		free(src);
+	}
+	ts_parser_delete(parser);
+
+	if (max_rss_mb() > max_mb) {
+		printf("FAIL peak resident size %.1f MB, over %.1f MB\n",
+		    max_rss_mb(), max_mb);
+		failures++;
+	} else {
+		printf("peak resident size %.1f MB\n", max_rss_mb());
+	}
+	if (failures != 0) {
+		printf("%d failures\n", failures);
+		return (1);
+	}
+	return (0);
+}
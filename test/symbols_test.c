@@ -0,0 +1,102 @@
+/*
+ * Check the generated symbol and field IDs against the parser.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// The constants in tree-sitter-d-symbols.h are checked against the
+// language with ts_d_symbols_check.  For each file given, every node in
+// its tree must then have the symbol that its type name looks up to, as
+// the constants are checked by name: a walk that switches on them sees
+// the same nodes as one that compares type names.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tree_sitter/api.h>
+
+#include "../bench/corpus.h"
+#include "tree-sitter-d-symbols.h"
+#include "tree-sitter-d.h"
+
+static int
+check_file(TSParser *parser, const char *path)
+{
+	const TSLanguage *lang = tree_sitter_d();
+	TSTree           *tree;
+	TSTreeCursor      c;
+	size_t            len;
+	char             *src;
+	int               failures = 0;
+
+	if ((src = corpus_read_file(path, &len)) == NULL) {
+		fprintf(
+		    stderr, "symbols_test: %s: %s\n", path, strerror(errno));
+		return (1);
+	}
+	tree = ts_parser_parse_string(parser, NULL, src, (uint32_t) len);
+	c    = ts_tree_cursor_new(ts_tree_root_node(tree));
+	for (;;) {
+		TSNode      node = ts_tree_cursor_current_node(&c);
+		const char *type = ts_node_type(node);
+		uint32_t    n    = (uint32_t) strlen(type);
+		TSSymbol    sym  = ts_node_symbol(node);
+
+		if (ts_language_symbol_for_name(
+		        lang, type, n, ts_node_is_named(node)) != sym) {
+			printf("FAIL %s: %s has symbol %u\n", path, type,
+			    (unsigned) sym);
+			failures++;
+		}
+		if (ts_tree_cursor_goto_first_child(&c) ||
+		    ts_tree_cursor_goto_next_sibling(&c)) {
+			continue;
+		}
+		while (ts_tree_cursor_goto_parent(&c) &&
+		    !ts_tree_cursor_goto_next_sibling(&c)) {
+		}
+		if (ts_node_eq(ts_tree_cursor_current_node(&c),
+		        ts_tree_root_node(tree))) {
+			break;
+		}
+	}
+	ts_tree_cursor_delete(&c);
+	ts_tree_delete(tree);
+	free(src);
+	return (failures);
+}
+
+int
+main(int argc, char **argv)
+{
+	TSParser   *parser;
+	const char *bad;
+	int         failures = 0;
+
+	if ((bad = ts_d_symbols_check(tree_sitter_d())) != NULL) {
+		printf("FAIL tree-sitter-d-symbols.h (%s) does not match the "
+		       "parser, regenerate it with make symbols\n",
+		    bad);
+		return (1);
+	}
+	printf("%d symbols and %d fields checked (grammar %s)\n",
+	    TS_D_SYMBOL_COUNT, TS_D_FIELD_COUNT, TS_D_SYMBOLS_VERSION);
+
+	parser = ts_parser_new();
+	ts_parser_set_language(parser, tree_sitter_d());
+	for (int i = 1; i < argc; i++) {
+		failures += check_file(parser, argv[i]);
+	}
+	ts_parser_delete(parser);
+	if (failures != 0) {
+		printf("%d failures\n", failures);
+		return (1);
+	}
+	return (0);
+}
@@ -0,0 +1,341 @@
+/*
+ * Differential test of the native tagger against queries/tags.scm.
+ *
+ * Copyright 2024 Garrett D'Amore
+ *
+ * Distributed under the MIT License.
+ * (See accompanying file LICENSE.txt or https://opensource.org/licenses/MIT)
+ * SPDX-License-Identifier: MIT
+ */
+
+// Every input is parsed, and tagged both by running queries/tags.scm
+// with the query engine, and by the native tagger in tags/tags.c.  The
+// two sets of tags (kind, and the spans of the name and tagged nodes)
+// must be identical; any differences are printed, and the test fails.
+// The time spent by each is reported too.  A few inputs that have
+// tripped up the tagger before are always checked as well.
+
+#define _DEFAULT_SOURCE
+#define _DARWIN_C_SOURCE
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <tree_sitter/api.h>
+
+#include "../bench/corpus.h"
+#include "tree-sitter-d-tags.h"
+#include "tree-sitter-d.h"
+
+typedef struct {
+	int      kind;
+	uint32_t name_start;
+	uint32_t name_end;
+	uint32_t node_start;
+	uint32_t node_end;
+} tag;
+
+typedef struct {
+	tag   *tags;
+	size_t n;
+	size_t cap;
+} tag_list;
+
+typedef struct {
+	TSParser      *parser;
+	TSQuery       *query;
+	TSQueryCursor *cursor;
+	ts_d_tagger   *tagger;
+	int           *kinds; // tag kind of each capture, -1 for @name
+	uint64_t       query_ns;
+	uint64_t       native_ns;
+	size_t         inputs;
+	size_t         tags;
+	int            failures;
+} test;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec);
+}
+
+static void
+add_tag(tag_list *l, int kind, TSNode name, TSNode node)
+{
+	if (l->n == l->cap) {
+		l->cap  = l->cap ? l->cap * 2 : 64;
+		l->tags = realloc(l->tags, l->cap * sizeof(tag));
+		if (l->tags == NULL) {
+			fprintf(stderr, "tags_test: out of memory\n");
+			exit(1);
+		}
+	}
+	l->tags[l->n].kind       = kind;
+	l->tags[l->n].name_start = ts_node_start_byte(name);
+	l->tags[l->n].name_end   = ts_node_end_byte(name);
+	l->tags[l->n].node_start = ts_node_start_byte(node);
+	l->tags[l->n].node_end   = ts_node_end_byte(node);
+	l->n++;
+}
+
+static void
+native_tag(const ts_d_tag *t, void *arg)
+{
+	add_tag(arg, (int) t->kind, t->name, t->node);
+}
+
+static int
+cmp_tag(const void *a, const void *b)
+{
+	const tag *x = a;
+	const tag *y = b;
+	if (x->node_start != y->node_start) {
+		return (x->node_start < y->node_start ? -1 : 1);
+	}
+	if (x->node_end != y->node_end) {
+		return (x->node_end < y->node_end ? -1 : 1);
+	}
+	if (x->name_start != y->name_start) {
+		return (x->name_start < y->name_start ? -1 : 1);
+	}
+	if (x->name_end != y->name_end) {
+		return (x->name_end < y->name_end ? -1 : 1);
+	}
+	return (x->kind - y->kind);
+}
+
+static void
+print_tag(const char *which, const tag *t, const char *src)
+{
+	fprintf(stderr, "  %s %s \"%.*s\" at %u-%u\n", which,
+	    ts_d_tag_kind_name((ts_d_tag_kind) t->kind),
+	    (int) (t->name_end - t->name_start), src + t->name_start,
+	    t->node_start, t->node_end);
+}
+
+static void
+check_input(const char *name, char *src, size_t len, void *arg)
+{
+	test        *ts = arg;
+	TSTree      *tree;
+	TSNode       root;
+	TSQueryMatch m;
+	tag_list     q = { 0 };
+	tag_list     n = { 0 };
+	uint64_t     start;
+	size_t       i  = 0;
+	size_t       j  = 0;
+	bool         ok = true;
+
+	tree = ts_parser_parse_string(ts->parser, NULL, src, (uint32_t) len);
+	root = ts_tree_root_node(tree);
+
+	start = now_ns();
+	ts_query_cursor_exec(ts->cursor, ts->query, root);
+	while (ts_query_cursor_next_match(ts->cursor, &m)) {
+		TSNode name = { 0 };
+		TSNode node = { 0 };
+		int    kind = -1;
+		for (uint16_t c = 0; c < m.capture_count; c++) {
+			if (ts->kinds[m.captures[c].index] < 0) {
+				name = m.captures[c].node;
+			} else {
+				kind = ts->kinds[m.captures[c].index];
+				node = m.captures[c].node;
+			}
+		}
+		if (kind >= 0) {
+			add_tag(&q, kind, name, node);
+		}
+	}
+	ts->query_ns += now_ns() - start;
+
+	start = now_ns();
+	ts_d_tagger_run(ts->tagger, root, native_tag, &n);
+	ts->native_ns += now_ns() - start;
+
+	qsort(q.tags, q.n, sizeof(tag), cmp_tag);
+	qsort(n.tags, n.n, sizeof(tag), cmp_tag);
+	while ((i < q.n) || (j < n.n)) {
+		int c;
+		if (i == q.n) {
+			c = 1;
+		} else if (j == n.n) {
+			c = -1;
+		} else {
+			c = cmp_tag(&q.tags[i], &n.tags[j]);
+		}
+		if (c == 0) {
+			i++;
+			j++;
+			continue;
+		}
+		if (ok) {
+			fprintf(stderr, "%s: tags differ\n", name);
+			ok = false;
+		}
+		if (c < 0) {
+			print_tag("query only: ", &q.tags[i++], src);
+		} else {
+			print_tag("native only:", &n.tags[j++], src);
+		}
+	}
+	if (!ok) {
+		ts->failures++;
+	}
+	ts->inputs++;
+	ts->tags += q.n;
+	free(q.tags);
+	free(n.tags);
+	ts_tree_delete(tree);
+	free(src);
+}
+
+// capture_kind returns the tag kind for a capture name, -1 for @name,
+// or -2 if the tagger has no such kind.
+static int
+capture_kind(const char *cn, uint32_t len)
+{
+	const char *kn;
+
+	if ((len == 4) && (memcmp(cn, "name", 4) == 0)) {
+		return (-1);
+	}
+	for (int k = 0; (kn = ts_d_tag_kind_name((ts_d_tag_kind) k)); k++) {
+		if ((strlen(kn) == len) && (memcmp(kn, cn, len) == 0)) {
+			return (k);
+		}
+	}
+	return (-2);
+}
+
+// cases are the inputs checked on every run
+static const struct {
+	const char *name;
+	const char *src;
+} cases[] = {
+	// the function field of the call may hold the "." as well
+	{ "module-scope call", "void f() { .foo(); }\n" },
+	{ "module-scope template call", "void f() { .Tmpl!int(); }\n" },
+	{ "template call", "void f() { Tmpl!int(); }\n" },
+};
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+	    "usage: tags_test [-q tags.scm] [-c corpus-dir] [file.d ...]\n");
+	exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char  *qfile  = "queries/tags.scm";
+	const char  *corpus = NULL;
+	char        *qsrc;
+	size_t       qlen;
+	uint32_t     offset;
+	TSQueryError err;
+	test         ts;
+	int          opt;
+
+	while ((opt = getopt(argc, argv, "q:c:")) != -1) {
+		switch (opt) {
+		case 'q':
+			qfile = optarg;
+			break;
+		case 'c':
+			corpus = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if ((corpus == NULL) && (optind == argc)) {
+		usage();
+	}
+
+	memset(&ts, 0, sizeof(ts));
+	if ((qsrc = corpus_read_file(qfile, &qlen)) == NULL) {
+		fprintf(stderr, "tags_test: %s: %s\n", qfile, strerror(errno));
+		return (1);
+	}
+	ts.query = ts_query_new(
+	    tree_sitter_d(), qsrc, (uint32_t) qlen, &offset, &err);
+	if (ts.query == NULL) {
+		fprintf(stderr, "tags_test: %s: error %d at offset %u\n",
+		    qfile, (int) err, offset);
+		return (1);
+	}
+	if ((ts.tagger = ts_d_tagger_new(tree_sitter_d())) == NULL) {
+		fprintf(stderr, "tags_test: tagger does not match grammar\n");
+		return (1);
+	}
+
+	// map the query's capture names to tag kinds
+	ts.kinds = calloc(ts_query_capture_count(ts.query), sizeof(int));
+	for (uint32_t i = 0; i < ts_query_capture_count(ts.query); i++) {
+		uint32_t    len;
+		const char *cn;
+		cn = ts_query_capture_name_for_id(ts.query, i, &len);
+		if ((ts.kinds[i] = capture_kind(cn, len)) < -1) {
+			fprintf(stderr, "tags_test: unknown capture @%.*s\n",
+			    (int) len, cn);
+			return (1);
+		}
+	}
+
+	ts.parser = ts_parser_new();
+	ts.cursor = ts_query_cursor_new();
+	ts_parser_set_language(ts.parser, tree_sitter_d());
+
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		char *src;
+		if ((src = strdup(cases[i].src)) == NULL) {
+			fprintf(stderr, "tags_test: out of memory\n");
+			return (1);
+		}
+		check_input(cases[i].name, src, strlen(src), &ts);
+	}
+	if (corpus != NULL) {
+		int rv;
+		if ((rv = corpus_foreach(corpus, check_input, &ts)) != 0) {
+			fprintf(stderr, "tags_test: %s: %s\n", corpus,
+			    strerror(rv));
+			return (1);
+		}
+	}
+	for (int i = optind; i < argc; i++) {
+		size_t len;
+		char  *src;
+		if ((src = corpus_read_file(argv[i], &len)) == NULL) {
+			fprintf(stderr, "tags_test: %s: %s\n", argv[i],
+			    strerror(errno));
+			return (1);
+		}
+		check_input(argv[i], src, len, &ts);
+	}
+
+	printf("%zu inputs, %zu tags, %d differ\n", ts.inputs, ts.tags,
+	    ts.failures);
+	printf("query %.3f ms, native %.3f ms\n", (double) ts.query_ns / 1e6,
+	    (double) ts.native_ns / 1e6);
+
+	ts_query_cursor_delete(ts.cursor);
+	ts_query_delete(ts.query);
+	ts_d_tagger_delete(ts.tagger);
+	ts_parser_delete(ts.parser);
+	free(ts.kinds);
+	free(qsrc);
+	return (ts.failures ? 1 : 0);
+}